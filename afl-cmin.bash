@@ -356,14 +356,6 @@ if [ -d "$IN_DIR/$FIRST_FILE" ]; then
   exit 1
 fi
 
-# Check for the more efficient way to copy files...
-
-if ln "$IN_DIR/$FIRST_FILE" "$TRACE_DIR/.link_test" 2>/dev/null; then
-  CP_TOOL=ln
-else
-  CP_TOOL=cp
-fi
-
 # Make sure that we can actually get anything out of afl-showmap before we
 # waste too much time.
 
@@ -394,237 +386,37 @@ else
 
 fi
 
-TMPFILE=$OUT_DIR/.list.$$
-if [ ! "$THREADS" = "" ]; then
-  ls -- "$IN_DIR" > $TMPFILE 2>/dev/null
-  IN_COUNT=$(cat $TMPFILE | wc -l)
-  SPLIT=$(($IN_COUNT / $THREADS))
-  if [ "$(($IN_COUNT % $THREADS))" -gt 0 ]; then
-    SPLIT=$(($SPLIT + 1))
-  fi
-  echo "[+] Splitting workload into $THREADS tasks with $SPLIT items on average each."
-  split -l $SPLIT $TMPFILE $TMPFILE.
-fi
-
 # Let's roll!
 
-#############################
-# STEP 1: COLLECTING TRACES #
-#############################
-
-echo "[*] Obtaining traces for input files in '$IN_DIR'..."
-
-if [ "$THREADS" = "" ]; then
-(
-
-  CUR=0
-
-  if [ "$STDIN_FILE" = "" ]; then
-
-    ls "$IN_DIR" | while read -r fn; do
-
-      if [ -s "$IN_DIR/$fn" ]; then
-
-        CUR=$((CUR+1))
-        printf "\\r    Processing file $CUR/$IN_COUNT... "
-
-        "$SHOWMAP" -m "$MEM_LIMIT" -t "$TIMEOUT" -o "$TRACE_DIR/$fn" -Z $EXTRA_PAR -- "$@" <"$IN_DIR/$fn"
-      
-      fi
-
-    done
-
-  else
-
-    ls "$IN_DIR" | while read -r fn; do
-
-      if [ -s "$IN_DIR/$fn" ]; then
-
-        CUR=$((CUR+1))
-        printf "\\r    Processing file $CUR/$IN_COUNT... "
-
-        cp "$IN_DIR/$fn" "$STDIN_FILE"
-        "$SHOWMAP" -m "$MEM_LIMIT" -t "$TIMEOUT" -o "$TRACE_DIR/$fn" -Z $EXTRA_PAR -H "$STDIN_FILE" -- "$@" </dev/null
-
-      fi
-
-    done
-
-  fi
-
-  echo
-
-)
-
-else
-
-  PIDS=
-  CNT=0
-  for inputs in $(ls ${TMPFILE}.*); do
-
-(
-
-  if [ "$STDIN_FILE" = "" ]; then
-
-    cat $inputs | while read -r fn; do
-
-      if [ -s "$IN_DIR/$fn" ]; then
-
-        "$SHOWMAP" -m "$MEM_LIMIT" -t "$TIMEOUT" -o "$TRACE_DIR/$fn" -Z $EXTRA_PAR -- "$@" <"$IN_DIR/$fn"
-
-      fi
-
-    done
-
-  else
-
-    if [ -s "$IN_DIR/$fn" ]; then
-      STDIN_FILE="$inputs.$$"
-      cat $inputs | while read -r fn; do
-
-        cp "$IN_DIR/$fn" "$STDIN_FILE"
-        "$SHOWMAP" -m "$MEM_LIMIT" -t "$TIMEOUT" -o "$TRACE_DIR/$fn" -Z $EXTRA_PAR -H "$STDIN_FILE" -- "$@" </dev/null
-
-      done
-
-    fi
-
-  fi
-
-) &
+############################################
+# afl-showmap -M collects the traces, finds #
+# the best candidate for each tuple and     #
+# writes the output files                   #
+############################################
 
-  PIDS="$PIDS $!"
-  done
+# The "best" candidate is understood simply as the smallest input that
+# includes a particular tuple in its trace, taken over for the rarest tuples
+# first. Empirical evidence suggests that this produces smaller datasets than
+# more involved algorithms.
 
-  echo "[+] Waiting for running tasks IDs:$PIDS"
-  wait
-  echo "[+] all $THREADS running tasks completed."
-  rm -f ${TMPFILE}*
+echo "[*] Minimizing the corpus in '$IN_DIR'..."
 
-  #echo trace dir files: $(ls $TRACE_DIR/*|wc -l)
-
-fi
-
-
-##########################
-# STEP 2: SORTING TUPLES #
-##########################
-
-# With this out of the way, we sort all tuples by popularity across all
-# datasets. The reasoning here is that we won't be able to avoid the files
-# that trigger unique tuples anyway, so we will want to start with them and
-# see what's left.
-
-echo "[*] Sorting trace sets (this may take a while)..."
-
-ls "$IN_DIR" | sed "s#^#$TRACE_DIR/#" | tr '\n' '\0' | xargs -0 -n 1 cat | \
-  sort | uniq -c | sort -k 1,1 -n >"$TRACE_DIR/.all_uniq"
-
-TUPLE_COUNT=$((`grep -c . "$TRACE_DIR/.all_uniq"`))
-
-echo "[+] Found $TUPLE_COUNT unique tuples across $IN_COUNT files."
-
-#####################################
-# STEP 3: SELECTING CANDIDATE FILES #
-#####################################
-
-# The next step is to find the best candidate for each tuple. The "best"
-# part is understood simply as the smallest input that includes a particular
-# tuple in its trace. Empirical evidence suggests that this produces smaller
-# datasets than more involved algorithms that could be still pulled off in
-# a shell script.
-
-echo "[*] Finding best candidates for each tuple..."
-
-CUR=0
-
-ls -rS "$IN_DIR" | while read -r fn; do
-
-  CUR=$((CUR+1))
-  printf "\\r    Processing file $CUR/$IN_COUNT... "
-
-  sed "s#\$# $fn#" "$TRACE_DIR/$fn" >>"$TRACE_DIR/.candidate_list"
-
-  test -s "$TRACE_DIR/$fn" || echo Warning: $fn is ignored because of crashing the target
-
-done
-
-echo
-
-##############################
-# STEP 4: LOADING CANDIDATES #
-##############################
-
-# At this point, we have a file of tuple-file pairs, sorted by file size
-# in ascending order (as a consequence of ls -rS). By doing sort keyed
-# only by tuple (-k 1,1) and configured to output only the first line for
-# every key (-s -u), we end up with the smallest file for each tuple.
-
-echo "[*] Sorting candidate list (be patient)..."
-
-sort -k1,1 -s -u "$TRACE_DIR/.candidate_list" | \
-  sed 's/^/BEST_FILE[/;s/ /]="/;s/$/"/' >"$TRACE_DIR/.candidate_script"
-
-if [ ! -s "$TRACE_DIR/.candidate_script" ]; then
-  echo "[-] Error: no traces obtained from test cases, check syntax!" 1>&2
-  test "$AFL_KEEP_TRACES" = "" && rm -rf "$TRACE_DIR"
-  exit 1
+if [ -n "$THREADS" ]; then
+  EXTRA_PAR="$EXTRA_PAR -T $THREADS"
 fi
 
-# The sed command converted the sorted list to a shell script that populates
-# BEST_FILE[tuple]="fname". Let's load that!
-
-. "$TRACE_DIR/.candidate_script"
-
-##########################
-# STEP 5: WRITING OUTPUT #
-##########################
-
-# The final trick is to grab the top pick for each tuple, unless said tuple is
-# already set due to the inclusion of an earlier candidate; and then put all
-# tuples associated with the newly-added file to the "already have" list. The
-# loop works from least popular tuples and toward the most common ones.
-
-echo "[*] Processing candidates and writing output files..."
-
-CUR=0
-
-touch "$TRACE_DIR/.already_have"
-
-while read -r cnt tuple; do
-
-  CUR=$((CUR+1))
-  printf "\\r    Processing tuple $CUR/$TUPLE_COUNT with count $cnt... "
-
-  # If we already have this tuple, skip it.
-
-  grep -q "^$tuple\$" "$TRACE_DIR/.already_have" && continue
-
-  FN=${BEST_FILE[tuple]}
-
-#  echo "tuple nr $CUR ($tuple cnt=$cnt) -> $FN" >> "$TRACE_DIR/.log"
-  $CP_TOOL "$IN_DIR/$FN" "$OUT_DIR/$FN"
-
-  if [ "$((CUR % 5))" = "0" ]; then
-    sort -u "$TRACE_DIR/$FN" "$TRACE_DIR/.already_have" >"$TRACE_DIR/.tmp"
-    mv -f "$TRACE_DIR/.tmp" "$TRACE_DIR/.already_have"
-  else
-    cat "$TRACE_DIR/$FN" >>"$TRACE_DIR/.already_have"
-  fi
+if [ "$STDIN_FILE" = "" ]; then
 
-done <"$TRACE_DIR/.all_uniq"
+  "$SHOWMAP" -m "$MEM_LIMIT" -t "$TIMEOUT" -o "$OUT_DIR" -M $EXTRA_PAR -i "$IN_DIR" -- "$@"
 
-echo
+else
 
-OUT_COUNT=`ls -- "$OUT_DIR" | wc -l`
+  "$SHOWMAP" -m "$MEM_LIMIT" -t "$TIMEOUT" -o "$OUT_DIR" -M $EXTRA_PAR -i "$IN_DIR" -H "$STDIN_FILE" -- "$@" </dev/null
 
-if [ "$OUT_COUNT" = "1" ]; then
-  echo "[!] WARNING: All test cases had the same traces, check syntax!"
 fi
 
-echo "[+] Narrowed down to $OUT_COUNT files, saved in '$OUT_DIR'."
-echo
+RET=$?
 
 test "$AFL_KEEP_TRACES" = "" && rm -rf "$TRACE_DIR"
 
-exit 0
+exit $RET
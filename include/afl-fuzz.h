@@ -45,6 +45,7 @@
 #include "sharedmem.h"
 #include "forkserver.h"
 #include "common.h"
+#include "afl-pack.h"
 
 #include <stdio.h>
 #include <unistd.h>
@@ -165,6 +166,7 @@ struct inf_profile {
 
   u32 inf_skipped_bytes;               /* Inference Stage Profiling         */
   u64 inf_execs_cost, inf_time_cost;
+  u32 inf_reused;                       /* Results from .state/skipdet      */
 
 };
 
@@ -254,8 +256,49 @@ struct queue_entry {
   u8                 *testcase_buf;      /* The testcase buffer, if loaded.  */
   u8                 *cmplog_colorinput; /* the result buf of colorization   */
   struct tainted     *taint;             /* Taint information from CmpLog    */
+  u64                *cmplog_sig;        /* Operand hashes of the cmplog pass */
   struct skipdet_entry *skipdet_e;
 
+  u32 cmplog_sig_cnt;                   /* Entries in cmplog_sig            */
+
+  u8 tc_clock_ref;                      /* Testcase cache CLOCK ref bit     */
+  u8 splice_indexed;                    /* Anchors are in the splice index  */
+
+};
+
+/* Arena for the minimized traces (trace_mini) of all queue entries. Slots
+   are map_size >> 3 bytes big, carved from slabs and recycled through a free
+   list. With AFL_TRACE_MINI_FILE the slabs are file-backed mmap()s below the
+   output directory, so the kernel can page them out under memory pressure. */
+
+struct trace_mini_store {
+
+  u8 **slabs;                           /* Base addresses of all slabs      */
+  u32  slab_cnt;                        /* Number of slabs                  */
+  u32  slab_slots;                      /* Slots per slab                   */
+  u32  slot_size;                       /* Bytes per slot                   */
+  u32  next_fresh;                      /* Next unused slot in last slab    */
+  u64  slab_size;                       /* Bytes per slab (page aligned)    */
+  u8  *free_list;                       /* Recycled slots (linked in place) */
+  u64  used,                            /* Slots currently handed out       */
+      peak;                             /* Highest number of used slots     */
+  s32  fd;                              /* Backing file or -1               */
+
+};
+
+/* With AFL_SYNC_INOTIFY every peer queue/ directory gets an inotify watch,
+   and sync_fuzzers() only looks at the file names reported since the last
+   sync instead of scandir()ing all peers. */
+
+struct sync_watch {
+
+  u8  *peer;                            /* Name of the peer directory       */
+  s32  wd;                              /* inotify watch descriptor or -1   */
+  u8   rescan;                          /* Events lost, do a full scan      */
+  u8 **names;                           /* New files reported by inotify    */
+  u32  name_cnt,                        /* Number of names                  */
+      name_max;                         /* Allocated name slots             */
+
 };
 
 struct extra_data {
@@ -459,14 +502,18 @@ typedef struct afl_env_vars {
       afl_no_startup_calibration, afl_no_warn_instability,
       afl_post_process_keep_original, afl_crashing_seeds_as_new_crash,
       afl_final_sync, afl_ignore_seed_problems, afl_disable_redundant,
-      afl_sha1_filenames, afl_no_sync, afl_no_fastresume;
+      afl_sha1_filenames, afl_no_sync, afl_no_fastresume, afl_trace_mini_file,
+      afl_pack_corpus, afl_sync_inotify, afl_sync_bus, afl_havoc_bandit,
+      afl_cal_adaptive, afl_no_stats_text, afl_metrics;
 
   u8 *afl_tmpdir, *afl_custom_mutator_library, *afl_python_module, *afl_path,
       *afl_hang_tmout, *afl_forksrv_init_tmout, *afl_preload,
       *afl_max_det_extras, *afl_statsd_host, *afl_statsd_port,
       *afl_crash_exitcode, *afl_statsd_tags_flavor, *afl_testcache_size,
       *afl_testcache_entries, *afl_child_kill_signal, *afl_fsrv_kill_signal,
-      *afl_target_env, *afl_persistent_record, *afl_exit_on_time;
+      *afl_target_env, *afl_persistent_record, *afl_exit_on_time,
+      *afl_cal_jobs, *afl_cmplog_jobs, *afl_trim_jobs, *afl_metrics_host,
+      *afl_metrics_port;
 
   s32 afl_pizza_mode;
 
@@ -608,6 +655,9 @@ typedef struct afl_state {
   u32     active_items;                 /* enabled entries in the queue     */
 
   u8 *var_bytes;                        /* Bytes that appear to be variable */
+  u32 *var_edges;                       /* The same as a list (see below)   */
+  u32  var_edges_cnt;
+  u8   var_edges_built;                 /* var_edges matches var_bytes      */
 
 #define N_FUZZ_SIZE (1 << 21)
   u32 *n_fuzz;
@@ -684,7 +734,11 @@ typedef struct afl_state {
   u8 stage_val_type;                    /* Value type (STAGE_VAL_*)         */
 
   u64 stage_finds[32],                  /* Patterns found per fuzz stage    */
-      stage_cycles[32];                 /* Execs per fuzz stage             */
+      stage_cycles[32],                 /* Execs per fuzz stage             */
+      stage_ticks[32];                  /* get_cur_tsc() time per stage     */
+
+  u64 stage_tsc,                        /* Start of the stage being timed   */
+      tsc_start, tsc_start_us;          /* Reference for stage_ticks        */
 
   u32 rand_cnt;                         /* Random number counter            */
 
@@ -693,7 +747,8 @@ typedef struct afl_state {
   s64             init_seed;
 
   u64 total_cal_us,                     /* Total calibration time (us)      */
-      total_cal_cycles;                 /* Total calibration cycles         */
+      total_cal_cycles,                 /* Total calibration cycles         */
+      calibration_execs;                /* Execs done to calibrate          */
 
   u64 total_bitmap_size,                /* Total bit count for all bitmaps  */
       total_bitmap_entries;             /* Number of bitmaps counted        */
@@ -714,6 +769,8 @@ typedef struct afl_state {
 
   struct queue_entry **top_rated;           /* Top entries for bitmap bytes */
 
+  struct trace_mini_store tm_store;     /* Storage for all trace_mini maps  */
+
   struct extra_data *extras;            /* Extra tokens to fuzz with        */
   u32                extras_cnt;        /* Total number of tokens read      */
 
@@ -721,12 +778,48 @@ typedef struct afl_state {
       a_extras[MAX_AUTO_EXTRAS];        /* Automatically selected extras    */
   u32 a_extras_cnt;                     /* Total number of tokens available */
 
+  struct extras_index *extras_index;    /* Trie over all tokens, or NULL    */
+
   /* afl_postprocess API - Now supported via custom mutators */
 
+  /* Packed corpus files (AFL_PACK_CORPUS), -1 if not used */
+  s32 pack_fd[AFL_PACK_KINDS], pack_idx_fd[AFL_PACK_KINDS];
+
+  /* Event driven syncing (AFL_SYNC_INOTIFY) */
+  s32                sync_inotify_fd;   /* inotify instance or -1           */
+  struct sync_watch *sync_watches;      /* One watch per peer               */
+  u32                sync_watch_cnt;    /* Number of watches                */
+
+  /* Shared memory sync bus (AFL_SYNC_BUS) */
+  struct stats_page    *stats_page;     /* Mapped fuzzer_stats.bin or NULL  */
+  struct metrics       *metrics;        /* OpenMetrics endpoint or NULL     */
+  struct sync_bus      *sync_bus;       /* Mapped bus or NULL               */
+  struct sync_bus_skip *sync_bus_skip;  /* Peer entries without new bits    */
+  u64                   sync_bus_tail;  /* Next bus record to look at       */
+  u64                   sync_bus_target;  /* Identity of target and mode  */
+  u64                   sync_bus_skipped;  /* Sync executions saved         */
+  u32                   sync_bus_peer;  /* hash32() of our sync id          */
+  u32                   sync_bus_records;  /* Ring size of the mapped bus   */
+
+  struct splice_index *splice_index;    /* Anchors of the queue entries     */
+
+  /* Trimming */
+  struct exec_pool *trim_pool;          /* Helpers for trimming or NULL     */
+  u8                trim_pool_tried;    /* AFL_TRIM_JOBS was looked at      */
+  u64 trim_step_tries[32],              /* Removals tried, by log2 of size  */
+      trim_step_hits[32],               /* Removals that kept the path      */
+      trim_step_skips[32];              /* Times the size was left out      */
+  u64 trim_steps_skipped;               /* Step sizes left out in total     */
+
+  /* Havoc operator statistics (AFL_HAVOC_BANDIT) */
+  struct havoc_bandit *havoc_bandit;    /* Learned operator odds or NULL    */
+
   /* CmpLog */
 
   char            *cmplog_binary;
   afl_forkserver_t cmplog_fsrv;     /* cmplog has its own little forkserver */
+  struct exec_pool *cmplog_pool;    /* Helpers for colorization or NULL     */
+  u8                cmplog_pool_tried;  /* AFL_CMPLOG_JOBS was looked at    */
 
   /* Custom mutators */
   struct custom_mutator *mutator;
@@ -737,6 +830,7 @@ typedef struct afl_state {
   u32 cmplog_max_filesize;
   u32 cmplog_lvl;
   u32 colorize_success;
+  u64 cmplog_unchanged;                 /* Comparisons solved by the mother */
   u8  cmplog_enable_arith, cmplog_enable_transform, cmplog_enable_scale,
       cmplog_enable_xtreme_transform, cmplog_random_colorization;
 
@@ -800,6 +894,8 @@ typedef struct afl_state {
 
   u8 *ex_buf;
 
+  u8 *tok_end_buf;
+
   u8 *testcase_buf, *splicecase_buf;
 
   u32 custom_mutators_count;
@@ -839,6 +935,12 @@ typedef struct afl_state {
   /* How often did we evict from the cache (for statistics only) */
   u32 q_testcase_evictions;
 
+  /* Cache hits and testcase loads from disk (for statistics only) */
+  u64 q_testcase_hits, q_testcase_misses;
+
+  /* Position of the CLOCK hand in q_testcase_cache for eviction */
+  u32 q_testcase_clock_hand;
+
   /* Refs to each queue entry with cached testcase (for eviction, if cache_count
    * is too large) */
   struct queue_entry **q_testcase_cache;
@@ -1175,6 +1277,9 @@ void mark_as_redundant(afl_state_t *, struct queue_entry *, u8);
 void add_to_queue(afl_state_t *, u8 *, u32, u8);
 void destroy_queue(afl_state_t *);
 void update_bitmap_score(afl_state_t *, struct queue_entry *);
+u8  *trace_mini_alloc(afl_state_t *);
+void trace_mini_free(afl_state_t *, u8 *);
+void trace_mini_store_destroy(afl_state_t *);
 void cull_queue(afl_state_t *);
 u32  calculate_score(afl_state_t *, struct queue_entry *);
 
@@ -1196,6 +1301,7 @@ void minimize_bits(afl_state_t *, u8 *, u8 *);
 u8 *describe_op(afl_state_t *, u8, size_t);
 #endif
 u8 save_if_interesting(afl_state_t *, void *, u32, u8);
+void pack_save(afl_state_t *, u8, u32, u8 *, u8 *, u32);
 u8 has_new_bits(afl_state_t *, u8 *);
 u8 has_new_bits_unclassified(afl_state_t *, u8 *);
 #ifndef AFL_SHOWMAP
@@ -1210,15 +1316,84 @@ void dedup_extras(afl_state_t *);
 void deunicode_extras(afl_state_t *);
 void add_extra(afl_state_t *afl, u8 *mem, u32 len);
 void maybe_add_auto(afl_state_t *, u8 *, u32);
+void extras_index_ends(afl_state_t *, u8 *, u32, u8 *);
 void save_auto(afl_state_t *);
 void load_auto(afl_state_t *);
 void destroy_extras(afl_state_t *);
 
+/* Sync bus */
+
+void sync_bus_init(afl_state_t *);
+void sync_bus_destroy(afl_state_t *);
+void sync_bus_publish(afl_state_t *, u32, u8 *, u32);
+void sync_bus_read(afl_state_t *);
+u8   sync_bus_known(afl_state_t *, u8 *, u32, u8 *, u32);
+
+/* Helper forkservers */
+
+struct fsrv_helper {
+
+  afl_forkserver_t fsrv;
+  sharedmem_t      shm, shm_fuzz;
+
+};
+
+struct exec_job {
+
+  u8 *buf;                              /* Input to run                     */
+  u32 len;
+  u8  fault;                            /* Result of afl_fsrv_run_target()  */
+  u8  kill_signal;
+  u64 exec_us;
+  u8 *trace;                            /* Raw trace, map_size bytes        */
+
+};
+
+struct exec_pool;
+
+u8                  fsrv_helpers_possible(afl_state_t *, u8 *);
+struct fsrv_helper *fsrv_helpers_start(afl_state_t *, u32, u8 *);
+void                fsrv_helpers_stop(struct fsrv_helper *, u32);
+struct exec_pool   *exec_pool_start(afl_state_t *, u32, u8 *, u8 *);
+u32                 exec_pool_size(struct exec_pool *);
+void exec_pool_run(struct exec_pool *, struct exec_job *, u32);
+void exec_pool_stop(struct exec_pool *);
+
+/* Parallel calibration */
+
+struct cal_pool;
+
+struct cal_pool *cal_pool_start(afl_state_t *);
+u8               cal_pool_take(struct cal_pool *, u32, struct queue_entry *);
+void             cal_pool_stop(struct cal_pool *);
+
+/* Splice index */
+
+struct splice_index;
+
+void splice_index_add(afl_state_t *, struct queue_entry *, u8 *, u32);
+u8   splice_index_pick(afl_state_t *, struct queue_entry *, u32 *, u32 *,
+                       u32 *);
+void splice_index_destroy(afl_state_t *);
+
+/* Havoc operator bandit */
+
+struct havoc_bandit;
+
+void bandit_init(afl_state_t *);
+void bandit_save(afl_state_t *);
+u32  bandit_table(afl_state_t *, u8, u32 **, u32);
+u32  bandit_depth(afl_state_t *, u8, u32);
+void bandit_update(afl_state_t *, u8, u64, u32, u8);
+
 /* Stats */
 
 void load_stats_file(afl_state_t *);
 void write_setup_file(afl_state_t *, u32, char **);
 void write_stats_file(afl_state_t *, u32, double, double, double);
+void stats_page_init(afl_state_t *);
+void stats_page_destroy(afl_state_t *);
+void stats_page_update(afl_state_t *, u32, double, double, double);
 void maybe_update_plot_file(afl_state_t *, u32, double, double);
 void write_queue_stats(afl_state_t *);
 void show_stats(afl_state_t *);
@@ -1231,6 +1406,13 @@ void update_trim_time(afl_state_t *afl, u64 *time);
 void update_sync_time(afl_state_t *afl, u64 *time);
 void update_cmplog_time(afl_state_t *afl, u64 *time);
 
+/* OpenMetrics */
+
+struct metrics;
+
+void metrics_init(afl_state_t *);
+void metrics_destroy(afl_state_t *);
+
 /* StatsD */
 
 void statsd_setup_format(afl_state_t *afl);
@@ -1242,9 +1424,11 @@ int  statsd_format_metric(afl_state_t *afl, char *buff, size_t bufflen);
 
 void sync_fuzzers(afl_state_t *);
 u32  write_to_testcase(afl_state_t *, void **, u32, u32);
+void calibrate_fsrv_start(afl_state_t *);
 u8   calibrate_case(afl_state_t *, struct queue_entry *, u8 *, u32, u8);
 u8   trim_case(afl_state_t *, struct queue_entry *, u8 *);
 u8   common_fuzz_stuff(afl_state_t *, u8 *, u32);
+u8   common_fuzz_result(afl_state_t *, u8 *, u32, u8);
 fsrv_run_result_t fuzz_run_target(afl_state_t *, afl_forkserver_t *fsrv, u32);
 
 /* Fuzz one */
@@ -1272,6 +1456,7 @@ int    check_main_node_exists(afl_state_t *);
 u32    select_next_queue_entry(afl_state_t *afl);
 void   create_alias_table(afl_state_t *afl);
 void   setup_dirs_fds(afl_state_t *);
+void   setup_pack_files(afl_state_t *);
 void   setup_cmdline_file(afl_state_t *, char **);
 void   setup_stdio_file(afl_state_t *);
 void   check_crash_handling(void);
@@ -1313,15 +1498,10 @@ void plot_profile_data(afl_state_t *, struct queue_entry *);
 
 /**** Inline routines ****/
 
-/* Generate a random number (from 0 to limit - 1). This may
-   have slight bias. */
+/* Count one draw and reseed from /dev/urandom every RESEED_RNG draws. */
 
-static inline u32 rand_below(afl_state_t *afl, u32 limit) {
-
-  if (unlikely(limit <= 1)) return 0;
+static inline void rand_reseed_check(afl_state_t *afl) {
 
-  /* The boundary not being necessarily a power of 2,
-     we need to ensure the result uniformity. */
   if (unlikely(!afl->rand_cnt--) && likely(!afl->fixed_seed)) {
 
     ck_read(afl->fsrv.dev_urandom_fd, &afl->rand_seed, sizeof(afl->rand_seed),
@@ -1331,18 +1511,51 @@ static inline u32 rand_below(afl_state_t *afl, u32 limit) {
 
   }
 
-  /* Modulo is biased - we don't want our fuzzing to be biased so let's do it
-   right. See:
-   https://stackoverflow.com/questions/10984974/why-do-people-say-there-is-modulo-bias-when-using-a-random-number-generator
-   */
-  u64 unbiased_rnd;
-  do {
+}
+
+/* Generate a random number (from 0 to limit - 1) without bias, using
+   Lemire's multiply-shift method: the upper half of rnd * limit is the
+   result, and only if the lower half falls below limit a division is
+   needed to check whether the draw has to be rejected. See:
+   https://arxiv.org/abs/1805.10941 */
+
+static inline u32 rand_below(afl_state_t *afl, u32 limit) {
+
+  if (unlikely(limit <= 1)) return 0;
+
+  rand_reseed_check(afl);
+
+#ifdef WORD_SIZE_64
+  __uint128_t m = (__uint128_t)rand_next(afl) * limit;
+
+  if (unlikely((u64)m < limit)) {
+
+    u64 threshold = -(u64)limit % limit;
+    while ((u64)m < threshold) {
 
-    unbiased_rnd = rand_next(afl);
+      m = (__uint128_t)rand_next(afl) * limit;
 
-  } while (unlikely(unbiased_rnd >= (UINT64_MAX - (UINT64_MAX % limit))));
+    }
+
+  }
+
+  return m >> 64;
+#else
+  u64 m = (u64)rand_next(afl) * limit;
+
+  if (unlikely((u32)m < limit)) {
 
-  return unbiased_rnd % limit;
+    u32 threshold = -limit % limit;
+    while ((u32)m < threshold) {
+
+      m = (u64)rand_next(afl) * limit;
+
+    }
+
+  }
+
+  return m >> 32;
+#endif
 
 }
 
@@ -1382,6 +1595,48 @@ static inline s64 rand_get_seed(afl_state_t *afl) {
 /* initialize randomness with a given seed. Can be called again at any time. */
 void rand_set_seed(afl_state_t *afl, s64 init_seed);
 
+/* A cheap timestamp for the per stage accounting, in an unknown unit.
+   write_stats_file() converts it with the rate seen since the start. */
+
+static inline u64 get_cur_tsc(void) {
+
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+  u64 val;
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(val));
+  return val;
+#else
+  return get_cur_time_us();
+#endif
+
+}
+
+/* Start timing a stage. */
+
+static inline void stage_time_mark(afl_state_t *afl) {
+
+  afl->stage_tsc = get_cur_tsc();
+
+}
+
+/* Charge the time since the last mark to stage, the next stage starts
+   now. The TSC of another core may be behind, such a sample is dropped. */
+
+static inline void stage_time_account(afl_state_t *afl, u32 stage) {
+
+  u64 now = get_cur_tsc();
+
+  if (likely(now > afl->stage_tsc)) {
+
+    afl->stage_ticks[stage] += now - afl->stage_tsc;
+
+  }
+
+  afl->stage_tsc = now;
+
+}
+
 /* Find first power of two greater or equal to val (assuming val under
    2^63). */
 
@@ -33,6 +33,11 @@
 
 #define MUT_STRATEGY_ARRAY_SIZE 256
 
+/* afl_mutate() picks operations with 8 random bits each */
+#if MUT_STRATEGY_ARRAY_SIZE != 256
+  #error MUT_STRATEGY_ARRAY_SIZE must be 256 - BUG!
+#endif
+
 #ifndef INTERESTING_32
   #error INTERESTING_32 is not defined - BUG!
 #endif
@@ -1860,11 +1865,27 @@ inline u32 afl_mutate(afl_state_t *afl, u8 *buf, u32 len, u32 steps,
 
   }
 
+  /* The strategy arrays have 256 entries, so one random number picks the
+     operations of as many steps as it has bytes. */
+
+  AFL_RAND_RETURN op_rnd = 0;
+  u32             op_left = 0;
+
   for (u32 step = 0; step < steps; ++step) {
 
   retry_havoc_step: {
 
-    u32 r = rand_below(afl, MUT_STRATEGY_ARRAY_SIZE), item;
+    if (unlikely(!op_left)) {
+
+      rand_reseed_check(afl);
+      op_rnd = rand_next(afl);
+      op_left = sizeof(AFL_RAND_RETURN);
+
+    }
+
+    u32 r = op_rnd & (MUT_STRATEGY_ARRAY_SIZE - 1), item;
+    op_rnd >>= 8;
+    --op_left;
 
     switch (mutation_array[r]) {
 
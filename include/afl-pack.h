@@ -0,0 +1,236 @@
+/*
+   american fuzzy lop++ - packed corpus format
+   -------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                     Heiko Eissfeldt <heiko.eissfeldt@hexco.de>,
+                     Andrea Fioraldi <andreafioraldi@gmail.com>,
+                     Dominik Maier <mail@dmnk.co>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   A pack is an append-only log of testcases (e.g. out/default/queue.pack)
+   plus an index file (queue.pack.idx) holding one u64 file offset per
+   record. Every record is a struct afl_pack_record followed by desc_len
+   bytes of description (the classic file name) and len bytes of data.
+
+   The writer appends the record first and its offset to the index second,
+   so readers that only look at records listed in the index never see a
+   partially written record. There is exactly one writer per pack.
+
+ */
+
+#ifndef _AFL_PACK_H
+#define _AFL_PACK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "config.h"
+#include "types.h"
+#include "debug.h"
+#include "alloc-inl.h"
+
+#define AFL_PACK_MAGIC 0x4b434150U                                /* "PACK" */
+#define AFL_PACK_NO_PARENT 0xffffffffU
+
+enum {
+
+  /* 00 */ AFL_PACK_QUEUE,
+  /* 01 */ AFL_PACK_CRASHES,
+  /* 02 */ AFL_PACK_HANGS,
+
+  AFL_PACK_KINDS
+
+};
+
+static const char *afl_pack_names[AFL_PACK_KINDS]
+    __attribute__((unused)) = {"queue", "crashes", "hangs"};
+
+struct afl_pack_record {
+
+  u32 magic;                            /* AFL_PACK_MAGIC                   */
+  u32 id;                               /* id of the entry in its directory */
+  u32 parent;                           /* id of the parent queue entry     */
+  u32 len;                              /* length of the testcase data      */
+  u64 time_ms;                          /* run time when it was found       */
+  u16 desc_len;                         /* length of the description        */
+  u16 kind;                             /* AFL_PACK_QUEUE etc.              */
+  u32 reserved;
+
+};
+
+/* Open (and create) the pack fn and its index for appending. */
+
+static inline void afl_pack_open(u8 *fn, s32 *fd, s32 *idx_fd, u8 truncate) {
+
+  u8  idx_fn[PATH_MAX];
+  s32 flags = O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0);
+
+  snprintf((char *)idx_fn, PATH_MAX, "%s.idx", fn);
+
+  *fd = open((char *)fn, flags, DEFAULT_PERMISSION);
+  if (*fd < 0) { PFATAL("Unable to create '%s'", fn); }
+
+  *idx_fd = open((char *)idx_fn, flags, DEFAULT_PERMISSION);
+  if (*idx_fd < 0) { PFATAL("Unable to create '%s'", idx_fn); }
+
+}
+
+/* Open an existing pack read-only. Returns 0 on success. */
+
+static inline s32 afl_pack_open_ro(u8 *fn, s32 *fd, s32 *idx_fd) {
+
+  u8 idx_fn[PATH_MAX];
+
+  snprintf((char *)idx_fn, PATH_MAX, "%s.idx", fn);
+
+  if ((*idx_fd = open((char *)idx_fn, O_RDONLY)) < 0) { return -1; }
+
+  if ((*fd = open((char *)fn, O_RDONLY)) < 0) {
+
+    close(*idx_fd);
+    return -1;
+
+  }
+
+  return 0;
+
+}
+
+/* Number of complete records in the pack. */
+
+static inline u32 afl_pack_count(s32 idx_fd) {
+
+  struct stat st;
+
+  if (fstat(idx_fd, &st)) { return 0; }
+  return st.st_size / sizeof(u64);
+
+}
+
+/* Append one record. */
+
+static inline void afl_pack_append(s32 fd, s32 idx_fd,
+                                   struct afl_pack_record *rec, const u8 *desc,
+                                   const u8 *data) {
+
+  struct iovec iov[3];
+  u64          off = lseek(fd, 0, SEEK_END);
+  ssize_t      want =
+      sizeof(struct afl_pack_record) + rec->desc_len + rec->len;
+
+  rec->magic = AFL_PACK_MAGIC;
+
+  iov[0].iov_base = rec;
+  iov[0].iov_len = sizeof(struct afl_pack_record);
+  iov[1].iov_base = (void *)desc;
+  iov[1].iov_len = rec->desc_len;
+  iov[2].iov_base = (void *)data;
+  iov[2].iov_len = rec->len;
+
+  if (writev(fd, iov, 3) != want) { RPFATAL(-1, "Short write to pack"); }
+
+  if (pwrite(idx_fd, &off, sizeof(u64),
+             (off_t)afl_pack_count(idx_fd) * sizeof(u64)) != sizeof(u64)) {
+
+    RPFATAL(-1, "Short write to pack index");
+
+  }
+
+}
+
+/* Read record nr. Returns a ck_alloc()ed buffer with the data, followed by
+   the zero terminated description, or NULL if the record is broken. */
+
+static inline u8 *afl_pack_read(s32 fd, s32 idx_fd, u32 nr,
+                                struct afl_pack_record *rec) {
+
+  u64 off;
+  u8 *buf;
+
+  if (pread(idx_fd, &off, sizeof(u64), (off_t)nr * sizeof(u64)) !=
+      sizeof(u64)) {
+
+    return NULL;
+
+  }
+
+  if (pread(fd, rec, sizeof(struct afl_pack_record), off) !=
+          sizeof(struct afl_pack_record) ||
+      rec->magic != AFL_PACK_MAGIC || rec->len > MAX_FILE) {
+
+    return NULL;
+
+  }
+
+  buf = ck_alloc_nozero(rec->len + rec->desc_len + 1);
+
+  if (pread(fd, buf + rec->len, rec->desc_len,
+            off + sizeof(struct afl_pack_record)) != rec->desc_len ||
+      pread(fd, buf, rec->len,
+            off + sizeof(struct afl_pack_record) + rec->desc_len) !=
+          rec->len) {
+
+    ck_free(buf);
+    return NULL;
+
+  }
+
+  buf[rec->len + rec->desc_len] = 0;
+  return buf;
+
+}
+
+/* Load a single testcase given as "path/to/x.pack:<nr>". Returns NULL if
+   spec does not have this form, FATALs if the record cannot be read. */
+
+static inline u8 *afl_pack_load_spec(u8 *spec, u32 *len) {
+
+  struct afl_pack_record rec;
+  u8                     fn[PATH_MAX], *colon, *buf, *end;
+  s32                    fd, idx_fd;
+  u32                    nr;
+
+  colon = (u8 *)strrchr((char *)spec, ':');
+  if (!colon || colon - spec < 5 || strncmp((char *)colon - 5, ".pack", 5)) {
+
+    return NULL;
+
+  }
+
+  nr = strtoul((char *)colon + 1, (char **)&end, 10);
+  if (end == colon + 1 || *end) { return NULL; }
+
+  snprintf((char *)fn, PATH_MAX, "%.*s", (int)(colon - spec), spec);
+  if (afl_pack_open_ro(fn, &fd, &idx_fd)) {
+
+    PFATAL("Unable to open '%s'", fn);
+
+  }
+
+  buf = afl_pack_read(fd, idx_fd, nr, &rec);
+  if (!buf) { FATAL("Unable to read record %u from '%s'", nr, fn); }
+
+  close(fd);
+  close(idx_fd);
+
+  *len = rec.len;
+  return buf;
+
+}
+
+#endif                                                      /* _AFL_PACK_H */
+
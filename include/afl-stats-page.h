@@ -0,0 +1,223 @@
+/*
+   american fuzzy lop++ - binary stats page layout
+   -----------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                     Heiko Eissfeldt <heiko.eissfeldt@hexco.de>,
+                     Andrea Fioraldi <andreafioraldi@gmail.com>,
+                     Dominik Maier <mail@dmnk.co>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   Layout of out_dir/fuzzer_stats.bin, which afl-fuzz keeps mapped and
+   updates in place on every UI refresh. It holds the numbers of
+   fuzzer_stats and the last STATS_PAGE_SAMPLES lines of plot_data.
+
+   Both parts are guarded by a sequence lock: the writer makes seq odd,
+   updates the data and makes seq even again. A reader copies the data and
+   only trusts the copy if seq was the same even number before and after.
+   stats_page_read() and stats_page_read_samples() below do that, so tools
+   only need to mmap() the file read-only.
+
+ */
+
+#ifndef _AFL_STATS_PAGE_H
+#define _AFL_STATS_PAGE_H
+
+#include <string.h>
+
+#include "config.h"
+#include "types.h"
+
+#define STATS_PAGE_MAGIC 0x50545341U                              /* "ASTP" */
+#define STATS_PAGE_VERSION 2
+#define STATS_PAGE_FILE "fuzzer_stats.bin"
+
+/* Read attempts before a reader gives up on a page that is written to all
+   the time: */
+
+#define STATS_PAGE_READ_TRIES 1000
+
+/* The fuzzer_stats numbers. Times are in ms since the epoch, durations in
+   ms unless noted otherwise. */
+
+struct stats_page_data {
+
+  u64 start_time;                       /* Start of this session            */
+  u64 last_update;                      /* Last update of the page          */
+  u64 run_time;                         /* Run time including resumes       */
+  u64 fuzz_time, calibration_time,      /* Run time by activity             */
+      cmplog_time, sync_time, trim_time;
+  u64 cycles_done, cycles_wo_finds;
+  u64 execs_done, calibration_execs;
+  u64 saved_crashes, saved_hangs;
+  u64 last_find, last_crash, last_hang;  /* 0 if there was none             */
+  u64 execs_since_crash;
+  u64 total_crashes, total_tmouts, saved_tmouts;
+  u64 trim_execs, bytes_trim_in, bytes_trim_out, trim_steps_skipped;
+  u64 sync_skipped, cmplog_unchanged;
+  u64 testcache_size, testcache_hits, testcache_misses;
+
+  double execs_per_sec;                 /* Over the run time                */
+  double execs_ps_last_min;
+  double execs_ps_now;                  /* As shown in the UI               */
+  double stability, bitmap_cvg;         /* Percent                          */
+
+  u32 corpus_count, corpus_favored, corpus_found, corpus_imported,
+      corpus_variable;
+  u32 max_depth, cur_item, pending_favs, pending_total;
+  u32 edges_found, total_edges, var_byte_count;
+  u32 exec_timeout, slowest_exec_ms;    /* The -t value, slowest exec       */
+  u32 corpus_with_cov, havoc_expansion, auto_dict_entries;
+  u32 testcache_count, testcache_evict, skipdet_reused;
+  u32 fuzzer_pid;
+  u32 stopped;                          /* afl-fuzz exited normally         */
+
+  char banner[64];                      /* Sync id or target name           */
+
+};
+
+/* One plot_data line. */
+
+struct stats_page_sample {
+
+  u64    relative_time;                 /* Run time in seconds              */
+  u64    cycles_done, execs_done;
+  u64    saved_crashes, saved_hangs;
+  double bitmap_cvg, execs_per_sec;
+  u32    cur_item, corpus_count, pending_total, pending_favs;
+  u32    max_depth, edges_found;
+
+};
+
+struct stats_page {
+
+  u32 magic;                            /* STATS_PAGE_MAGIC                 */
+  u32 version;                          /* STATS_PAGE_VERSION               */
+  u32 size;                             /* sizeof(struct stats_page)        */
+  u32 samples;                          /* STATS_PAGE_SAMPLES               */
+
+  u64                    seq;           /* Guards data                      */
+  struct stats_page_data data;
+
+  u64                      sample_seq;  /* Guards sample_head and sample    */
+  u64                      sample_head;  /* Number of samples ever added    */
+  struct stats_page_sample sample[STATS_PAGE_SAMPLES];
+
+};
+
+/* Returns 1 if the mapped file of len bytes is a page we can read. */
+
+static inline u8 stats_page_valid(const struct stats_page *p, u64 len) {
+
+  return len >= sizeof(struct stats_page) &&
+         __atomic_load_n(&p->magic, __ATOMIC_ACQUIRE) == STATS_PAGE_MAGIC &&
+         p->version == STATS_PAGE_VERSION &&
+         p->size == sizeof(struct stats_page) &&
+         p->samples == STATS_PAGE_SAMPLES;
+
+}
+
+static inline void stats_page_write_begin(u64 *seq) {
+
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+}
+
+static inline void stats_page_write_end(u64 *seq) {
+
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+
+}
+
+/* Copy len bytes at src, which are guarded by seq, to dst. Returns 0 on
+   success, -1 if no consistent copy could be made. */
+
+static inline int stats_page_copy(const u64 *seq, void *dst, const void *src,
+                                  u64 len) {
+
+  for (u32 i = 0; i < STATS_PAGE_READ_TRIES; ++i) {
+
+    u64 before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+    if (before & 1) { continue; }
+
+    memcpy(dst, src, len);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(seq, __ATOMIC_RELAXED) == before) { return 0; }
+
+  }
+
+  return -1;
+
+}
+
+static inline int stats_page_read(const struct stats_page *p,
+                                  struct stats_page_data *d) {
+
+  return stats_page_copy(&p->seq, d, &p->data, sizeof(*d));
+
+}
+
+static inline void stats_page_reverse(struct stats_page_sample *s, u32 a,
+                                      u32 b) {
+
+  while (a + 1 < b) {
+
+    struct stats_page_sample tmp = s[a];
+    s[a++] = s[--b];
+    s[b] = tmp;
+
+  }
+
+}
+
+/* Copy the samples in the order they were added to out, which must hold
+   STATS_PAGE_SAMPLES of them. Returns their number or -1. */
+
+static inline int stats_page_read_samples(const struct stats_page *p,
+                                          struct stats_page_sample *out) {
+
+  u64 head = 0;
+  u32 cnt, first, i;
+
+  for (i = 0; i < STATS_PAGE_READ_TRIES; ++i) {
+
+    u64 before = __atomic_load_n(&p->sample_seq, __ATOMIC_ACQUIRE);
+    if (before & 1) { continue; }
+
+    head = p->sample_head;
+    memcpy(out, p->sample, sizeof(p->sample));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&p->sample_seq, __ATOMIC_RELAXED) == before) { break; }
+
+  }
+
+  if (i == STATS_PAGE_READ_TRIES) { return -1; }
+
+  /* Rotate the oldest sample to the front. */
+
+  cnt = head < STATS_PAGE_SAMPLES ? head : STATS_PAGE_SAMPLES;
+  first = head % STATS_PAGE_SAMPLES;
+
+  if (cnt == STATS_PAGE_SAMPLES && first) {
+
+    stats_page_reverse(out, 0, first);
+    stats_page_reverse(out, first, STATS_PAGE_SAMPLES);
+    stats_page_reverse(out, 0, STATS_PAGE_SAMPLES);
+
+  }
+
+  return cnt;
+
+}
+
+#endif                                                /* _AFL_STATS_PAGE_H */
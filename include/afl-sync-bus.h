@@ -0,0 +1,65 @@
+/*
+   american fuzzy lop++ - shared memory sync bus layout
+   ----------------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                     Heiko Eissfeldt <heiko.eissfeldt@hexco.de>,
+                     Andrea Fioraldi <andreafioraldi@gmail.com>,
+                     Dominik Maier <mail@dmnk.co>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   Layout of sync_dir/.sync_bus (AFL_SYNC_BUS), shared by afl-fuzz and the
+   tools in utils/ that read it. A writer claims record number n by
+   incrementing head, stores 0 in rec[n % records].seq, fills in the record
+   and finally stores n + 1 in seq. A reader only trusts a record if seq is
+   n + 1 both before and after reading it.
+
+ */
+
+#ifndef _AFL_SYNC_BUS_H
+#define _AFL_SYNC_BUS_H
+
+#include "config.h"
+#include "types.h"
+
+#define SYNC_BUS_MAGIC 0x53554241U                                /* "ABUS" */
+
+struct sync_bus_record {
+
+  u64 seq;                              /* Record number + 1, 0 if writing  */
+  u64 target;                           /* Identity of the target           */
+  u64 input_hash;                       /* hash64() of the input            */
+  u32 peer;                             /* hash32() of the sync id          */
+  u32 id;                               /* Queue id at the peer             */
+  u32 pair_cnt;                         /* Number of (index, value) pairs   */
+  u32 map_size;                         /* Map size of the peer             */
+  u32 idx[SYNC_BUS_MAX_PAIRS];          /* Map indices                      */
+  u8  val[SYNC_BUS_MAX_PAIRS];          /* Classified counts                */
+
+};
+
+struct sync_bus {
+
+  u32 magic;                            /* SYNC_BUS_MAGIC                   */
+  u32 records;                          /* Size of the ring                 */
+  u32 max_pairs;                        /* SYNC_BUS_MAX_PAIRS               */
+  u32 record_size;                      /* sizeof(struct sync_bus_record)   */
+  u64 head;                             /* Number of records ever claimed   */
+  u64 padding[5];
+
+  struct sync_bus_record rec[];
+
+};
+
+#define SYNC_BUS_BYTES(records) \
+  (sizeof(struct sync_bus) + (u64)(records) * sizeof(struct sync_bus_record))
+
+#endif                                                  /* _AFL_SYNC_BUS_H */
+
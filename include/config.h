@@ -97,6 +97,9 @@
 /* Maximum allowed fails per CMP value. Default: 96 */
 #define CMPLOG_FAIL_MAX 96
 
+/* Maximum number of forkservers for AFL_CMPLOG_JOBS */
+#define CMPLOG_JOBS_MAX 64U
+
 /* -------------------------------------*/
 /* Now non-cmplog configuration options */
 /* -------------------------------------*/
@@ -144,6 +147,13 @@
 #define STATSD_DEFAULT_PORT 8125
 #define STATSD_DEFAULT_HOST "127.0.0.1"
 
+/* OpenMetrics endpoint, see AFL_METRICS, AFL_METRICS_HOST and
+   AFL_METRICS_PORT. The page is served from the numbers published for the
+   UI, so it is at most one UI refresh old. */
+
+#define METRICS_DEFAULT_PORT 9464
+#define METRICS_DEFAULT_HOST "127.0.0.1"
+
 /* If you want to have the original afl internal memory corruption checks.
    Disabled by default for speed. it is better to use "make ASAN_BUILD=1". */
 
@@ -188,6 +198,27 @@
 #define CAL_CYCLES 7U
 #define CAL_CYCLES_LONG 12U
 
+/* With AFL_CAL_ADAPTIVE calibration stops after CAL_CYCLES_MIN runs with
+   the same trace that hit no known variable edge, if the slowest run took
+   at most CAL_STABLE_PERC percent of the fastest one plus
+   CAL_STABLE_SLACK_US: */
+
+#define CAL_CYCLES_MIN 2U
+#define CAL_STABLE_PERC 125U
+#define CAL_STABLE_SLACK_US 50U
+
+/* Maximum number of forkservers for AFL_CAL_JOBS, and how many seeds each
+   of them may calibrate ahead of the dry run: */
+
+#define CAL_JOBS_MAX 64U
+#define CAL_JOBS_AHEAD 8U
+
+/* Maximum number of forkservers for afl-showmap -M (afl-cmin -T), and how
+   many traces each of them may buffer ahead: */
+
+#define CMIN_TASKS_MAX 256U
+#define CMIN_TASK_AHEAD 16U
+
 /* Number of subsequent timeouts before abandoning an input file: */
 
 #define TMOUT_LIMIT 250U
@@ -227,6 +258,14 @@
 
 #define HAVOC_STACK_POW2 4U
 
+/* AFL_HAVOC_BANDIT: share of the operator table that follows the default
+   distribution, havoc executions of an input class before its statistics
+   are used, and executions after which older statistics count half: */
+
+#define HAVOC_BANDIT_EXPLORE 0.25
+#define HAVOC_BANDIT_WARMUP 10000
+#define HAVOC_BANDIT_HALFLIFE 2000000
+
 /* Caps on block sizes for cloning and deletion operations. Each of these
    ranges has a 33% probability of getting picked, except for the first
    two cycles where smaller blocks are favored: */
@@ -250,6 +289,14 @@
 
 #define SPLICE_CYCLES 15
 
+/* Splice index: anchors kept per queue entry, zero bits of the gear hash
+   that make an anchor (so one every 2^n bytes on average), and the
+   smallest offset of an anchor: */
+
+#define SPLICE_ANCHORS 8
+#define SPLICE_ANCHOR_BITS 6
+#define SPLICE_ANCHOR_MIN 8
+
 /* Nominal per-splice havoc cycle length: */
 
 #define SPLICE_HAVOC 32
@@ -265,6 +312,14 @@
 #define TRIM_START_STEPS 16
 #define TRIM_END_STEPS 1024
 
+/* Maximum number of forkservers for AFL_TRIM_JOBS. A step size is only
+   tried on every TRIM_STEP_PROBE-th entry once TRIM_STEP_TRIES removals of
+   that size did not shorten anything: */
+
+#define TRIM_JOBS_MAX 64U
+#define TRIM_STEP_TRIES 2048
+#define TRIM_STEP_PROBE 16
+
 /* Maximum size of input file, in bytes (keep under 100MB, default 1MB):
    (note that if this value is changed, several areas in afl-cc.c, afl-fuzz.c
    and afl-fuzz-state.c have to be changed as well! */
@@ -280,6 +335,12 @@
 #define TMIN_SET_MIN_SIZE 4
 #define TMIN_SET_STEPS 128
 
+/* Maximum number of forkservers for afl-tmin -T, and how many candidates
+   per forkserver may be run ahead of the oldest one not judged yet: */
+
+#define TMIN_TASKS_MAX 256U
+#define TMIN_TASK_AHEAD 4U
+
 /* Maximum dictionary token size (-x), in bytes: */
 
 #define MAX_DICT_FILE 128
@@ -327,6 +388,10 @@
 #define PLOT_UPDATE_SEC 5
 #define QUEUE_UPDATE_SEC 1800
 
+/* Number of plot_data lines kept in the binary stats page: */
+
+#define STATS_PAGE_SAMPLES 1024
+
 /* Smoothing divisor for CPU load and exec speed stats (1 - no smoothing). */
 
 #define AVG_SMOOTHING 16
@@ -340,6 +405,15 @@
 
 #define SYNC_TIME (20 * 60 * 1000)
 
+/* Records in the shared memory sync bus of all instances on a host
+   (AFL_SYNC_BUS) per online CPU and in total, and the maximum number of
+   non-zero map bytes a record can describe. Queue entries with a bigger
+   trace are not published. A record takes about 5 kB: */
+
+#define SYNC_BUS_RECORDS_PER_CPU 256
+#define SYNC_BUS_RECORDS_MAX 4096
+#define SYNC_BUS_MAX_PAIRS 1024
+
 /* Output directory reuse grace period (minutes): */
 
 #define OUTPUT_GRACE 25
@@ -407,6 +481,12 @@
 
 #define TESTCASE_CACHE_SIZE 50
 
+/* Size in bytes of one slab of the trace_mini store. Minimized traces of
+   all queue entries are carved out of slabs of (roughly) this size instead
+   of being allocated one by one. Slabs are always at least one trace big. */
+
+#define TRACE_MINI_SLAB_SIZE (4 * 1024 * 1024)
+
 /* Maximum line length passed from GCC to 'as' and used for parsing
    configuration files: */
 
@@ -32,6 +32,7 @@
 #include <stdbool.h>
 
 #include "types.h"
+#include "sharedmem.h"
 
 #ifdef __linux__
 /**
@@ -236,6 +237,12 @@ typedef enum fsrv_run_result {
 
 void afl_fsrv_init(afl_forkserver_t *fsrv);
 void afl_fsrv_init_dup(afl_forkserver_t *fsrv_to, afl_forkserver_t *from);
+void afl_fsrv_start_helper(afl_forkserver_t *fsrv, afl_forkserver_t *from,
+                           sharedmem_t *shm, sharedmem_t *shm_fuzz,
+                           u8 *in_file, u8 *argv_file, char **argv,
+                           volatile u8 *stop_soon_p, u8 debug_child_output);
+char **afl_fsrv_argv_replace(char **argv, u8 *from_file, u8 *to_file);
+void   afl_fsrv_argv_free(char **new_argv, char **argv);
 void afl_fsrv_start(afl_forkserver_t *fsrv, char **argv,
                     volatile u8 *stop_soon_p, u8 debug_child_output);
 u32  afl_fsrv_get_mapsize(afl_forkserver_t *fsrv, char **argv,
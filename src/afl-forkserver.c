@@ -310,6 +310,144 @@ void afl_fsrv_init_dup(afl_forkserver_t *fsrv_to, afl_forkserver_t *from) {
 
 }
 
+/* A copy of the target argv that names to_file instead of from_file, or
+   NULL if from_file is not on the command line. See detect_file_args(). */
+
+char **afl_fsrv_argv_replace(char **argv, u8 *from_file, u8 *to_file) {
+
+  u8     cwd[PATH_MAX], *from, *to, found = 0;
+  char **ret;
+  u32    argc = 0, i;
+
+  if (getcwd(cwd, (size_t)sizeof(cwd)) == NULL) { PFATAL("getcwd() failed"); }
+
+  from = from_file[0] == '/' ? ck_strdup(from_file)
+                             : alloc_printf("%s/%s", cwd, from_file);
+  to = to_file[0] == '/' ? ck_strdup(to_file)
+                         : alloc_printf("%s/%s", cwd, to_file);
+
+  while (argv[argc]) {
+
+    ++argc;
+
+  }
+
+  ret = ck_alloc((argc + 1) * sizeof(char *));
+
+  for (i = 0; i < argc; ++i) {
+
+    u8 *p = strstr(argv[i], from);
+
+    if (p) {
+
+      ret[i] = alloc_printf("%.*s%s%s", (int)(p - (u8 *)argv[i]), argv[i], to,
+                            p + strlen(from));
+      found = 1;
+
+    } else {
+
+      ret[i] = argv[i];
+
+    }
+
+  }
+
+  ck_free(from);
+  ck_free(to);
+
+  if (!found) {
+
+    afl_fsrv_argv_free(ret, argv);
+    return NULL;
+
+  }
+
+  return ret;
+
+}
+
+/* Free what afl_fsrv_argv_replace() returned for argv. */
+
+void afl_fsrv_argv_free(char **new_argv, char **argv) {
+
+  if (!new_argv) { return; }
+
+  for (u32 i = 0; argv[i]; ++i) {
+
+    if (new_argv[i] != argv[i]) { ck_free(new_argv[i]); }
+
+  }
+
+  ck_free(new_argv);
+
+}
+
+/* Spin up a helper forkserver for the target of from, with its own trace
+   map in shm. The input is passed in shm_fuzz if from uses shared memory,
+   otherwise in in_file, which takes the place of argv_file on the target
+   command line unless the target reads stdin. afl_shm_init() exports the
+   maps to the environment, the caller restores the variables of from. */
+
+void afl_fsrv_start_helper(afl_forkserver_t *fsrv, afl_forkserver_t *from,
+                           sharedmem_t *shm, sharedmem_t *shm_fuzz,
+                           u8 *in_file, u8 *argv_file, char **argv,
+                           volatile u8 *stop_soon_p, u8 debug_child_output) {
+
+  char **helper_argv = NULL;
+
+  afl_fsrv_init_dup(fsrv, from);
+
+  fsrv->target_path = from->target_path;
+  fsrv->qemu_mode = from->qemu_mode;
+  fsrv->frida_mode = from->frida_mode;
+  fsrv->cs_mode = from->cs_mode;
+  fsrv->trace_bits = afl_shm_init(shm, from->map_size, 0);
+
+  if (from->use_shmem_fuzz) {
+
+    u8 *map = afl_shm_init(shm_fuzz, MAX_FILE + sizeof(u32), 1);
+    if (!map) { FATAL("BUG: Zero return from afl_shm_init."); }
+    shm_fuzz->shmemfuzz_mode = 1;
+
+#ifdef USEMMAP
+    setenv(SHM_FUZZ_ENV_VAR, shm_fuzz->g_shm_file_path, 1);
+#else
+    u8 *shm_str = alloc_printf("%d", shm_fuzz->shm_id);
+    setenv(SHM_FUZZ_ENV_VAR, shm_str, 1);
+    ck_free(shm_str);
+#endif
+
+    fsrv->support_shmem_fuzz = 1;
+    fsrv->shmem_fuzz_len = (u32 *)map;
+    fsrv->shmem_fuzz = map + sizeof(u32);
+    fsrv->use_stdin = 0;
+    fsrv->out_file = NULL;
+    fsrv->out_fd = -1;
+
+  } else {
+
+    fsrv->support_shmem_fuzz = 0;
+    fsrv->shmem_fuzz = NULL;
+    fsrv->out_file = in_file;
+    unlink(in_file);                                     /* Ignore errors */
+    fsrv->out_fd = open(in_file, O_RDWR | O_CREAT | O_EXCL, DEFAULT_PERMISSION);
+    if (fsrv->out_fd < 0) { PFATAL("Unable to create '%s'", in_file); }
+
+    if (!from->use_stdin && argv_file) {
+
+      helper_argv = afl_fsrv_argv_replace(argv, argv_file, in_file);
+
+    }
+
+  }
+
+  afl_fsrv_start(fsrv, helper_argv ? helper_argv : argv, stop_soon_p,
+                 debug_child_output);
+
+  afl_fsrv_argv_free(helper_argv, argv);
+
+}
+
 /* Wrapper for select() and read(), reading a 32 bit var.
   Returns the time passed to read.
   If the wait times out, returns timeout_ms + 1;
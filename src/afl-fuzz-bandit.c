@@ -0,0 +1,290 @@
+/*
+   american fuzzy lop++ - havoc operator bandit
+   --------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   With AFL_HAVOC_BANDIT the havoc stage counts, separately for text and
+   binary inputs, how often every mutation operator and stack depth was
+   used and how often such an execution found a new path or crash. At the
+   start of each havoc stage the operator table is rebuilt from Thompson
+   samples of these find rates, mixed with the default table so that no
+   operator is starved, and the stack depth with the best sample is used.
+   Picking an operator stays a table lookup and the bookkeeping per
+   execution is one counter per operator used. Older statistics fade out
+   so the odds follow the campaign, and they are saved in the queue state
+   to survive a resume.
+
+ */
+
+#include "afl-fuzz.h"
+#include <math.h>
+
+#define BANDIT_MAGIC 0x41424e44                 /* "ABND"                   */
+#define BANDIT_OPS 64                           /* Operators in a u64 mask  */
+#define BANDIT_DEPTHS 8
+#define BANDIT_TABLE 256
+#define BANDIT_CLASSES 2                        /* Binary and text inputs   */
+
+struct bandit_class {
+
+  double execs;                         /* Havoc executions                 */
+  double op_uses[BANDIT_OPS], op_finds[BANDIT_OPS];
+  double depth_uses[BANDIT_DEPTHS], depth_finds[BANDIT_DEPTHS];
+
+};
+
+struct bandit_stats {
+
+  u32                 magic;            /* BANDIT_MAGIC                     */
+  u32                 size;             /* sizeof(struct bandit_stats)      */
+  struct bandit_class cls[BANDIT_CLASSES];
+
+};
+
+struct havoc_bandit {
+
+  struct bandit_stats stats;            /* What is saved                    */
+  u32                 table[BANDIT_TABLE];  /* Current operator table     */
+  u8                  changed;          /* Not saved since the last update  */
+
+};
+
+/* Draw from the posterior of the find rate of an arm. Beta(finds + 1,
+   misses + 1) is approximated by a normal distribution, with the sum of
+   four uniform values standing in for the normal deviate. */
+
+static double bandit_sample(afl_state_t *afl, double uses, double finds) {
+
+  double mean = (finds + 1) / (uses + 2), z = 0;
+  double sd = sqrt(mean * (1 - mean) / (uses + 3));
+
+  for (u32 i = 0; i < 4; ++i) {
+
+    z += (double)rand_below(afl, 65536) / 65536;
+
+  }
+
+  /* The sum has a mean of 2 and a variance of 1/3. */
+
+  z = (z - 2) * 1.7320508;
+
+  return MAX(mean + sd * z, 0);
+
+}
+
+/* Set up the statistics, taking them over from the session we resume if
+   there is one. Must run before pivot_inputs() removes its state. */
+
+void bandit_init(afl_state_t *afl) {
+
+  struct bandit_stats tmp;
+  u8                 *fn;
+  s32                 fd;
+
+  if (!afl->afl_env.afl_havoc_bandit) { return; }
+
+  if (afl->limit_time_sig > 0) {
+
+    WARNF("AFL_HAVOC_BANDIT has no effect with MOpt (-L).");
+
+  }
+
+  afl->havoc_bandit = ck_alloc(sizeof(struct havoc_bandit));
+  afl->havoc_bandit->stats.magic = BANDIT_MAGIC;
+  afl->havoc_bandit->stats.size = sizeof(struct bandit_stats);
+
+  fn = alloc_printf("%s/.state/havoc_bandit", afl->in_dir);
+  fd = open(fn, O_RDONLY);
+
+  if (fd < 0) {
+
+    if (errno != ENOENT) { PFATAL("Unable to open '%s'", fn); }
+    ck_free(fn);
+    return;
+
+  }
+
+  if (read(fd, &tmp, sizeof(tmp)) == sizeof(tmp) &&
+      tmp.magic == BANDIT_MAGIC && tmp.size == sizeof(tmp)) {
+
+    afl->havoc_bandit->stats = tmp;
+    OKF("Loaded the havoc operator statistics.");
+
+  } else {
+
+    WARNF("'%s' is not usable, starting with fresh statistics.", fn);
+
+  }
+
+  close(fd);
+  ck_free(fn);
+
+}
+
+void bandit_save(afl_state_t *afl) {
+
+  struct havoc_bandit *b = afl->havoc_bandit;
+
+  if (!b || !b->changed) { return; }
+  b->changed = 0;
+
+  u8 *fn = alloc_printf("%s/queue/.state/havoc_bandit", afl->out_dir);
+  s32 fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_PERMISSION);
+
+  if (fd < 0) { PFATAL("Unable to create '%s'", fn); }
+
+  ck_write(fd, &b->stats, sizeof(b->stats), fn);
+
+  close(fd);
+  ck_free(fn);
+
+}
+
+/* Replace the operator table *array of size entries for a havoc stage on
+   an input of class cls. Returns the size of the new table. */
+
+u32 bandit_table(afl_state_t *afl, u8 cls, u32 **array, u32 size) {
+
+  struct havoc_bandit *b = afl->havoc_bandit;
+  struct bandit_class *c = &b->stats.cls[cls];
+  u32                  cnt[BANDIT_OPS] = {0}, present = 0, pos = 0, op, i;
+  double               w[BANDIT_OPS], sum = 0, acc = 0;
+
+  if (c->execs < HAVOC_BANDIT_WARMUP) { return size; }
+
+  /* Operators that are not in the default table stay out, they are not
+     meant for this kind of input. */
+
+  for (i = 0; i < size; ++i) {
+
+    if (likely((*array)[i] < BANDIT_OPS)) { ++cnt[(*array)[i]]; }
+
+  }
+
+  for (op = 0; op < BANDIT_OPS; ++op) {
+
+    if (!cnt[op]) { continue; }
+    w[op] = bandit_sample(afl, c->op_uses[op], c->op_finds[op]);
+    sum += w[op];
+    ++present;
+
+  }
+
+  if (!present || present > BANDIT_TABLE) { return size; }
+
+  /* Every operator gets one slot, the rest is handed out by its share. */
+
+  for (op = 0, i = 0; op < BANDIT_OPS; ++op) {
+
+    if (!cnt[op]) { continue; }
+
+    acc += HAVOC_BANDIT_EXPLORE * cnt[op] / size +
+           (1 - HAVOC_BANDIT_EXPLORE) *
+               (sum > 0 ? w[op] / sum : (double)cnt[op] / size);
+
+    u32 end = ++i == present
+                  ? BANDIT_TABLE
+                  : i + (u32)(acc * (BANDIT_TABLE - present) + 0.5);
+    end = MIN(end, (u32)BANDIT_TABLE);
+
+    while (pos < end) {
+
+      b->table[pos++] = op;
+
+    }
+
+  }
+
+  *array = b->table;
+  return BANDIT_TABLE;
+
+}
+
+/* Pick the stack depth of a havoc stage, out of depths. The stage stacks
+   up to 2 << depth mutations. */
+
+u32 bandit_depth(afl_state_t *afl, u8 cls, u32 depths) {
+
+  struct bandit_class *c = &afl->havoc_bandit->stats.cls[cls];
+  double               best = -1;
+  u32                  ret = 0;
+
+  depths = MIN(depths, (u32)BANDIT_DEPTHS);
+
+  if (c->execs < HAVOC_BANDIT_WARMUP) { return rand_below(afl, depths); }
+
+  for (u32 d = 0; d < depths; ++d) {
+
+    double s = bandit_sample(afl, c->depth_uses[d], c->depth_finds[d]);
+    if (s > best) {
+
+      best = s;
+      ret = d;
+
+    }
+
+  }
+
+  return ret;
+
+}
+
+/* Account one havoc execution that used the operators in the ops mask at
+   the given stack depth. */
+
+void bandit_update(afl_state_t *afl, u8 cls, u64 ops, u32 depth, u8 found) {
+
+  struct havoc_bandit *b = afl->havoc_bandit;
+  struct bandit_class *c = &b->stats.cls[cls];
+  u32                  i;
+
+  if (likely(depth < BANDIT_DEPTHS)) {
+
+    ++c->depth_uses[depth];
+    c->depth_finds[depth] += found;
+
+  }
+
+  while (ops) {
+
+    i = __builtin_ctzll(ops);
+    ops &= ops - 1;
+    ++c->op_uses[i];
+    c->op_finds[i] += found;
+
+  }
+
+  b->changed = 1;
+
+  if (likely(++c->execs < HAVOC_BANDIT_HALFLIFE)) { return; }
+
+  /* Let the past count half. */
+
+  c->execs /= 2;
+
+  for (i = 0; i < BANDIT_OPS; ++i) {
+
+    c->op_uses[i] /= 2;
+    c->op_finds[i] /= 2;
+
+  }
+
+  for (i = 0; i < BANDIT_DEPTHS; ++i) {
+
+    c->depth_uses[i] /= 2;
+    c->depth_finds[i] /= 2;
+
+  }
+
+}
+
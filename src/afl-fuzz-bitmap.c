@@ -278,12 +278,27 @@ inline u8 has_new_bits_unclassified(afl_state_t *afl, u8 *virgin_map) {
 
 void minimize_bits(afl_state_t *afl, u8 *dst, u8 *src) {
 
-  u32 i = 0;
+  u64 *src64 = (u64 *)src;
+  u32  i, j;
 
-  while (i < afl->fsrv.map_size) {
+  /* The map size is a multiple of 64 and traces are mostly empty, so skip
+     over zero words and only look at the bytes of non-zero ones. dst is
+     expected to be zeroed, e.g. fresh from trace_mini_alloc(). */
 
-    if (*(src++)) { dst[i >> 3] |= 1 << (i & 7); }
-    ++i;
+  for (i = 0; i < (afl->fsrv.map_size >> 3); ++i) {
+
+    if (likely(!src64[i])) { continue; }
+
+    u8 *b = (u8 *)&src64[i];
+    u8  bits = 0;
+
+    for (j = 0; j < 8; ++j) {
+
+      if (b[j]) { bits |= 1 << j; }
+
+    }
+
+    dst[i] = bits;
 
   }
 
@@ -452,6 +467,33 @@ void write_crash_readme(afl_state_t *afl) {
 
 }
 
+/* Append a testcase that was just saved as fn to the pack of that kind,
+   if AFL_PACK_CORPUS is used. */
+
+void pack_save(afl_state_t *afl, u8 kind, u32 id, u8 *fn, u8 *mem, u32 len) {
+
+  if (likely(afl->pack_fd[kind] < 0)) { return; }
+
+  struct afl_pack_record rec;
+  u8                    *desc = (u8 *)strrchr((char *)fn, '/');
+
+  desc = desc ? desc + 1 : fn;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.id = id;
+  rec.parent = afl->queue_cur && !afl->syncing_party ? afl->queue_cur->id
+                                                     : AFL_PACK_NO_PARENT;
+  rec.len = len;
+  rec.time_ms = afl->start_time
+                    ? afl->prev_run_time + get_cur_time() - afl->start_time
+                    : 0;
+  rec.desc_len = MIN(strlen((char *)desc), (size_t)0xffff);
+  rec.kind = kind;
+
+  afl_pack_append(afl->pack_fd[kind], afl->pack_idx_fd[kind], &rec, desc, mem);
+
+}
+
 /* Check if the result of an execve() during routine fuzzing is interesting,
    save or queue the input test case for further analysis if so. Returns 1 if
    entry is saved, 0 otherwise. */
@@ -481,7 +523,7 @@ u8 __attribute__((hot)) save_if_interesting(afl_state_t *afl, void *mem,
   u8  fn[PATH_MAX];
   u8 *queue_fn = "";
   u8  new_bits = 0, keeping = 0, res, classified = 0, is_timeout = 0,
-     need_hash = 1;
+     need_hash = 1, pack_kind = AFL_PACK_HANGS;
   s32 fd;
   u64 cksum = 0;
 
@@ -566,7 +608,13 @@ u8 __attribute__((hot)) save_if_interesting(afl_state_t *afl, void *mem,
 
     }
 
+    pack_save(afl, AFL_PACK_QUEUE, afl->queued_items, queue_fn, mem, len);
     add_to_queue(afl, queue_fn, len, 0);
+    if (likely(!is_timeout)) {
+
+      sync_bus_publish(afl, afl->queue_top->id, mem, len);
+
+    }
 
     if (unlikely(afl->fuzz_mode) &&
         likely(afl->switch_fuzz_mode && !afl->non_instrumented_mode)) {
@@ -803,6 +851,7 @@ u8 __attribute__((hot)) save_if_interesting(afl_state_t *afl, void *mem,
          except for slightly different limits and no need to re-run test
          cases. */
 
+      pack_kind = AFL_PACK_CRASHES;
       ++afl->total_crashes;
 
       if (afl->saved_crashes >= KEEP_UNIQUE_CRASH) { return keeping; }
@@ -915,16 +964,25 @@ u8 __attribute__((hot)) save_if_interesting(afl_state_t *afl, void *mem,
   }
 
   /* If we're here, we apparently want to save the crash or hang
-     test case, too. */
+     test case, too. With AFL_PACK_CORPUS it only goes into the pack. */
 
-  fd = permissive_create(afl, fn);
-  if (fd >= 0) {
+  if (likely(afl->pack_fd[pack_kind] < 0)) {
 
-    ck_write(fd, mem, len, fn);
-    close(fd);
+    fd = permissive_create(afl, fn);
+    if (fd >= 0) {
+
+      ck_write(fd, mem, len, fn);
+      close(fd);
+
+    }
 
   }
 
+  pack_save(afl, pack_kind,
+            pack_kind == AFL_PACK_HANGS ? afl->saved_hangs - 1
+                                        : afl->saved_crashes - 1,
+            fn, mem, len);
+
 #ifdef __linux__
   if (afl->fsrv.nyx_mode && fault == FSRV_RUN_CRASH) {
 
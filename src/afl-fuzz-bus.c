@@ -0,0 +1,326 @@
+/*
+   american fuzzy lop++ - shared memory sync bus
+   ---------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   With AFL_SYNC_BUS all instances sharing a sync directory on one host map
+   the ring buffer sync_dir/.sync_bus. Every new queue entry is published
+   there with the hash of its input and its classified trace as a list of
+   (map index, value) pairs. When syncing, an instance first walks the
+   records published since its last sync and remembers those entries whose
+   trace has no bits left in its own virgin_bits. sync_fuzzers() then
+   skips running these files if their content still has the same hash.
+
+ */
+
+#include "afl-fuzz.h"
+#include "afl-sync-bus.h"
+#include <sys/mman.h>
+#include <sys/file.h>
+
+#define SYNC_BUS_SKIP_SIZE(afl) ((afl)->sync_bus_records * 2)
+
+struct sync_bus_skip {
+
+  u64 key;                              /* Peer and id, 0 for unused        */
+  u64 input_hash;                       /* Input the trace belongs to       */
+
+};
+
+static inline u64 sync_bus_key(u32 peer, u32 id) {
+
+  u64 key = ((u64)peer << 32) | id;
+  return key ? key : 1;
+
+}
+
+/* Map the bus of the sync directory, creating it if we are the first. The
+   creator sizes the ring for one instance per online CPU, everybody else
+   takes the size from the header. */
+
+void sync_bus_init(afl_state_t *afl) {
+
+  u8              fn[PATH_MAX];
+  s32             fd;
+  struct stat     st;
+  struct sync_bus hdr;
+  u32 records = MIN(MAX(afl->cpu_core_count, 1) * SYNC_BUS_RECORDS_PER_CPU,
+                    SYNC_BUS_RECORDS_MAX);
+  u64 size;
+
+  if (!afl->afl_env.afl_sync_bus || !afl->sync_id || afl->crash_mode ||
+      afl->non_instrumented_mode) {
+
+    return;
+
+  }
+
+  snprintf(fn, PATH_MAX, "%s/.sync_bus", afl->sync_dir);
+  fd = open(fn, O_RDWR | O_CREAT, DEFAULT_PERMISSION);
+  if (fd < 0) { PFATAL("Unable to create '%s'", fn); }
+
+  if (flock(fd, LOCK_EX)) { PFATAL("flock() on '%s' failed", fn); }
+  if (fstat(fd, &st)) { PFATAL("fstat() on '%s' failed", fn); }
+
+  if (st.st_size && pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+      hdr.records && hdr.records <= SYNC_BUS_RECORDS_MAX) {
+
+    records = hdr.records;
+
+  }
+
+  size = SYNC_BUS_BYTES(records);
+
+  if (!st.st_size && ftruncate(fd, size)) {
+
+    PFATAL("Unable to resize '%s'", fn);
+
+  }
+
+  struct sync_bus *bus =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (bus == MAP_FAILED) { PFATAL("Unable to mmap '%s'", fn); }
+
+  if (!st.st_size) {
+
+    bus->records = records;
+    bus->max_pairs = SYNC_BUS_MAX_PAIRS;
+    bus->record_size = sizeof(struct sync_bus_record);
+    __atomic_store_n(&bus->magic, SYNC_BUS_MAGIC, __ATOMIC_RELEASE);
+
+  }
+
+  flock(fd, LOCK_UN);
+  close(fd);
+
+  if (st.st_size &&
+      ((u64)st.st_size != size || bus->magic != SYNC_BUS_MAGIC ||
+       bus->records != records ||
+       bus->max_pairs != SYNC_BUS_MAX_PAIRS ||
+       bus->record_size != sizeof(struct sync_bus_record))) {
+
+    WARNF("'%s' was created by a different afl-fuzz build, not using it", fn);
+    munmap(bus, size);
+    return;
+
+  }
+
+  afl->sync_bus = bus;
+  afl->sync_bus_records = records;
+  afl->sync_bus_peer = hash32(afl->sync_id, strlen(afl->sync_id), HASH_CONST);
+  afl->sync_bus_skip =
+      ck_alloc(SYNC_BUS_SKIP_SIZE(afl) * sizeof(struct sync_bus_skip));
+
+  /* Traces are only comparable between instances that run the same binary
+     in the same mode. */
+
+  afl->sync_bus_target =
+      afl->fsrv.nyx_mode ? 0 : get_binary_hash(afl->fsrv.target_path);
+  afl->sync_bus_target ^= ((u64)afl->fsrv.map_size << 8) |
+                          (afl->fsrv.qemu_mode << 1) |
+                          (afl->fsrv.frida_mode << 2) |
+                          (afl->fsrv.cs_mode << 3) | (afl->unicorn_mode << 4) |
+                          (afl->fsrv.nyx_mode << 5);
+
+  /* Records that are already on the bus describe entries that we will sync
+     for the first time, so they are useful as well. */
+
+  u64 head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+  afl->sync_bus_tail = head > records ? head - records : 0;
+
+  OKF("Using the shared memory sync bus '%s' (%u records, %llu kB).", fn,
+      records, size >> 10);
+
+}
+
+void sync_bus_destroy(afl_state_t *afl) {
+
+  if (!afl->sync_bus) { return; }
+
+  munmap(afl->sync_bus, SYNC_BUS_BYTES(afl->sync_bus_records));
+  ck_free(afl->sync_bus_skip);
+  afl->sync_bus = NULL;
+  afl->sync_bus_skip = NULL;
+
+}
+
+/* Publish the queue entry id that was just saved. trace_bits must hold its
+   classified trace. */
+
+void sync_bus_publish(afl_state_t *afl, u32 id, u8 *mem, u32 len) {
+
+  struct sync_bus        *bus = afl->sync_bus;
+  struct sync_bus_record *rec;
+  u64                    *words = (u64 *)afl->fsrv.trace_bits;
+  u32                     i, cnt = 0, map_size = afl->fsrv.map_size;
+
+  if (likely(!bus)) { return; }
+
+  /* Count first, so a record that does not fit costs no slot. */
+
+  for (i = 0; i < (map_size >> 3); ++i) {
+
+    if (likely(!words[i])) { continue; }
+    for (u32 j = 0; j < 8; ++j) {
+
+      if (afl->fsrv.trace_bits[(i << 3) + j]) { ++cnt; }
+
+    }
+
+  }
+
+  if (cnt > SYNC_BUS_MAX_PAIRS) { return; }
+
+  u64 seq = __atomic_fetch_add(&bus->head, 1, __ATOMIC_ACQ_REL);
+  rec = &bus->rec[seq % afl->sync_bus_records];
+
+  __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  rec->target = afl->sync_bus_target;
+  rec->input_hash = hash64(mem, len, HASH_CONST);
+  rec->peer = afl->sync_bus_peer;
+  rec->id = id;
+  rec->map_size = map_size;
+
+  cnt = 0;
+  for (i = 0; i < (map_size >> 3); ++i) {
+
+    if (likely(!words[i])) { continue; }
+    for (u32 j = 0; j < 8; ++j) {
+
+      u8 v = afl->fsrv.trace_bits[(i << 3) + j];
+      if (v) {
+
+        rec->idx[cnt] = (i << 3) + j;
+        rec->val[cnt++] = v;
+
+      }
+
+    }
+
+  }
+
+  rec->pair_cnt = cnt;
+
+  __atomic_store_n(&rec->seq, seq + 1, __ATOMIC_RELEASE);
+
+}
+
+/* Walk the records published since the last sync and remember the entries
+   that cannot give us new coverage. Must run before the peers are synced,
+   so every remembered entry is already on disk. */
+
+void sync_bus_read(afl_state_t *afl) {
+
+  struct sync_bus      *bus = afl->sync_bus;
+  struct sync_bus_skip *skip = afl->sync_bus_skip;
+  u64                   head, n;
+
+  if (likely(!bus)) { return; }
+
+  memset(skip, 0, SYNC_BUS_SKIP_SIZE(afl) * sizeof(struct sync_bus_skip));
+
+  head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+  n = afl->sync_bus_tail;
+  if (head - n > afl->sync_bus_records) { n = head - afl->sync_bus_records; }
+
+  for (; n < head; ++n) {
+
+    struct sync_bus_record *rec = &bus->rec[n % afl->sync_bus_records];
+    u64                     seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+    u32                     peer, id, cnt, i;
+    u64                     input_hash;
+
+    if (seq != n + 1) { continue; }
+
+    peer = rec->peer;
+    id = rec->id;
+    cnt = rec->pair_cnt;
+    input_hash = rec->input_hash;
+
+    if (peer == afl->sync_bus_peer || rec->target != afl->sync_bus_target ||
+        rec->map_size != afl->fsrv.map_size || cnt > SYNC_BUS_MAX_PAIRS) {
+
+      continue;
+
+    }
+
+    for (i = 0; i < cnt; ++i) {
+
+      u32 idx = rec->idx[i];
+      if (idx >= afl->fsrv.map_size ||
+          (afl->virgin_bits[idx] & rec->val[i])) {
+
+        break;
+
+      }
+
+    }
+
+    /* The writer reused the slot while we were reading it. */
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != seq) { continue; }
+
+    if (i < cnt) { continue; }
+
+    u64 key = sync_bus_key(peer, id);
+    u32 pos = key % SYNC_BUS_SKIP_SIZE(afl);
+
+    while (skip[pos].key && skip[pos].key != key) {
+
+      pos = (pos + 1) % SYNC_BUS_SKIP_SIZE(afl);
+
+    }
+
+    skip[pos].key = key;
+    skip[pos].input_hash = input_hash;
+
+  }
+
+  afl->sync_bus_tail = head;
+
+}
+
+/* Returns 1 if the testcase id of the peer is known to not have new
+   coverage, so there is no need to run it. */
+
+u8 sync_bus_known(afl_state_t *afl, u8 *peer, u32 id, u8 *mem, u32 len) {
+
+  struct sync_bus_skip *skip = afl->sync_bus_skip;
+
+  if (likely(!afl->sync_bus)) { return 0; }
+
+  u64 key = sync_bus_key(hash32(peer, strlen(peer), HASH_CONST), id);
+  u32 pos = key % SYNC_BUS_SKIP_SIZE(afl);
+
+  while (skip[pos].key) {
+
+    if (skip[pos].key == key) {
+
+      if (skip[pos].input_hash != hash64(mem, len, HASH_CONST)) { return 0; }
+
+      ++afl->sync_bus_skipped;
+      return 1;
+
+    }
+
+    pos = (pos + 1) % SYNC_BUS_SKIP_SIZE(afl);
+
+  }
+
+  return 0;
+
+}
+
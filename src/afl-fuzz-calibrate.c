@@ -0,0 +1,400 @@
+/*
+   american fuzzy lop++ - parallel calibration of the initial seeds
+   ----------------------------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   With AFL_CAL_JOBS=n the dry run starts n helper forkservers (see
+   afl-fuzz-pool.c) and lets n threads run the calibration executions of
+   the seeds ahead of perform_dry_run(). The main thread still
+   walks the queue in order and does all the bookkeeping, so virgin_bits,
+   top_rated and the queue entries end up exactly as with a serial run.
+   Seeds that crash, time out or behave variably are calibrated again by
+   calibrate_case() to get the usual handling and messages.
+
+ */
+
+#include "afl-fuzz.h"
+#include <pthread.h>
+
+enum {
+
+  /* 00 */ CAL_SLOT_FREE,
+  /* 01 */ CAL_SLOT_RUNNING,
+  /* 02 */ CAL_SLOT_DONE
+
+};
+
+struct cal_slot {
+
+  u32 idx;                              /* Queue index of the seed          */
+  u8  state;                            /* CAL_SLOT_*                       */
+  u8  usable;                           /* Stable and without fault         */
+  u64 cksum;                            /* Checksum of the trace            */
+  u64 time_us;                          /* Time of all executions           */
+  u32 execs;                            /* Number of executions             */
+  u8 *trace;                            /* Classified trace                 */
+
+};
+
+struct cal_worker {
+
+  struct cal_pool  *pool;
+  afl_forkserver_t *fsrv;
+  u8               *in_buf;
+  pthread_t         thread;
+
+};
+
+struct cal_pool {
+
+  afl_state_t        *afl;
+  struct cal_worker  *workers;
+  struct fsrv_helper *helpers;
+  struct cal_slot    *slots;
+  u32                 jobs, window;
+  u32                 next;             /* Next seed to hand out            */
+  u32                 taken;            /* Seeds the dry run is done with   */
+  u8                  stop;
+  pthread_mutex_t     lock;
+  pthread_cond_t      cond;
+
+};
+
+static inline u8 cal_skip(struct queue_entry *q) {
+
+  return !q || q->disabled || !q->len;
+
+}
+
+/* Run the calibration executions of one seed. */
+
+static void cal_run(struct cal_worker *w, struct queue_entry *q,
+                    struct cal_slot *slot) {
+
+  afl_state_t      *afl = w->pool->afl;
+  afl_forkserver_t *fsrv = w->fsrv;
+  u32 stage_max = afl->afl_env.afl_cal_fast ? CAL_CYCLES_FAST : CAL_CYCLES;
+  u32 use_tmout = afl->fsrv.exec_tmout, len = MIN(q->len, (u32)MAX_FILE), i;
+  u64 start_us;
+  s32 fd;
+
+  slot->usable = 0;
+  slot->execs = 0;
+
+  if (afl->resuming_fuzz) {
+
+    use_tmout = MAX(afl->fsrv.exec_tmout + CAL_TMOUT_ADD,
+                    afl->fsrv.exec_tmout * CAL_TMOUT_PERC / 100);
+
+  }
+
+  fd = open(q->fname, O_RDONLY);
+  if (fd < 0) { return; }
+  w->in_buf = afl_realloc((void **)&w->in_buf, len);
+  if (!w->in_buf || read(fd, w->in_buf, len) != (ssize_t)len) {
+
+    close(fd);
+    return;
+
+  }
+
+  close(fd);
+
+  start_us = get_cur_time_us();
+
+  for (i = 0; i < stage_max; ++i) {
+
+    u64 cksum;
+
+    afl_fsrv_write_to_testcase(fsrv, w->in_buf, len);
+    u8 fault = afl_fsrv_run_target(fsrv, use_tmout, &afl->stop_soon);
+    ++slot->execs;
+
+    if (afl->stop_soon || fault != afl->crash_mode) { return; }
+    if (!i && !count_bytes(afl, fsrv->trace_bits)) { return; }
+
+    classify_counts(fsrv);
+    cksum = hash64(fsrv->trace_bits, fsrv->map_size, HASH_CONST);
+
+    if (!i) {
+
+      slot->cksum = cksum;
+      memcpy(slot->trace, fsrv->trace_bits, fsrv->map_size);
+
+    } else if (cksum != slot->cksum) {
+
+      return;
+
+    }
+
+  }
+
+  if (unlikely(afl->fixed_seed)) {
+
+    slot->time_us = (u64)(afl->fsrv.exec_tmout - 1) * (u64)stage_max;
+
+  } else {
+
+    slot->time_us = get_cur_time_us() - start_us;
+    if (unlikely(!slot->time_us)) { ++slot->time_us; }
+
+  }
+
+  slot->usable = 1;
+
+}
+
+static void *cal_worker_main(void *arg) {
+
+  struct cal_worker *w = arg;
+  struct cal_pool   *pool = w->pool;
+  afl_state_t       *afl = pool->afl;
+
+  pthread_mutex_lock(&pool->lock);
+
+  while (!pool->stop && !afl->stop_soon) {
+
+    while (pool->next < afl->queued_items &&
+           cal_skip(afl->queue_buf[pool->next])) {
+
+      ++pool->next;
+
+    }
+
+    if (pool->next >= afl->queued_items) { break; }
+
+    if (pool->next >= pool->taken + pool->window) {
+
+      pthread_cond_wait(&pool->cond, &pool->lock);
+      continue;
+
+    }
+
+    u32              idx = pool->next++;
+    struct cal_slot *slot = &pool->slots[idx % pool->window];
+
+    slot->idx = idx;
+    slot->state = CAL_SLOT_RUNNING;
+
+    pthread_mutex_unlock(&pool->lock);
+    cal_run(w, afl->queue_buf[idx], slot);
+    pthread_mutex_lock(&pool->lock);
+
+    slot->state = CAL_SLOT_DONE;
+    pthread_cond_broadcast(&pool->cond);
+
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+
+}
+
+/* Start the workers for the dry run, or return NULL if AFL_CAL_JOBS is not
+   set or the setup does not allow several forkservers. */
+
+struct cal_pool *cal_pool_start(afl_state_t *afl) {
+
+  struct cal_pool *pool;
+  u32              jobs, i;
+
+  if (!afl->afl_env.afl_cal_jobs) { return NULL; }
+
+  /* More forkservers than cores would only distort the exec times. */
+
+  jobs = MIN((u32)atoi(afl->afl_env.afl_cal_jobs), CAL_JOBS_MAX);
+  if (afl->cpu_core_count > 0) { jobs = MIN(jobs, (u32)afl->cpu_core_count); }
+  if (jobs < 2 || afl->queued_items < 2 * jobs) { return NULL; }
+
+  /* calibrate_case() does extra runs for cmplog that we do not mirror. */
+
+  if (afl->shm.cmplog_mode) {
+
+    WARNF("AFL_CAL_JOBS is not supported with cmplog, ignoring it.");
+    return NULL;
+
+  }
+
+  if (!fsrv_helpers_possible(afl, "AFL_CAL_JOBS")) { return NULL; }
+
+  ACTF("Spinning up %u forkservers for calibration...", jobs);
+
+  pool = ck_alloc(sizeof(struct cal_pool));
+  pool->afl = afl;
+  pool->jobs = jobs;
+  pool->window = jobs * CAL_JOBS_AHEAD;
+  pool->workers = ck_alloc(jobs * sizeof(struct cal_worker));
+  pool->slots = ck_alloc(pool->window * sizeof(struct cal_slot));
+
+  for (i = 0; i < pool->window; ++i) {
+
+    pool->slots[i].trace = ck_alloc(afl->fsrv.map_size);
+
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+
+  pool->helpers = fsrv_helpers_start(afl, jobs, "cal");
+
+  for (i = 0; i < jobs; ++i) {
+
+    pool->workers[i].pool = pool;
+    pool->workers[i].fsrv = &pool->helpers[i].fsrv;
+
+    if (pthread_create(&pool->workers[i].thread, NULL, cal_worker_main,
+                       &pool->workers[i])) {
+
+      PFATAL("pthread_create() failed");
+
+    }
+
+  }
+
+  return pool;
+
+}
+
+/* Account the calibration of queue entry idx done by a worker, leaving its
+   trace in trace_bits like calibrate_case() does. Returns the fault, or
+   FSRV_RUN_ERROR if the entry has to be calibrated by calibrate_case(). */
+
+u8 cal_pool_take(struct cal_pool *pool, u32 idx, struct queue_entry *q) {
+
+  afl_state_t     *afl;
+  struct cal_slot *slot;
+  u64              calibration_start_us;
+  u8               fault = FSRV_RUN_OK, new_bits;
+
+  if (!pool) { return FSRV_RUN_ERROR; }
+
+  afl = pool->afl;
+  slot = &pool->slots[idx % pool->window];
+  calibration_start_us = get_cur_time_us();
+
+  pthread_mutex_lock(&pool->lock);
+
+  if (idx >= pool->next) {
+
+    /* The workers are behind, nothing to wait for. */
+
+    pool->next = idx + 1;
+
+  } else {
+
+    while (slot->idx == idx && slot->state == CAL_SLOT_RUNNING) {
+
+      pthread_cond_wait(&pool->cond, &pool->lock);
+
+    }
+
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  if (slot->idx != idx || slot->state != CAL_SLOT_DONE || !slot->usable ||
+      q->exec_cksum) {
+
+    fault = FSRV_RUN_ERROR;
+    goto release;
+
+  }
+
+  u32 stage_max = afl->afl_env.afl_cal_fast ? CAL_CYCLES_FAST : CAL_CYCLES;
+
+  memcpy(afl->fsrv.trace_bits, slot->trace, afl->fsrv.map_size);
+  new_bits = has_new_bits(afl, afl->virgin_bits);
+
+  q->exec_cksum = slot->cksum;
+  memcpy(afl->first_trace, slot->trace, afl->fsrv.map_size);
+
+  afl->fsrv.total_execs += slot->execs;
+  afl->calibration_execs += slot->execs;
+  afl->total_cal_us += slot->time_us;
+  afl->total_cal_cycles += stage_max;
+
+  q->exec_us = slot->time_us / stage_max;
+  if (unlikely(!q->exec_us)) { q->exec_us = 1; }
+
+  q->bitmap_size = count_bytes(afl, afl->fsrv.trace_bits);
+  q->handicap = 0;
+  q->cal_failed = 0;
+
+  afl->total_bitmap_size += q->bitmap_size;
+  ++afl->total_bitmap_entries;
+
+  update_bitmap_score(afl, q);
+
+  if (!new_bits) { fault = FSRV_RUN_NOBITS; }
+
+  if (new_bits == 2 && !q->has_new_cov) {
+
+    q->has_new_cov = 1;
+    ++afl->queued_with_cov;
+
+  }
+
+  update_calibration_time(afl, &calibration_start_us);
+
+release:
+
+  pthread_mutex_lock(&pool->lock);
+  pool->taken = idx + 1;
+  slot->state = CAL_SLOT_FREE;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  return fault;
+
+}
+
+void cal_pool_stop(struct cal_pool *pool) {
+
+  u32 i;
+
+  if (!pool) { return; }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i = 0; i < pool->jobs; ++i) {
+
+    pthread_join(pool->workers[i].thread, NULL);
+
+  }
+
+  fsrv_helpers_stop(pool->helpers, pool->jobs);
+
+  for (i = 0; i < pool->jobs; ++i) {
+
+    afl_free(pool->workers[i].in_buf);
+
+  }
+
+  for (i = 0; i < pool->window; ++i) {
+
+    ck_free(pool->slots[i].trace);
+
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->cond);
+
+  ck_free(pool->slots);
+  ck_free(pool->workers);
+  ck_free(pool);
+
+}
+
@@ -25,6 +25,300 @@
 
 #include "afl-fuzz.h"
 
+/* Case-insensitive trie over all user and auto extras. Children are found
+   through a hash table keyed by (parent, byte), so a node stays small even
+   for dictionaries with many thousand tokens. Every node counts the tokens
+   ending in it, which turns the duplicate checks of add_extra() and
+   maybe_add_auto() into a walk over the token. The Aho-Corasick failure
+   links for extras_index_ends() are built when needed. */
+
+struct extras_node {
+
+  u32 parent;                           /* Parent node, 0 is the root       */
+  u32 fail;                             /* Aho-Corasick failure link        */
+  u32 user;                             /* User extras ending here          */
+  u32 autos;                            /* Auto extras ending here          */
+  u8  c;                                /* Lowercased byte of the edge      */
+  u8  depth;                            /* Token length up to here          */
+  u8  ends;                             /* A token ends here or in a suffix */
+
+};
+
+struct extras_index {
+
+  struct extras_node *nodes;
+  u32                *table;            /* Node ids by (parent, byte), or 0 */
+  u32                *order;            /* Nodes by depth, for the links    */
+  u32                 node_cnt, table_bits;
+  u64                 live_bytes;       /* Length of all indexed tokens     */
+  u8                  dirty;            /* Failure links are outdated       */
+
+};
+
+static inline u32 extras_slot(u32 parent, u8 c, u32 bits) {
+
+  return ((((u64)parent << 8) | c) * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+
+}
+
+static u32 extras_child(struct extras_index *ei, u32 parent, u8 c) {
+
+  u32 mask = (1U << ei->table_bits) - 1,
+      pos = extras_slot(parent, c, ei->table_bits), id;
+
+  while ((id = ei->table[pos])) {
+
+    if (ei->nodes[id].parent == parent && ei->nodes[id].c == c) { return id; }
+    pos = (pos + 1) & mask;
+
+  }
+
+  return 0;
+
+}
+
+static void extras_table_put(struct extras_index *ei, u32 id) {
+
+  u32 mask = (1U << ei->table_bits) - 1,
+      pos = extras_slot(ei->nodes[id].parent, ei->nodes[id].c, ei->table_bits);
+
+  while (ei->table[pos]) {
+
+    pos = (pos + 1) & mask;
+
+  }
+
+  ei->table[pos] = id;
+
+}
+
+static u32 extras_add_child(struct extras_index *ei, u32 parent, u8 c) {
+
+  u32 id = ei->node_cnt++;
+
+  ei->nodes = afl_realloc((void **)&ei->nodes,
+                          ei->node_cnt * sizeof(struct extras_node));
+  if (unlikely(!ei->nodes)) { PFATAL("alloc"); }
+
+  memset(&ei->nodes[id], 0, sizeof(struct extras_node));
+  ei->nodes[id].parent = parent;
+  ei->nodes[id].c = c;
+  ei->nodes[id].depth = ei->nodes[parent].depth + 1;
+
+  /* Keep the table at most half full. */
+
+  if (ei->node_cnt > (1U << (ei->table_bits - 1))) {
+
+    ck_free(ei->table);
+    ++ei->table_bits;
+    ei->table = ck_alloc(sizeof(u32) << ei->table_bits);
+
+    for (u32 i = 1; i < ei->node_cnt; ++i) {
+
+      extras_table_put(ei, i);
+
+    }
+
+  } else {
+
+    extras_table_put(ei, id);
+
+  }
+
+  return id;
+
+}
+
+/* Returns the node of the token, 0 if it is not in the trie. */
+
+static u32 extras_find(struct extras_index *ei, u8 *mem, u32 len) {
+
+  u32 id = 0;
+
+  while (len-- && (id = extras_child(ei, id, tolower(*(mem++))))) {}
+
+  return id;
+
+}
+
+/* Count the token as user (is_auto == 0) or auto extra, inc is 1 or -1. */
+
+static void extras_index_count(struct extras_index *ei, u8 *mem, u32 len,
+                               u8 is_auto, s32 inc) {
+
+  u32 id = 0, i, next;
+
+  if (unlikely(!len || len > MAX_DICT_FILE)) { return; }
+
+  for (i = 0; i < len; ++i) {
+
+    u8 c = tolower(mem[i]);
+
+    if (!(next = extras_child(ei, id, c))) {
+
+      if (inc < 0) { return; }
+      next = extras_add_child(ei, id, c);
+
+    }
+
+    id = next;
+
+  }
+
+  if (is_auto) {
+
+    ei->nodes[id].autos += inc;
+
+  } else {
+
+    ei->nodes[id].user += inc;
+
+  }
+
+  ei->live_bytes += inc * (s64)len;
+  ei->dirty = 1;
+
+}
+
+static void extras_index_drop(afl_state_t *afl) {
+
+  struct extras_index *ei = afl->extras_index;
+
+  if (!ei) { return; }
+
+  afl_free(ei->nodes);
+  afl_free(ei->order);
+  ck_free(ei->table);
+  ck_free(ei);
+  afl->extras_index = NULL;
+
+}
+
+/* Returns the index, (re)building it from extras[] and a_extras[] when it
+   was dropped or evicted auto extras left too many unused nodes. */
+
+static struct extras_index *extras_index_get(afl_state_t *afl) {
+
+  struct extras_index *ei = afl->extras_index;
+  u32                  i;
+
+  if (likely(ei) && likely(ei->node_cnt <= 4 * ei->live_bytes + (1U << 16))) {
+
+    return ei;
+
+  }
+
+  extras_index_drop(afl);
+
+  ei = afl->extras_index = ck_alloc(sizeof(struct extras_index));
+  ei->table_bits = 10;
+  ei->table = ck_alloc(sizeof(u32) << ei->table_bits);
+  ei->node_cnt = 1;
+  ei->nodes = afl_realloc((void **)&ei->nodes, sizeof(struct extras_node));
+  if (unlikely(!ei->nodes)) { PFATAL("alloc"); }
+  memset(ei->nodes, 0, sizeof(struct extras_node));
+
+  for (i = 0; i < afl->extras_cnt; ++i) {
+
+    extras_index_count(ei, afl->extras[i].data, afl->extras[i].len, 0, 1);
+
+  }
+
+  for (i = 0; i < afl->a_extras_cnt; ++i) {
+
+    extras_index_count(ei, afl->a_extras[i].data, afl->a_extras[i].len, 1, 1);
+
+  }
+
+  return ei;
+
+}
+
+static void extras_index_link(struct extras_index *ei) {
+
+  u32 cnt[MAX_DICT_FILE + 2] = {0}, i;
+
+  /* Sort the nodes by depth, a failure link always points to a node that
+     is less deep. */
+
+  ei->order = afl_realloc((void **)&ei->order, ei->node_cnt * sizeof(u32));
+  if (unlikely(!ei->order)) { PFATAL("alloc"); }
+
+  for (i = 0; i < ei->node_cnt; ++i) {
+
+    ++cnt[ei->nodes[i].depth + 1];
+
+  }
+
+  for (i = 1; i < MAX_DICT_FILE + 2; ++i) {
+
+    cnt[i] += cnt[i - 1];
+
+  }
+
+  for (i = 0; i < ei->node_cnt; ++i) {
+
+    ei->order[cnt[ei->nodes[i].depth]++] = i;
+
+  }
+
+  for (i = 1; i < ei->node_cnt; ++i) {
+
+    struct extras_node *n = &ei->nodes[ei->order[i]];
+    u32                 f = 0;
+
+    if (n->parent) {
+
+      f = ei->nodes[n->parent].fail;
+      while (f && !extras_child(ei, f, n->c)) {
+
+        f = ei->nodes[f].fail;
+
+      }
+
+      f = extras_child(ei, f, n->c);
+
+    }
+
+    n->fail = f;
+    n->ends = n->user || n->autos || ei->nodes[f].ends;
+
+  }
+
+  ei->dirty = 0;
+
+}
+
+/* Scan buf for dictionary tokens. Fills ends with len + 1 bytes, entry i
+   is set if a user or auto extra (compared case-insensitively) might end
+   right before offset i. */
+
+void extras_index_ends(afl_state_t *afl, u8 *buf, u32 len, u8 *ends) {
+
+  struct extras_index *ei = extras_index_get(afl);
+  u32                  i, id = 0, next;
+
+  if (ei->dirty) { extras_index_link(ei); }
+
+  ends[0] = 0;
+
+  for (i = 0; i < len; ++i) {
+
+    u8 c = tolower(buf[i]);
+
+    while (!(next = extras_child(ei, id, c)) && id) {
+
+      id = ei->nodes[id].fail;
+
+    }
+
+    id = next;
+    ends[i + 1] = ei->nodes[id].ends;
+
+  }
+
+}
+
 /* helper function for auto_extras qsort */
 static int compare_auto_extras_len(const void *ae1, const void *ae2) {
 
@@ -286,6 +580,8 @@ static void extras_check_and_sort(afl_state_t *afl, u32 min_len, u32 max_len,
 
   }
 
+  extras_index_drop(afl);
+
 }
 
 /* Read extras from the extras directory and sort them by size. */
@@ -524,6 +820,8 @@ void deunicode_extras(afl_state_t *afl) {
   qsort(afl->extras, afl->extras_cnt, sizeof(struct extra_data),
         compare_extras_len);
 
+  extras_index_drop(afl);
+
 }
 
 /* Removes duplicates from the loaded extras. This can happen if multiple files
@@ -565,14 +863,19 @@ void dedup_extras(afl_state_t *afl) {
     afl->extras = afl_realloc_exact(
         (void **)&afl->extras, afl->extras_cnt * sizeof(struct extra_data));
 
+  extras_index_drop(afl);
+
 }
 
 /* Adds a new extra / dict entry. */
 void add_extra(afl_state_t *afl, u8 *mem, u32 len) {
 
-  u32 i, found = 0;
+  struct extras_index *ei = extras_index_get(afl);
+  u32                  i, found = 0, id = extras_find(ei, mem, len);
+
+  /* Only a token that matches case-insensitively can be a duplicate. */
 
-  for (i = 0; i < afl->extras_cnt; i++) {
+  for (i = 0; id && ei->nodes[id].user && i < afl->extras_cnt; i++) {
 
     if (afl->extras[i].len == len) {
 
@@ -602,9 +905,20 @@ void add_extra(afl_state_t *afl, u8 *mem, u32 len) {
   }
 
   add_extra_nocheck(afl, mem, len);
+  extras_index_count(ei, mem, len, 0, 1);
 
-  qsort(afl->extras, afl->extras_cnt, sizeof(struct extra_data),
-        compare_extras_len);
+  /* Move it behind the last token that is not longer, the rest is still
+     sorted by size. */
+
+  struct extra_data e = afl->extras[afl->extras_cnt - 1];
+
+  for (i = afl->extras_cnt - 1; i && afl->extras[i - 1].len > len; --i) {
+
+    afl->extras[i] = afl->extras[i - 1];
+
+  }
+
+  afl->extras[i] = e;
 
 }
 
@@ -665,27 +979,19 @@ void maybe_add_auto(afl_state_t *afl, u8 *mem, u32 len) {
   }
 
   /* Reject anything that matches existing extras. Do a case-insensitive
-     match. We optimize by exploiting the fact that extras[] are sorted
-     by size. */
-
-  for (i = 0; i < afl->extras_cnt; ++i) {
-
-    if (afl->extras[i].len >= len) { break; }
+     match, which the index does for us. */
 
-  }
+  struct extras_index *ei = extras_index_get(afl);
+  u32                  id = extras_find(ei, mem, len);
 
-  for (; i < afl->extras_cnt && afl->extras[i].len == len; ++i) {
-
-    if (!memcmp_nocase(afl->extras[i].data, mem, len)) { return; }
-
-  }
+  if (id && ei->nodes[id].user) { return; }
 
   /* Last but not least, check afl->a_extras[] for matches. There are no
      guarantees of a particular sort order. */
 
   afl->auto_changed = 1;
 
-  for (i = 0; i < afl->a_extras_cnt; ++i) {
+  for (i = 0; id && ei->nodes[id].autos && i < afl->a_extras_cnt; ++i) {
 
     if (afl->a_extras[i].len == len &&
         !memcmp_nocase(afl->a_extras[i].data, mem, len)) {
@@ -711,12 +1017,15 @@ void maybe_add_auto(afl_state_t *afl, u8 *mem, u32 len) {
 
     i = MAX_AUTO_EXTRAS / 2 + rand_below(afl, (MAX_AUTO_EXTRAS + 1) / 2);
 
+    extras_index_count(ei, afl->a_extras[i].data, afl->a_extras[i].len, 1, -1);
     memcpy(afl->a_extras[i].data, mem, len);
     afl->a_extras[i].len = len;
     afl->a_extras[i].hit_cnt = 0;
 
   }
 
+  extras_index_count(ei, mem, len, 1, 1);
+
 sort_a_extras:
 
   /* First, sort all auto extras by use count, descending order. */
@@ -827,6 +1136,7 @@ void destroy_extras(afl_state_t *afl) {
   }
 
   afl_free(afl->extras);
+  extras_index_drop(afl);
 
 }
 
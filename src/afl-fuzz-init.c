@@ -906,6 +906,7 @@ void read_testcases(afl_state_t *afl, u8 *directory) {
 void perform_dry_run(afl_state_t *afl) {
 
   struct queue_entry *q;
+  struct cal_pool    *pool = cal_pool_start(afl);
   u32                 cal_failures = 0, idx;
   u8                 *use_mem;
 
@@ -939,7 +940,8 @@ void perform_dry_run(afl_state_t *afl) {
 
     close(fd);
 
-    res = calibrate_case(afl, q, use_mem, 0, 1);
+    res = cal_pool_take(pool, idx, q);
+    if (res == FSRV_RUN_ERROR) { res = calibrate_case(afl, q, use_mem, 0, 1); }
 
     /* For AFLFast schedules we update the queue entry */
     if (unlikely(afl->schedule >= FAST && afl->schedule <= RARE) &&
@@ -949,7 +951,12 @@ void perform_dry_run(afl_state_t *afl) {
 
     }
 
-    if (afl->stop_soon) { return; }
+    if (afl->stop_soon) {
+
+      cal_pool_stop(pool);
+      return;
+
+    }
 
     if (res == afl->crash_mode || res == FSRV_RUN_NOBITS) {
 
@@ -1333,6 +1340,8 @@ void perform_dry_run(afl_state_t *afl) {
 
   }
 
+  cal_pool_stop(pool);
+
   if (cal_failures) {
 
     if (cal_failures == afl->queued_items) {
@@ -1477,6 +1486,48 @@ static void link_or_copy(u8 *old_path, u8 *new_path) {
 
 }
 
+/* Take over the skip inference results of the session we resume. They are
+   named after the input, so the names stay. */
+
+static void pivot_skipdet(afl_state_t *afl) {
+
+  DIR           *d;
+  struct dirent *d_ent;
+  u8            *dir = alloc_printf("%s/.state/skipdet", afl->in_dir);
+
+  d = opendir(dir);
+
+  if (!d) {
+
+    ck_free(dir);
+    return;
+
+  }
+
+  while ((d_ent = readdir(d))) {
+
+    if (d_ent->d_name[0] == '.' || strstr(d_ent->d_name, ".tmp")) {
+
+      continue;
+
+    }
+
+    u8 *ofn = alloc_printf("%s/%s", dir, d_ent->d_name);
+    u8 *nfn =
+        alloc_printf("%s/queue/.state/skipdet/%s", afl->out_dir, d_ent->d_name);
+
+    link_or_copy(ofn, nfn);
+
+    ck_free(ofn);
+    ck_free(nfn);
+
+  }
+
+  closedir(d);
+  ck_free(dir);
+
+}
+
 /* Create hard links for input test cases in the output directory, choosing
    good names and pivoting accordingly. */
 
@@ -1611,6 +1662,8 @@ void pivot_inputs(afl_state_t *afl) {
 
   }
 
+  pivot_skipdet(afl);
+
   if (afl->in_place_resume) { nuke_resume_dir(afl); }
 
 }
@@ -1815,6 +1868,14 @@ void nuke_resume_dir(afl_state_t *afl) {
   if (delete_files(fn, case_prefix)) { goto dir_cleanup_failed; }
   ck_free(fn);
 
+  fn = alloc_printf("%s/_resume/.state/skipdet", afl->out_dir);
+  if (delete_files(fn, NULL)) { goto dir_cleanup_failed; }
+  ck_free(fn);
+
+  fn = alloc_printf("%s/_resume/.state/havoc_bandit", afl->out_dir);
+  if (unlink(fn) && errno != ENOENT) { goto dir_cleanup_failed; }
+  ck_free(fn);
+
   fn = alloc_printf("%s/_resume/.state", afl->out_dir);
   if (rmdir(fn) && errno != ENOENT) { goto dir_cleanup_failed; }
   ck_free(fn);
@@ -1976,6 +2037,14 @@ static void handle_existing_out_dir(afl_state_t *afl) {
   if (delete_files(fn, case_prefix)) { goto dir_cleanup_failed; }
   ck_free(fn);
 
+  fn = alloc_printf("%s/queue/.state/skipdet", afl->out_dir);
+  if (delete_files(fn, NULL)) { goto dir_cleanup_failed; }
+  ck_free(fn);
+
+  fn = alloc_printf("%s/queue/.state/havoc_bandit", afl->out_dir);
+  if (unlink(fn) && errno != ENOENT) { goto dir_cleanup_failed; }
+  ck_free(fn);
+
   /* Then, get rid of the .state subdirectory itself (should be empty by now)
      and everything matching <afl->out_dir>/queue/id:*. */
 
@@ -2279,6 +2348,12 @@ void setup_dirs_fds(afl_state_t *afl) {
   if (mkdir(tmp, 0700)) { PFATAL("Unable to create '%s'", tmp); }
   ck_free(tmp);
 
+  /* Results of the skip inference, named after the input. */
+
+  tmp = alloc_printf("%s/queue/.state/skipdet/", afl->out_dir);
+  if (mkdir(tmp, 0700)) { PFATAL("Unable to create '%s'", tmp); }
+  ck_free(tmp);
+
   /* Sync directory for keeping track of cooperating fuzzers. */
 
   if (afl->sync_id) {
@@ -2368,6 +2443,77 @@ void setup_dirs_fds(afl_state_t *afl) {
 
 }
 
+/* Open the packed corpus files (AFL_PACK_CORPUS). An in-place resume
+   continues the packs: the resumed queue entries were all packed by the
+   earlier session already (under their old names), so queue.pack is kept
+   as it is if it has at least as many complete records. Otherwise, and on
+   a fresh start, the current queue is written into an empty queue.pack.
+   Later finds are appended by save_if_interesting(). */
+
+void setup_pack_files(afl_state_t *afl) {
+
+  struct afl_pack_record rec;
+  u8                     fn[PATH_MAX];
+  u32                    i, have = 0;
+  s32                    pack_fd, idx_fd;
+
+  if (likely(!afl->afl_env.afl_pack_corpus)) { return; }
+
+  for (i = 0; i < AFL_PACK_KINDS; ++i) {
+
+    snprintf(fn, PATH_MAX, "%s/%s.pack", afl->out_dir, afl_pack_names[i]);
+    afl_pack_open(fn, &afl->pack_fd[i], &afl->pack_idx_fd[i],
+                  !afl->in_place_resume);
+
+  }
+
+  pack_fd = afl->pack_fd[AFL_PACK_QUEUE];
+  idx_fd = afl->pack_idx_fd[AFL_PACK_QUEUE];
+
+  if (afl->in_place_resume && (have = afl_pack_count(idx_fd))) {
+
+    u8 *mem = afl_pack_read(pack_fd, idx_fd, have - 1, &rec);
+
+    if (mem && have >= afl->queued_items) {
+
+      ck_free(mem);
+      OKF("Continuing %s/queue.pack with %u records.", afl->out_dir, have);
+      return;
+
+    }
+
+    ck_free(mem);
+    WARNF("%s/queue.pack does not match the resumed queue, rewriting it.",
+          afl->out_dir);
+
+    if (ftruncate(pack_fd, 0) || ftruncate(idx_fd, 0)) {
+
+      PFATAL("Unable to truncate %s/queue.pack", afl->out_dir);
+
+    }
+
+  }
+
+  for (i = 0; i < afl->queued_items; ++i) {
+
+    struct queue_entry *q = afl->queue_buf[i];
+    u8                 *buf = ck_alloc_nozero(q->len);
+    s32                 fd = open((char *)q->fname, O_RDONLY);
+
+    if (fd < 0) { PFATAL("Unable to open '%s'", q->fname); }
+    ck_read(fd, buf, q->len, q->fname);
+    close(fd);
+
+    pack_save(afl, AFL_PACK_QUEUE, q->id, q->fname, buf, q->len);
+    ck_free(buf);
+
+  }
+
+  OKF("Packed %u queue entries into %s/queue.pack.", afl->queued_items,
+      afl->out_dir);
+
+}
+
 void setup_cmdline_file(afl_state_t *afl, char **argv) {
 
   u8 *tmp;
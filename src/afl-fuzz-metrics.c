@@ -0,0 +1,515 @@
+/*
+   american fuzzy lop++ - OpenMetrics endpoint
+   -------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   With AFL_METRICS set, a thread answers HTTP requests for /metrics with
+   the numbers of the stats page (see include/afl-stats-page.h) in the
+   OpenMetrics text format, so Prometheus can scrape an instance directly.
+
+   The fuzzing thread only publishes the page as it does anyway on every
+   UI refresh. All formatting is done here, on a consistent copy of the
+   page taken with stats_page_read(), and nothing in afl_state_t is
+   touched by this thread.
+
+ */
+
+#include "afl-fuzz.h"
+#include "afl-stats-page.h"
+
+#include <stdarg.h>
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define METRICS_BUF_SIZE (64U * 1024)
+#define METRICS_REQ_SIZE 2048
+#define METRICS_POLL_MS 250                 /* How often stop is checked    */
+#define METRICS_IO_TIMEOUT_SEC 2
+
+struct metrics {
+
+  pthread_t          thread;
+  s32                sock;
+  u8                 stop;              /* Set to end the thread            */
+  struct stats_page *page;
+
+  char labels[160];                     /* banner="..." of the current copy */
+  char buf[METRICS_BUF_SIZE];
+  u32  len;
+
+};
+
+enum {
+
+  /* 00 */ METRIC_U64,
+  /* 01 */ METRIC_U32,
+  /* 02 */ METRIC_DBL,
+  /* 03 */ METRIC_MS,                   /* u64 ms, exported as seconds      */
+  /* 04 */ METRIC_MS32                  /* u32 ms, exported as seconds      */
+
+};
+
+#define M(field) offsetof(struct stats_page_data, field)
+
+/* One sample. A family starts with the first entry of its name, entries
+   of the same family follow each other and differ in their label. */
+
+static const struct {
+
+  const char *name;
+  const char *type;
+  const char *help;
+  const char *label;
+  u32         off;
+  u8          kind;
+
+} metric_list[] = {
+
+    {"afl_run_seconds", "counter", "Run time including earlier sessions",
+     NULL, M(run_time), METRIC_MS},
+    {"afl_activity_seconds", "counter", "Run time by activity",
+     "activity=\"fuzz\"", M(fuzz_time), METRIC_MS},
+    {"afl_activity_seconds", "counter", NULL, "activity=\"calibration\"",
+     M(calibration_time), METRIC_MS},
+    {"afl_activity_seconds", "counter", NULL, "activity=\"cmplog\"",
+     M(cmplog_time), METRIC_MS},
+    {"afl_activity_seconds", "counter", NULL, "activity=\"sync\"",
+     M(sync_time), METRIC_MS},
+    {"afl_activity_seconds", "counter", NULL, "activity=\"trim\"",
+     M(trim_time), METRIC_MS},
+    {"afl_start_time_seconds", "gauge", "Start of this session", NULL,
+     M(start_time), METRIC_MS},
+    {"afl_last_update_time_seconds", "gauge", "Last update of the numbers",
+     NULL, M(last_update), METRIC_MS},
+    {"afl_last_find_time_seconds", "gauge", "Last new corpus entry, 0 if none",
+     NULL, M(last_find), METRIC_MS},
+    {"afl_last_crash_time_seconds", "gauge", "Last saved crash, 0 if none",
+     NULL, M(last_crash), METRIC_MS},
+    {"afl_last_hang_time_seconds", "gauge", "Last saved hang, 0 if none", NULL,
+     M(last_hang), METRIC_MS},
+    {"afl_cycles", "counter", "Queue cycles done", NULL, M(cycles_done),
+     METRIC_U64},
+    {"afl_cycles_wo_finds", "gauge", "Queue cycles without a find", NULL,
+     M(cycles_wo_finds), METRIC_U64},
+    {"afl_execs", "counter", "Target executions", NULL, M(execs_done),
+     METRIC_U64},
+    {"afl_calibration_execs", "counter", "Target executions for calibration",
+     NULL, M(calibration_execs), METRIC_U64},
+    {"afl_trim_execs", "counter", "Target executions for trimming", NULL,
+     M(trim_execs), METRIC_U64},
+    {"afl_execs_since_crash", "gauge", "Target executions since the last crash",
+     NULL, M(execs_since_crash), METRIC_U64},
+    {"afl_execs_per_second", "gauge", "Execution speed", "window=\"run\"",
+     M(execs_per_sec), METRIC_DBL},
+    {"afl_execs_per_second", "gauge", NULL, "window=\"last_min\"",
+     M(execs_ps_last_min), METRIC_DBL},
+    {"afl_execs_per_second", "gauge", NULL, "window=\"now\"", M(execs_ps_now),
+     METRIC_DBL},
+    {"afl_crashes", "counter", "Crashes seen", NULL, M(total_crashes),
+     METRIC_U64},
+    {"afl_saved_crashes", "counter", "Crashes with a unique signature", NULL,
+     M(saved_crashes), METRIC_U64},
+    {"afl_timeouts", "counter", "Timeouts seen", NULL, M(total_tmouts),
+     METRIC_U64},
+    {"afl_saved_timeouts", "counter", "Timeouts with a unique signature", NULL,
+     M(saved_tmouts), METRIC_U64},
+    {"afl_saved_hangs", "counter", "Hangs with a unique signature", NULL,
+     M(saved_hangs), METRIC_U64},
+    {"afl_corpus_entries", "gauge", "Corpus entries", NULL, M(corpus_count),
+     METRIC_U32},
+    {"afl_corpus_favored", "gauge", "Favored corpus entries", NULL,
+     M(corpus_favored), METRIC_U32},
+    {"afl_corpus_found", "counter", "Corpus entries found by this instance",
+     NULL, M(corpus_found), METRIC_U32},
+    {"afl_corpus_imported", "counter", "Corpus entries imported from others",
+     NULL, M(corpus_imported), METRIC_U32},
+    {"afl_corpus_variable", "gauge", "Corpus entries with variable behavior",
+     NULL, M(corpus_variable), METRIC_U32},
+    {"afl_corpus_with_cov", "gauge", "Corpus entries with new coverage bytes",
+     NULL, M(corpus_with_cov), METRIC_U32},
+    {"afl_max_depth", "gauge", "Deepest corpus entry", NULL, M(max_depth),
+     METRIC_U32},
+    {"afl_cur_item", "gauge", "Corpus entry being fuzzed", NULL, M(cur_item),
+     METRIC_U32},
+    {"afl_pending", "gauge", "Corpus entries not fuzzed yet", "kind=\"total\"",
+     M(pending_total), METRIC_U32},
+    {"afl_pending", "gauge", NULL, "kind=\"favored\"", M(pending_favs),
+     METRIC_U32},
+    {"afl_stability_percent", "gauge", "Stability", NULL, M(stability),
+     METRIC_DBL},
+    {"afl_bitmap_coverage_percent", "gauge", "Coverage map density", NULL,
+     M(bitmap_cvg), METRIC_DBL},
+    {"afl_edges_found", "gauge", "Edges covered", NULL, M(edges_found),
+     METRIC_U32},
+    {"afl_edges", "gauge", "Size of the coverage map", NULL, M(total_edges),
+     METRIC_U32},
+    {"afl_var_bytes", "gauge", "Map bytes with variable behavior", NULL,
+     M(var_byte_count), METRIC_U32},
+    {"afl_exec_timeout_seconds", "gauge", "Execution timeout", NULL,
+     M(exec_timeout), METRIC_MS32},
+    {"afl_slowest_exec_seconds", "gauge", "Slowest execution", NULL,
+     M(slowest_exec_ms), METRIC_MS32},
+    {"afl_trim_bytes", "counter", "Bytes going through the trimmer",
+     "side=\"in\"", M(bytes_trim_in), METRIC_U64},
+    {"afl_trim_bytes", "counter", NULL, "side=\"out\"", M(bytes_trim_out),
+     METRIC_U64},
+    {"afl_trim_steps_skipped", "counter", "Trim step sizes left out", NULL,
+     M(trim_steps_skipped), METRIC_U64},
+    {"afl_sync_skipped", "counter", "Sync executions saved by the sync bus",
+     NULL, M(sync_skipped), METRIC_U64},
+    {"afl_cmplog_unchanged", "counter", "Comparisons solved by the mother",
+     NULL, M(cmplog_unchanged), METRIC_U64},
+    {"afl_skipdet_reused", "gauge", "Results reused from .state/skipdet", NULL,
+     M(skipdet_reused), METRIC_U32},
+    {"afl_havoc_expansion", "gauge", "Havoc expansion level", NULL,
+     M(havoc_expansion), METRIC_U32},
+    {"afl_auto_dict_entries", "gauge", "Auto dictionary entries", NULL,
+     M(auto_dict_entries), METRIC_U32},
+    {"afl_testcache_bytes", "gauge", "Size of the cached test cases", NULL,
+     M(testcache_size), METRIC_U64},
+    {"afl_testcache_entries", "gauge", "Cached test cases", NULL,
+     M(testcache_count), METRIC_U32},
+    {"afl_testcache_lookups", "counter", "Test case cache lookups",
+     "result=\"hit\"", M(testcache_hits), METRIC_U64},
+    {"afl_testcache_lookups", "counter", NULL, "result=\"miss\"",
+     M(testcache_misses), METRIC_U64},
+    {"afl_testcache_evictions", "counter", "Test cases evicted from the cache",
+     NULL, M(testcache_evict), METRIC_U32},
+    {"afl_stopped", "gauge", "1 once afl-fuzz has exited", NULL, M(stopped),
+     METRIC_U32},
+    {NULL, NULL, NULL, NULL, 0, 0}
+
+};
+
+#undef M
+
+static void metrics_add(struct metrics *m, const char *fmt, ...) {
+
+  va_list ap;
+  s32     ret;
+
+  if (m->len >= METRICS_BUF_SIZE) { return; }
+
+  va_start(ap, fmt);
+  ret = vsnprintf(m->buf + m->len, METRICS_BUF_SIZE - m->len, fmt, ap);
+  va_end(ap);
+
+  if (ret > 0) { m->len = MIN(m->len + (u32)ret, METRICS_BUF_SIZE); }
+
+}
+
+/* Set m->labels to the banner label, escaped as OpenMetrics wants it. */
+
+static void metrics_labels(struct metrics *m, const char *banner) {
+
+  u32 len = 0, i;
+
+  len = snprintf(m->labels, sizeof(m->labels), "banner=\"");
+
+  for (i = 0; banner[i] && i < sizeof(((struct stats_page_data *)0)->banner) &&
+              len + 3 < sizeof(m->labels);
+       ++i) {
+
+    char c = banner[i];
+
+    if (c == '\\' || c == '"') {
+
+      m->labels[len++] = '\\';
+      m->labels[len++] = c;
+
+    } else if (c == '\n') {
+
+      m->labels[len++] = '\\';
+      m->labels[len++] = 'n';
+
+    } else {
+
+      m->labels[len++] = c;
+
+    }
+
+  }
+
+  m->labels[len++] = '"';
+  m->labels[len] = 0;
+
+}
+
+/* Format the page copy d into m->buf. */
+
+static void metrics_format(struct metrics *m, struct stats_page_data *d) {
+
+  const char *family = NULL;
+
+  m->len = 0;
+  metrics_labels(m, d->banner);
+
+  metrics_add(m,
+              "# TYPE afl_info gauge\n# HELP afl_info Instance information\n"
+              "afl_info{%s,version=\"" VERSION "\",pid=\"%u\"} 1\n",
+              m->labels, d->fuzzer_pid);
+
+  for (u32 i = 0; metric_list[i].name; ++i) {
+
+    const u8 *src = (u8 *)d + metric_list[i].off;
+    const u8  counter = !strcmp(metric_list[i].type, "counter");
+
+    if (!family || strcmp(family, metric_list[i].name)) {
+
+      family = metric_list[i].name;
+      metrics_add(m, "# TYPE %s %s\n# HELP %s %s\n", family,
+                  metric_list[i].type, family, metric_list[i].help);
+
+    }
+
+    metrics_add(m, "%s%s{%s%s%s} ", family, counter ? "_total" : "",
+                m->labels, metric_list[i].label ? "," : "",
+                metric_list[i].label ? metric_list[i].label : "");
+
+    switch (metric_list[i].kind) {
+
+      case METRIC_U64:
+        metrics_add(m, "%llu\n", *(u64 *)src);
+        break;
+      case METRIC_U32:
+        metrics_add(m, "%u\n", *(u32 *)src);
+        break;
+      case METRIC_DBL:
+        metrics_add(m, "%0.02f\n", *(double *)src);
+        break;
+      case METRIC_MS:
+        metrics_add(m, "%llu.%03llu\n", *(u64 *)src / 1000,
+                    *(u64 *)src % 1000);
+        break;
+      case METRIC_MS32:
+        metrics_add(m, "%u.%03u\n", *(u32 *)src / 1000, *(u32 *)src % 1000);
+        break;
+
+    }
+
+  }
+
+  metrics_add(m, "# EOF\n");
+
+}
+
+static void metrics_send(s32 fd, const char *buf, u32 len) {
+
+  while (len) {
+
+    ssize_t ret = send(fd, buf, len, MSG_NOSIGNAL);
+    if (ret <= 0) { return; }
+    buf += ret;
+    len -= ret;
+
+  }
+
+}
+
+static void metrics_reply(s32 fd, const char *status, const char *type,
+                          const char *body, u32 len) {
+
+  char head[256];
+  s32  head_len = snprintf(head, sizeof(head),
+                           "HTTP/1.1 %s\r\nContent-Type: %s\r\n"
+                           "Content-Length: %u\r\nConnection: close\r\n\r\n",
+                           status, type, len);
+
+  metrics_send(fd, head, head_len);
+  metrics_send(fd, body, len);
+
+}
+
+/* Answer the request on fd. Only GET /metrics (or /) is served. */
+
+static void metrics_serve(struct metrics *m, s32 fd) {
+
+  char           req[METRICS_REQ_SIZE], *path, *end;
+  u32            len = 0;
+  struct timeval tv = {.tv_sec = METRICS_IO_TIMEOUT_SEC};
+
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  /* The request line is all we need, but the whole header is read so the
+     client does not see a reset. */
+
+  while (len < sizeof(req) - 1) {
+
+    ssize_t ret = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+    if (ret <= 0) { break; }
+    len += ret;
+    req[len] = 0;
+    if (strstr(req, "\r\n\r\n")) { break; }
+
+  }
+
+  req[len] = 0;
+
+  if (strncmp(req, "GET ", 4)) {
+
+    metrics_reply(fd, "405 Method Not Allowed", "text/plain", "", 0);
+    return;
+
+  }
+
+  path = req + 4;
+  end = path + strcspn(path, " ?\r\n");
+  *end = 0;
+
+  if (strcmp(path, "/metrics") && strcmp(path, "/")) {
+
+    metrics_reply(fd, "404 Not Found", "text/plain", "", 0);
+    return;
+
+  }
+
+  struct stats_page_data d;
+
+  if (stats_page_read(m->page, &d)) {
+
+    metrics_reply(fd, "503 Service Unavailable", "text/plain", "", 0);
+    return;
+
+  }
+
+  metrics_format(m, &d);
+  metrics_reply(fd, "200 OK",
+                "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                m->buf, m->len);
+
+}
+
+static void *metrics_thread(void *arg) {
+
+  struct metrics *m = arg;
+
+  while (!__atomic_load_n(&m->stop, __ATOMIC_ACQUIRE)) {
+
+    struct pollfd pfd = {.fd = m->sock, .events = POLLIN};
+
+    if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) { continue; }
+
+    s32 fd = accept(m->sock, NULL, NULL);
+    if (fd < 0) { continue; }
+
+    metrics_serve(m, fd);
+    close(fd);
+
+  }
+
+  return NULL;
+
+}
+
+/* Open the listening socket and start the thread. Needs the stats page. */
+
+void metrics_init(afl_state_t *afl) {
+
+  struct metrics    *m;
+  struct addrinfo    hints, *res;
+  struct sockaddr_in addr;
+  socklen_t          addr_len = sizeof(addr);
+  sigset_t           all, old;
+  u16                port = METRICS_DEFAULT_PORT;
+  char              *host = METRICS_DEFAULT_HOST;
+  s32                one = 1;
+
+  if (!afl->afl_env.afl_metrics || !afl->stats_page) { return; }
+
+  if (afl->afl_env.afl_metrics_port) {
+
+    port = atoi(afl->afl_env.afl_metrics_port);
+
+  }
+
+  if (afl->afl_env.afl_metrics_host) { host = afl->afl_env.afl_metrics_host; }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if (getaddrinfo(host, NULL, &hints, &res)) {
+
+    FATAL("Unable to resolve AFL_METRICS_HOST '%s'", host);
+
+  }
+
+  memcpy(&addr, res->ai_addr, sizeof(addr));
+  freeaddrinfo(res);
+  addr.sin_port = htons(port);
+
+  m = ck_alloc(sizeof(struct metrics));
+  m->page = afl->stats_page;
+
+  m->sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (m->sock < 0) { PFATAL("Unable to create the metrics socket"); }
+
+  setsockopt(m->sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  if (bind(m->sock, (struct sockaddr *)&addr, sizeof(addr))) {
+
+    PFATAL("Unable to bind the metrics socket to %s:%u", host, port);
+
+  }
+
+  if (listen(m->sock, 16)) { PFATAL("listen() failed"); }
+
+  /* With port 0 the kernel picks one. */
+
+  if (!getsockname(m->sock, (struct sockaddr *)&addr, &addr_len)) {
+
+    port = ntohs(addr.sin_port);
+
+  }
+
+  /* Signals are for the fuzzing thread only. */
+
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+
+  if (pthread_create(&m->thread, NULL, metrics_thread, m)) {
+
+    FATAL("Unable to start the metrics thread");
+
+  }
+
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  afl->metrics = m;
+  OKF("Serving OpenMetrics on http://%s:%u/metrics", host, port);
+
+}
+
+/* Stop the thread, before the stats page goes away. */
+
+void metrics_destroy(afl_state_t *afl) {
+
+  struct metrics *m = afl->metrics;
+
+  if (!m) { return; }
+
+  __atomic_store_n(&m->stop, 1, __ATOMIC_RELEASE);
+  pthread_join(m->thread, NULL);
+  close(m->sock);
+
+  ck_free(m);
+  afl->metrics = NULL;
+
+}
+
@@ -289,6 +289,67 @@ static u8 could_be_interest(u32 old_val, u32 new_val, u8 blen, u8 check_le) {
 
 }
 
+/* The 8-bit arith and interest stages only depend on the value of the byte
+   they change, so the candidates that survive the could_be_*() checks are
+   computed once for all 256 values instead of for every position. */
+
+struct det_byte_cands {
+
+  u8 arith_cnt;                         /* Number of arith deltas           */
+  u8 interest_cnt;                      /* Number of interesting values     */
+  s8 arith[2 * ARITH_MAX];              /* +j, -j for j = 1..ARITH_MAX      */
+  u8 interest[sizeof(interesting_8)];   /* Indices into interesting_8       */
+
+};
+
+static struct det_byte_cands det_byte_cands[256];
+static u8                    det_byte_cands_ready;
+
+static inline struct det_byte_cands *get_det_byte_cands(u8 val) {
+
+  if (unlikely(!det_byte_cands_ready)) {
+
+    for (u32 v = 0; v < 256; ++v) {
+
+      struct det_byte_cands *c = &det_byte_cands[v];
+
+      for (u32 j = 1; j <= ARITH_MAX; ++j) {
+
+        if (!could_be_bitflip((u8)v ^ (u8)(v + j))) {
+
+          c->arith[c->arith_cnt++] = j;
+
+        }
+
+        if (!could_be_bitflip((u8)v ^ (u8)(v - j))) {
+
+          c->arith[c->arith_cnt++] = -j;
+
+        }
+
+      }
+
+      for (u32 j = 0; j < sizeof(interesting_8); ++j) {
+
+        if (!could_be_bitflip(v ^ (u8)interesting_8[j]) &&
+            !could_be_arith(v, (u8)interesting_8[j], 1)) {
+
+          c->interest[c->interest_cnt++] = j;
+
+        }
+
+      }
+
+    }
+
+    det_byte_cands_ready = 1;
+
+  }
+
+  return &det_byte_cands[val];
+
+}
+
 #ifndef IGNORE_FINDS
 
 /* Helper function to compare buffers; returns first and last differing offset.
@@ -329,7 +390,7 @@ u8 fuzz_one_original(afl_state_t *afl) {
   u32 len, temp_len;
   u32 j;
   u32 i;
-  u8 *in_buf, *out_buf, *orig_in, *ex_tmp;
+  u8 *in_buf, *out_buf, *orig_in, *ex_tmp, *tok_end;
   u64 havoc_queued = 0, orig_hit_cnt, new_hit_cnt = 0, prev_cksum, _prev_cksum;
   u32 splice_cycle = 0, perf_score = 100, orig_perf;
 
@@ -619,6 +680,8 @@ u8 fuzz_one_original(afl_state_t *afl) {
 
   afl->stage_val_type = STAGE_VAL_NONE;
 
+  stage_time_mark(afl);
+
   orig_hit_cnt = afl->queued_items + afl->saved_crashes;
 
   /* Get a clean cksum. */
@@ -738,6 +801,7 @@ u8 fuzz_one_original(afl_state_t *afl) {
 
   afl->stage_finds[STAGE_FLIP1] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP1] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP1);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -777,6 +841,7 @@ u8 fuzz_one_original(afl_state_t *afl) {
 
   afl->stage_finds[STAGE_FLIP2] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP2] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP2);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -820,6 +885,7 @@ u8 fuzz_one_original(afl_state_t *afl) {
 
   afl->stage_finds[STAGE_FLIP4] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP4] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP4);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -868,6 +934,7 @@ u8 fuzz_one_original(afl_state_t *afl) {
 
   afl->stage_finds[STAGE_FLIP8] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP8] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP8);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -911,6 +978,7 @@ u8 fuzz_one_original(afl_state_t *afl) {
 
   afl->stage_finds[STAGE_FLIP16] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP16] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP16);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -954,6 +1022,7 @@ u8 fuzz_one_original(afl_state_t *afl) {
 
   afl->stage_finds[STAGE_FLIP32] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP32] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP32);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -989,63 +1058,39 @@ skip_bitflip:
 
     afl->stage_cur_byte = i;
 
-    for (j = 1; j <= ARITH_MAX; ++j) {
+    /* Do arithmetic operations only if the result couldn't be a product
+       of a bitflip. */
 
-      u8 r = orig ^ (orig + j);
+    struct det_byte_cands *cands = get_det_byte_cands(orig);
+    afl->stage_max -= 2 * ARITH_MAX - cands->arith_cnt;
 
-      /* Do arithmetic operations only if the result couldn't be a product
-         of a bitflip. */
+    for (j = 0; j < cands->arith_cnt; ++j) {
 
-      if (!could_be_bitflip(r)) {
+      s32 delta = cands->arith[j];
 
-        afl->stage_cur_val = j;
-        out_buf[i] = orig + j;
+      afl->stage_cur_val = delta;
+      out_buf[i] = orig + delta;
 
 #ifdef INTROSPECTION
-        snprintf(afl->mutation, sizeof(afl->mutation), "%s ARITH8+-%u-%u",
-                 afl->queue_cur->fname, i, j);
+      snprintf(afl->mutation, sizeof(afl->mutation), "%s ARITH8%s-%u-%u",
+               afl->queue_cur->fname, delta > 0 ? "+" : "-", i,
+               delta > 0 ? delta : -delta);
 #endif
 
-        if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
-        ++afl->stage_cur;
-
-      } else {
-
-        --afl->stage_max;
-
-      }
-
-      r = orig ^ (orig - j);
-
-      if (!could_be_bitflip(r)) {
-
-        afl->stage_cur_val = -j;
-        out_buf[i] = orig - j;
-
-#ifdef INTROSPECTION
-        snprintf(afl->mutation, sizeof(afl->mutation), "%s ARITH8--%u-%u",
-                 afl->queue_cur->fname, i, j);
-#endif
-
-        if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
-        ++afl->stage_cur;
-
-      } else {
-
-        --afl->stage_max;
-
-      }
-
-      out_buf[i] = orig;
+      if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
+      ++afl->stage_cur;
 
     }
 
+    out_buf[i] = orig;
+
   }
 
   new_hit_cnt = afl->queued_items + afl->saved_crashes;
 
   afl->stage_finds[STAGE_ARITH8] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_ARITH8] += afl->stage_max;
+  stage_time_account(afl, STAGE_ARITH8);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1176,6 +1221,7 @@ skip_bitflip:
 
   afl->stage_finds[STAGE_ARITH16] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_ARITH16] += afl->stage_max;
+  stage_time_account(afl, STAGE_ARITH16);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1304,6 +1350,7 @@ skip_bitflip:
 
   afl->stage_finds[STAGE_ARITH32] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_ARITH32] += afl->stage_max;
+  stage_time_account(afl, STAGE_ARITH32);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1337,24 +1384,19 @@ skip_arith:
 
     afl->stage_cur_byte = i;
 
-    for (j = 0; j < (u32)sizeof(interesting_8); ++j) {
-
-      /* Skip if the value could be a product of bitflips or arithmetics. */
-
-      if (could_be_bitflip(orig ^ (u8)interesting_8[j]) ||
-          could_be_arith(orig, (u8)interesting_8[j], 1)) {
+    /* Skip values that could be a product of bitflips or arithmetics. */
 
-        --afl->stage_max;
-        continue;
+    struct det_byte_cands *cands = get_det_byte_cands(orig);
+    afl->stage_max -= sizeof(interesting_8) - cands->interest_cnt;
 
-      }
+    for (j = 0; j < cands->interest_cnt; ++j) {
 
-      afl->stage_cur_val = interesting_8[j];
-      out_buf[i] = interesting_8[j];
+      afl->stage_cur_val = interesting_8[cands->interest[j]];
+      out_buf[i] = interesting_8[cands->interest[j]];
 
 #ifdef INTROSPECTION
       snprintf(afl->mutation, sizeof(afl->mutation), "%s INTERESTING8_%u_%u",
-               afl->queue_cur->fname, i, j);
+               afl->queue_cur->fname, i, cands->interest[j]);
 #endif
 
       if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
@@ -1370,6 +1412,7 @@ skip_arith:
 
   afl->stage_finds[STAGE_INTEREST8] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_INTEREST8] += afl->stage_max;
+  stage_time_account(afl, STAGE_INTEREST8);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1458,6 +1501,7 @@ skip_arith:
 
   afl->stage_finds[STAGE_INTEREST16] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_INTEREST16] += afl->stage_max;
+  stage_time_account(afl, STAGE_INTEREST16);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1546,6 +1590,7 @@ skip_arith:
 
   afl->stage_finds[STAGE_INTEREST32] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_INTEREST32] += afl->stage_max;
+  stage_time_account(afl, STAGE_INTEREST32);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1624,6 +1669,7 @@ skip_interest:
 
   afl->stage_finds[STAGE_EXTRAS_UO] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_UO] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_UO);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1640,6 +1686,10 @@ skip_interest:
   ex_tmp = afl_realloc(AFL_BUF_PARAM(ex), len + MAX_DICT_FILE);
   if (unlikely(!ex_tmp)) { PFATAL("alloc"); }
 
+  tok_end = afl_realloc(AFL_BUF_PARAM(tok_end), len + 1);
+  if (unlikely(!tok_end)) { PFATAL("alloc"); }
+  extras_index_ends(afl, out_buf, len, tok_end);
+
   for (i = 0; i <= (u32)len; ++i) {
 
     if (!skip_eff_map[i % len]) continue;
@@ -1650,7 +1700,14 @@ skip_interest:
 
     for (j = 0; j < afl->extras_cnt; ++j) {
 
-      if (len + afl->extras[j].len > MAX_FILE) {
+      u32 tok_len = afl->extras[j].len;
+
+      /* Inserting a token right behind a copy of itself gives the same
+         input as inserting it in front of that copy, which was done. */
+
+      if (len + tok_len > MAX_FILE ||
+          (tok_end[i] && i >= tok_len && skip_eff_map[i - tok_len] &&
+           !memcmp(out_buf + i - tok_len, afl->extras[j].data, tok_len))) {
 
         --afl->stage_max;
         continue;
@@ -1687,6 +1744,7 @@ skip_interest:
 
   afl->stage_finds[STAGE_EXTRAS_UI] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_UI] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_UI);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1750,6 +1808,7 @@ skip_user_extras:
 
   afl->stage_finds[STAGE_EXTRAS_AO] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_AO] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_AO);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1766,6 +1825,10 @@ skip_user_extras:
   ex_tmp = afl_realloc(AFL_BUF_PARAM(ex), len + MAX_DICT_FILE);
   if (unlikely(!ex_tmp)) { PFATAL("alloc"); }
 
+  tok_end = afl_realloc(AFL_BUF_PARAM(tok_end), len + 1);
+  if (unlikely(!tok_end)) { PFATAL("alloc"); }
+  extras_index_ends(afl, out_buf, len, tok_end);
+
   for (i = 0; i <= (u32)len; ++i) {
 
     if (!skip_eff_map[i % len]) continue;
@@ -1776,7 +1839,13 @@ skip_user_extras:
 
     for (j = 0; j < afl->a_extras_cnt; ++j) {
 
-      if (len + afl->a_extras[j].len > MAX_FILE) {
+      u32 tok_len = afl->a_extras[j].len;
+
+      /* See above, the token may already be in front of us. */
+
+      if (len + tok_len > MAX_FILE ||
+          (tok_end[i] && i >= tok_len && skip_eff_map[i - tok_len] &&
+           !memcmp(out_buf + i - tok_len, afl->a_extras[j].data, tok_len))) {
 
         --afl->stage_max;
         continue;
@@ -1813,6 +1882,7 @@ skip_user_extras:
 
   afl->stage_finds[STAGE_EXTRAS_AI] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_AI] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_AI);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -1844,6 +1914,8 @@ custom_mutator_stage:
 
   const u32 max_seed_size = MAX_FILE, saved_max = afl->stage_max;
 
+  stage_time_mark(afl);
+
   orig_hit_cnt = afl->queued_items + afl->saved_crashes;
 
 #ifdef INTROSPECTION
@@ -1969,6 +2041,7 @@ custom_mutator_stage:
 
   afl->stage_finds[STAGE_CUSTOM_MUTATOR] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_CUSTOM_MUTATOR] += afl->stage_cur;
+  stage_time_account(afl, STAGE_CUSTOM_MUTATOR);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -2030,6 +2103,8 @@ havoc_stage:
 
   temp_len = len;
 
+  stage_time_mark(afl);
+
   orig_hit_cnt = afl->queued_items + afl->saved_crashes;
 
   havoc_queued = afl->queued_items;
@@ -2138,13 +2213,31 @@ havoc_stage:
 
   */
 
-  stack_max = 1 << (1 + rand_below(afl, afl->havoc_stack_pow2));
+  /* With AFL_HAVOC_BANDIT the odds of the operators and the stack depth
+     are learned, see afl-fuzz-bandit.c. */
+
+  u8  bandit_cls = afl->queue_cur->is_ascii ? 1 : 0;
+  u32 stack_pow;
+
+  if (unlikely(afl->havoc_bandit)) {
+
+    rand_max = bandit_table(afl, bandit_cls, &mutation_array, rand_max);
+    stack_pow = bandit_depth(afl, bandit_cls, afl->havoc_stack_pow2);
+
+  } else {
+
+    stack_pow = rand_below(afl, afl->havoc_stack_pow2);
+
+  }
+
+  stack_max = 1 << (1 + stack_pow);
 
   // + (afl->extras_cnt ? 2 : 0) + (afl->a_extras_cnt ? 2 : 0);
 
   for (afl->stage_cur = 0; afl->stage_cur < afl->stage_max; ++afl->stage_cur) {
 
     u32 use_stacking = 1 + rand_below(afl, stack_max);
+    u64 havoc_ops = 0, havoc_hits = afl->queued_items + afl->saved_crashes;
 
     afl->stage_cur_val = use_stacking;
 
@@ -3271,12 +3364,22 @@ havoc_stage:
 
       }
 
+      havoc_ops |= 1ULL << mutation_array[r];
+
     }
 
     }
 
     if (common_fuzz_stuff(afl, out_buf, temp_len)) { goto abandon_entry; }
 
+    if (unlikely(afl->havoc_bandit)) {
+
+      bandit_update(
+          afl, bandit_cls, havoc_ops, stack_pow,
+          afl->queued_items + afl->saved_crashes != havoc_hits);
+
+    }
+
     /* out_buf might have been mangled a bit, so let's restore it to its
        original size and shape. */
 
@@ -3309,6 +3412,7 @@ havoc_stage:
 
     afl->stage_finds[STAGE_HAVOC] += new_hit_cnt - orig_hit_cnt;
     afl->stage_cycles[STAGE_HAVOC] += afl->stage_max;
+    stage_time_account(afl, STAGE_HAVOC);
 #ifdef INTROSPECTION
     afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -3317,6 +3421,7 @@ havoc_stage:
 
     afl->stage_finds[STAGE_SPLICE] += new_hit_cnt - orig_hit_cnt;
     afl->stage_cycles[STAGE_SPLICE] += afl->stage_max;
+    stage_time_account(afl, STAGE_SPLICE);
 #ifdef INTROSPECTION
     afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -3340,7 +3445,7 @@ retry_splicing:
       afl->ready_for_splicing_count > 1 && afl->queue_cur->len >= 4) {
 
     struct queue_entry *target;
-    u32                 tid, split_at;
+    u32                 tid, split_at, split_donor;
     u8                 *new_buf;
     s32                 f_diff, l_diff;
 
@@ -3354,6 +3459,50 @@ retry_splicing:
 
     }
 
+    /* Every other time, splice in an entry right behind some content it
+       shares with ours, if the splice index knows one. */
+
+    splice_index_add(afl, afl->queue_cur, in_buf, len);
+
+    if (rand_below(afl, 2) &&
+        splice_index_pick(afl, afl->queue_cur, &tid, &split_at,
+                          &split_donor)) {
+
+      target = afl->queue_buf[tid];
+
+      if (split_at + target->len - split_donor > MAX_FILE) {
+
+        goto retry_splicing;
+
+      }
+
+      afl->splicing_with = tid;
+      new_buf = queue_testcase_get(afl, target);
+
+      /* Nothing new if our head is the one of the donor anyway. */
+
+      if (split_at == split_donor && !memcmp(in_buf, new_buf, split_at)) {
+
+        goto retry_splicing;
+
+      }
+
+      len = split_at + target->len - split_donor;
+      afl->in_scratch_buf = afl_realloc(AFL_BUF_PARAM(in_scratch), len);
+      memcpy(afl->in_scratch_buf, in_buf, split_at);
+      memcpy(afl->in_scratch_buf + split_at, new_buf + split_donor,
+             target->len - split_donor);
+      in_buf = afl->in_scratch_buf;
+      afl_swap_bufs(AFL_BUF_PARAM(in), AFL_BUF_PARAM(in_scratch));
+
+      out_buf = afl_realloc(AFL_BUF_PARAM(out), len);
+      if (unlikely(!out_buf)) { PFATAL("alloc"); }
+      memcpy(out_buf, in_buf, len);
+
+      goto custom_mutator_stage;
+
+    }
+
     /* Pick a random queue entry and seek to it. Don't splice with yourself. */
 
     do {
@@ -3469,7 +3618,7 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
   u32 len, temp_len;
   u32 i;
   u32 j;
-  u8 *in_buf, *out_buf, *orig_in, *ex_tmp, *eff_map = 0;
+  u8 *in_buf, *out_buf, *orig_in, *ex_tmp, *tok_end, *eff_map = 0;
   u64 havoc_queued = 0, orig_hit_cnt, new_hit_cnt = 0, cur_ms_lv, prev_cksum,
       _prev_cksum;
   u32 splice_cycle = 0, perf_score = 100, orig_perf, eff_cnt = 1;
@@ -3713,6 +3862,8 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
 
   afl->stage_val_type = STAGE_VAL_NONE;
 
+  stage_time_mark(afl);
+
   orig_hit_cnt = afl->queued_items + afl->saved_crashes;
 
   /* Get a clean cksum. */
@@ -3827,6 +3978,7 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
 
   afl->stage_finds[STAGE_FLIP1] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP1] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP1);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -3861,6 +4013,7 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
 
   afl->stage_finds[STAGE_FLIP2] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP2] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP2);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -3899,6 +4052,7 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
 
   afl->stage_finds[STAGE_FLIP4] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP4] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP4);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4010,6 +4164,7 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
 
   afl->stage_finds[STAGE_FLIP8] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP8] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP8);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4055,6 +4210,7 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
 
   afl->stage_finds[STAGE_FLIP16] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP16] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP16);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4100,6 +4256,7 @@ static u8 mopt_common_fuzzing(afl_state_t *afl, MOpt_globals_t MOpt_globals) {
 
   afl->stage_finds[STAGE_FLIP32] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_FLIP32] += afl->stage_max;
+  stage_time_account(afl, STAGE_FLIP32);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4138,61 +4295,38 @@ skip_bitflip:
 
     afl->stage_cur_byte = i;
 
-    for (j = 1; j <= ARITH_MAX; ++j) {
+    /* Do arithmetic operations only if the result couldn't be a product
+       of a bitflip. */
 
-      u8 r = orig ^ (orig + j);
+    struct det_byte_cands *cands = get_det_byte_cands(orig);
+    afl->stage_max -= 2 * ARITH_MAX - cands->arith_cnt;
 
-      /* Do arithmetic operations only if the result couldn't be a product
-         of a bitflip. */
+    for (j = 0; j < cands->arith_cnt; ++j) {
 
-      if (!could_be_bitflip(r)) {
+      s32 delta = cands->arith[j];
 
-        afl->stage_cur_val = j;
-        out_buf[i] = orig + j;
+      afl->stage_cur_val = delta;
+      out_buf[i] = orig + delta;
 
 #ifdef INTROSPECTION
-        snprintf(afl->mutation, sizeof(afl->mutation), "%s MOPT_ARITH8+-%u-%u",
-                 afl->queue_cur->fname, i, j);
+      snprintf(afl->mutation, sizeof(afl->mutation), "%s MOPT_ARITH8%s-%u-%u",
+               afl->queue_cur->fname, delta > 0 ? "+" : "_", i,
+               delta > 0 ? delta : -delta);
 #endif
-        if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
-        ++afl->stage_cur;
-
-      } else {
-
-        --afl->stage_max;
-
-      }
-
-      r = orig ^ (orig - j);
-
-      if (!could_be_bitflip(r)) {
-
-        afl->stage_cur_val = -j;
-        out_buf[i] = orig - j;
-
-#ifdef INTROSPECTION
-        snprintf(afl->mutation, sizeof(afl->mutation), "%s MOPT_ARITH8_-%u-%u",
-                 afl->queue_cur->fname, i, j);
-#endif
-        if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
-        ++afl->stage_cur;
-
-      } else {
-
-        --afl->stage_max;
-
-      }
-
-      out_buf[i] = orig;
+      if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
+      ++afl->stage_cur;
 
     }
 
+    out_buf[i] = orig;
+
   }                                                   /* for i = 0; i < len */
 
   new_hit_cnt = afl->queued_items + afl->saved_crashes;
 
   afl->stage_finds[STAGE_ARITH8] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_ARITH8] += afl->stage_max;
+  stage_time_account(afl, STAGE_ARITH8);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4322,6 +4456,7 @@ skip_bitflip:
 
   afl->stage_finds[STAGE_ARITH16] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_ARITH16] += afl->stage_max;
+  stage_time_account(afl, STAGE_ARITH16);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4450,6 +4585,7 @@ skip_bitflip:
 
   afl->stage_finds[STAGE_ARITH32] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_ARITH32] += afl->stage_max;
+  stage_time_account(afl, STAGE_ARITH32);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4486,24 +4622,20 @@ skip_arith:
 
     afl->stage_cur_byte = i;
 
-    for (j = 0; j < sizeof(interesting_8); ++j) {
-
-      /* Skip if the value could be a product of bitflips or arithmetics. */
-
-      if (could_be_bitflip(orig ^ (u8)interesting_8[j]) ||
-          could_be_arith(orig, (u8)interesting_8[j], 1)) {
+    /* Skip values that could be a product of bitflips or arithmetics. */
 
-        --afl->stage_max;
-        continue;
+    struct det_byte_cands *cands = get_det_byte_cands(orig);
+    afl->stage_max -= sizeof(interesting_8) - cands->interest_cnt;
 
-      }
+    for (j = 0; j < cands->interest_cnt; ++j) {
 
-      afl->stage_cur_val = interesting_8[j];
-      out_buf[i] = interesting_8[j];
+      afl->stage_cur_val = interesting_8[cands->interest[j]];
+      out_buf[i] = interesting_8[cands->interest[j]];
 
 #ifdef INTROSPECTION
       snprintf(afl->mutation, sizeof(afl->mutation),
-               "%s MOPT_INTERESTING8-%u-%u", afl->queue_cur->fname, i, j);
+               "%s MOPT_INTERESTING8-%u-%u", afl->queue_cur->fname, i,
+               cands->interest[j]);
 #endif
       if (common_fuzz_stuff(afl, out_buf, len)) { goto abandon_entry; }
 
@@ -4518,6 +4650,7 @@ skip_arith:
 
   afl->stage_finds[STAGE_INTEREST8] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_INTEREST8] += afl->stage_max;
+  stage_time_account(afl, STAGE_INTEREST8);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4607,6 +4740,7 @@ skip_arith:
 
   afl->stage_finds[STAGE_INTEREST16] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_INTEREST16] += afl->stage_max;
+  stage_time_account(afl, STAGE_INTEREST16);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4697,6 +4831,7 @@ skip_arith:
 
   afl->stage_finds[STAGE_INTEREST32] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_INTEREST32] += afl->stage_max;
+  stage_time_account(afl, STAGE_INTEREST32);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4773,6 +4908,7 @@ skip_interest:
 
   afl->stage_finds[STAGE_EXTRAS_UO] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_UO] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_UO);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4789,13 +4925,23 @@ skip_interest:
   ex_tmp = afl_realloc(AFL_BUF_PARAM(ex), len + MAX_DICT_FILE);
   if (unlikely(!ex_tmp)) { PFATAL("alloc"); }
 
+  tok_end = afl_realloc(AFL_BUF_PARAM(tok_end), len + 1);
+  if (unlikely(!tok_end)) { PFATAL("alloc"); }
+  extras_index_ends(afl, out_buf, len, tok_end);
+
   for (i = 0; i <= (u32)len; ++i) {
 
     afl->stage_cur_byte = i;
 
     for (j = 0; j < afl->extras_cnt; ++j) {
 
-      if (len + afl->extras[j].len > MAX_FILE) {
+      u32 tok_len = afl->extras[j].len;
+
+      /* See above, the token may already be in front of us. */
+
+      if (len + tok_len > MAX_FILE ||
+          (tok_end[i] && i >= tok_len &&
+           !memcmp(out_buf + i - tok_len, afl->extras[j].data, tok_len))) {
 
         --afl->stage_max;
         continue;
@@ -4832,6 +4978,7 @@ skip_interest:
 
   afl->stage_finds[STAGE_EXTRAS_UI] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_UI] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_UI);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4894,6 +5041,7 @@ skip_user_extras:
 
   afl->stage_finds[STAGE_EXTRAS_AO] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_AO] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_AO);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -4910,13 +5058,23 @@ skip_user_extras:
   ex_tmp = afl_realloc(AFL_BUF_PARAM(ex), len + MAX_DICT_FILE);
   if (unlikely(!ex_tmp)) { PFATAL("alloc"); }
 
+  tok_end = afl_realloc(AFL_BUF_PARAM(tok_end), len + 1);
+  if (unlikely(!tok_end)) { PFATAL("alloc"); }
+  extras_index_ends(afl, out_buf, len, tok_end);
+
   for (i = 0; i <= (u32)len; ++i) {
 
     afl->stage_cur_byte = i;
 
     for (j = 0; j < afl->a_extras_cnt; ++j) {
 
-      if (len + afl->a_extras[j].len > MAX_FILE) {
+      u32 tok_len = afl->a_extras[j].len;
+
+      /* See above, the token may already be in front of us. */
+
+      if (len + tok_len > MAX_FILE ||
+          (tok_end[i] && i >= tok_len &&
+           !memcmp(out_buf + i - tok_len, afl->a_extras[j].data, tok_len))) {
 
         --afl->stage_max;
         continue;
@@ -4953,6 +5111,7 @@ skip_user_extras:
 
   afl->stage_finds[STAGE_EXTRAS_AI] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_EXTRAS_AI] += afl->stage_max;
+  stage_time_account(afl, STAGE_EXTRAS_AI);
 #ifdef INTROSPECTION
   afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -5051,6 +5210,8 @@ pacemaker_fuzzing:
 
       temp_len = len;
 
+      stage_time_mark(afl);
+
       orig_hit_cnt = afl->queued_items + afl->saved_crashes;
 
       havoc_queued = afl->queued_items;
@@ -5782,6 +5943,7 @@ pacemaker_fuzzing:
 
           afl->stage_finds[STAGE_HAVOC] += new_hit_cnt - orig_hit_cnt;
           afl->stage_cycles[STAGE_HAVOC] += afl->stage_max;
+          stage_time_account(afl, STAGE_HAVOC);
 #ifdef INTROSPECTION
           afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -5790,6 +5952,7 @@ pacemaker_fuzzing:
 
           afl->stage_finds[STAGE_SPLICE] += new_hit_cnt - orig_hit_cnt;
           afl->stage_cycles[STAGE_SPLICE] += afl->stage_max;
+          stage_time_account(afl, STAGE_SPLICE);
 #ifdef INTROSPECTION
           afl->queue_cur->stats_mutated += afl->stage_max;
 #endif
@@ -0,0 +1,350 @@
+/*
+   american fuzzy lop++ - helper forkservers
+   -----------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   Additional forkservers of the target, each with its own trace map and
+   input, that are driven from threads to run several inputs at once. The
+   dry run uses them for AFL_CAL_JOBS, redqueen for AFL_CMPLOG_JOBS.
+
+ */
+
+#include "afl-fuzz.h"
+#include <pthread.h>
+
+struct exec_pool {
+
+  afl_state_t        *afl;
+  struct fsrv_helper *helpers;
+  pthread_t          *threads;
+  struct exec_job    *jobs;             /* Current batch                    */
+  u32                 cnt;              /* Number of helpers                */
+  u32                 job_cnt;          /* Jobs in the current batch        */
+  u32                 pending;          /* Jobs not finished yet            */
+  u32                 batch;            /* Batch counter                    */
+  u8                  stop;
+  pthread_mutex_t     lock;
+  pthread_cond_t      cond;
+
+};
+
+struct exec_pool_arg {
+
+  struct exec_pool *pool;
+  u32               nr;
+
+};
+
+/* Returns 1 if helper forkservers can be used for this target. env is the
+   variable that asked for them, for the warning. */
+
+u8 fsrv_helpers_possible(afl_state_t *afl, u8 *env) {
+
+  if (afl->non_instrumented_mode || afl->no_forkserver ||
+      afl->fsrv.nyx_mode || afl->fsrv.vp_mode || afl->custom_mutators_count ||
+      afl->fsrv.persistent_record) {
+
+    WARNF("%s is not supported in this mode, ignoring it.", env);
+    return 0;
+
+  }
+
+  if (!afl->fsrv.fsrv_pid) { calibrate_fsrv_start(afl); }
+
+  /* The helpers need their own input, which is not possible if the target
+     reads it from a file given on the command line. */
+
+  if (!afl->fsrv.use_shmem_fuzz && !afl->fsrv.use_stdin) {
+
+    WARNF("%s needs a stdin or shared memory target, ignoring it.", env);
+    return 0;
+
+  }
+
+  return 1;
+
+}
+
+/* Give a helper its own trace map and input, then spin up its forkserver.
+   The variables of the main forkserver are restored by the caller. */
+
+static void fsrv_helper_init(afl_state_t *afl, struct fsrv_helper *h, u8 *tag,
+                             u32 nr) {
+
+  u8 *in_file = NULL;
+
+  if (!afl->fsrv.use_shmem_fuzz) {
+
+    in_file = alloc_printf("%s/.cur_input_%s%u", afl->out_dir, tag, nr);
+
+  }
+
+  afl_fsrv_start_helper(&h->fsrv, &afl->fsrv, &h->shm, &h->shm_fuzz, in_file,
+                        NULL, afl->argv, &afl->stop_soon,
+                        afl->afl_env.afl_debug_child);
+
+}
+
+static void fsrv_setenv(const char *name, u8 *val) {
+
+  if (val) {
+
+    setenv(name, val, 1);
+
+  } else {
+
+    unsetenv(name);
+
+  }
+
+}
+
+static u8 *fsrv_getenv(const char *name) {
+
+  return getenv(name) ? ck_strdup(getenv(name)) : NULL;
+
+}
+
+/* Spin up cnt helper forkservers. tag names their input files. */
+
+struct fsrv_helper *fsrv_helpers_start(afl_state_t *afl, u32 cnt, u8 *tag) {
+
+  struct fsrv_helper *helpers = ck_alloc(cnt * sizeof(struct fsrv_helper));
+  u8                 *shm_env = fsrv_getenv(SHM_ENV_VAR),
+     *shm_fuzz_env = fsrv_getenv(SHM_FUZZ_ENV_VAR);
+  u32 i;
+
+#if defined(HAVE_AFFINITY) && defined(__linux__)
+
+  /* The forkservers inherit our CPU binding, let them run anywhere. */
+
+  cpu_set_t old_set, all_set;
+  u8        rebind = afl->cpu_aff >= 0 &&
+              !sched_getaffinity(0, sizeof(cpu_set_t), &old_set);
+
+  if (rebind) {
+
+    CPU_ZERO(&all_set);
+    for (s32 c = 0; c < afl->cpu_core_count && c < CPU_SETSIZE; ++c) {
+
+      CPU_SET(c, &all_set);
+
+    }
+
+    sched_setaffinity(0, sizeof(cpu_set_t), &all_set);
+
+  }
+
+#endif
+
+  for (i = 0; i < cnt; ++i) {
+
+    fsrv_helper_init(afl, &helpers[i], tag, i);
+
+  }
+
+#if defined(HAVE_AFFINITY) && defined(__linux__)
+  if (rebind) { sched_setaffinity(0, sizeof(cpu_set_t), &old_set); }
+#endif
+
+  fsrv_setenv(SHM_ENV_VAR, shm_env);
+  fsrv_setenv(SHM_FUZZ_ENV_VAR, shm_fuzz_env);
+  ck_free(shm_env);
+  ck_free(shm_fuzz_env);
+
+  return helpers;
+
+}
+
+void fsrv_helpers_stop(struct fsrv_helper *helpers, u32 cnt) {
+
+  /* afl_shm_deinit() removes the variables from the environment. */
+
+  u8 *shm_env = fsrv_getenv(SHM_ENV_VAR),
+     *shm_fuzz_env = fsrv_getenv(SHM_FUZZ_ENV_VAR);
+
+  for (u32 i = 0; i < cnt; ++i) {
+
+    struct fsrv_helper *h = &helpers[i];
+
+    afl_fsrv_deinit(&h->fsrv);
+    afl_shm_deinit(&h->shm);
+
+    if (h->shm_fuzz.map) {
+
+      afl_shm_deinit(&h->shm_fuzz);
+
+    } else if (h->fsrv.out_file) {
+
+      close(h->fsrv.out_fd);
+      unlink(h->fsrv.out_file);
+      ck_free(h->fsrv.out_file);
+
+    }
+
+  }
+
+  fsrv_setenv(SHM_ENV_VAR, shm_env);
+  fsrv_setenv(SHM_FUZZ_ENV_VAR, shm_fuzz_env);
+  ck_free(shm_env);
+  ck_free(shm_fuzz_env);
+
+  ck_free(helpers);
+
+}
+
+/* Helper thread nr runs job nr of every batch that has that many jobs. */
+
+static void *exec_pool_thread(void *arg) {
+
+  struct exec_pool   *pool = ((struct exec_pool_arg *)arg)->pool;
+  u32                 nr = ((struct exec_pool_arg *)arg)->nr, batch = 0;
+  struct fsrv_helper *h = &pool->helpers[nr];
+  afl_state_t        *afl = pool->afl;
+
+  ck_free(arg);
+
+  pthread_mutex_lock(&pool->lock);
+
+  while (1) {
+
+    while (!pool->stop && (pool->batch == batch || nr >= pool->job_cnt)) {
+
+      batch = pool->batch;
+      pthread_cond_wait(&pool->cond, &pool->lock);
+
+    }
+
+    if (pool->stop) { break; }
+
+    struct exec_job *job = &pool->jobs[nr];
+    batch = pool->batch;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    u64 start_us = get_cur_time_us();
+
+    afl_fsrv_write_to_testcase(&h->fsrv, job->buf, job->len);
+    job->fault = afl_fsrv_run_target(&h->fsrv, afl->fsrv.exec_tmout,
+                                     &afl->stop_soon);
+    job->exec_us = get_cur_time_us() - start_us;
+    job->kill_signal = h->fsrv.last_kill_signal;
+    memcpy(job->trace, h->fsrv.trace_bits, afl->fsrv.map_size);
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (!--pool->pending) { pthread_cond_broadcast(&pool->cond); }
+
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+
+}
+
+/* Spin up cnt helpers with a thread each. Returns NULL if that is not
+   possible, env is the variable that asked for the pool. */
+
+struct exec_pool *exec_pool_start(afl_state_t *afl, u32 cnt, u8 *env,
+                                  u8 *tag) {
+
+  struct exec_pool *pool;
+
+  if (!fsrv_helpers_possible(afl, env)) { return NULL; }
+
+  pool = ck_alloc(sizeof(struct exec_pool));
+  pool->afl = afl;
+  pool->cnt = cnt;
+  pool->helpers = fsrv_helpers_start(afl, cnt, tag);
+  pool->threads = ck_alloc(cnt * sizeof(pthread_t));
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+
+  for (u32 i = 0; i < cnt; ++i) {
+
+    struct exec_pool_arg *arg = ck_alloc(sizeof(struct exec_pool_arg));
+    arg->pool = pool;
+    arg->nr = i;
+
+    if (pthread_create(&pool->threads[i], NULL, exec_pool_thread, arg)) {
+
+      PFATAL("pthread_create() failed");
+
+    }
+
+  }
+
+  return pool;
+
+}
+
+u32 exec_pool_size(struct exec_pool *pool) {
+
+  return pool ? pool->cnt : 0;
+
+}
+
+/* Run the jobs in parallel and wait until all of them are done. There may
+   be at most as many jobs as helpers, job->trace must hold map_size
+   bytes. */
+
+void exec_pool_run(struct exec_pool *pool, struct exec_job *jobs, u32 cnt) {
+
+  if (unlikely(cnt > pool->cnt)) { FATAL("BUG: too many jobs for the pool"); }
+
+  pthread_mutex_lock(&pool->lock);
+
+  pool->jobs = jobs;
+  pool->job_cnt = cnt;
+  pool->pending = cnt;
+  ++pool->batch;
+  pthread_cond_broadcast(&pool->cond);
+
+  while (pool->pending) {
+
+    pthread_cond_wait(&pool->cond, &pool->lock);
+
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+
+  pool->afl->fsrv.total_execs += cnt;
+
+}
+
+void exec_pool_stop(struct exec_pool *pool) {
+
+  if (!pool) { return; }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (u32 i = 0; i < pool->cnt; ++i) {
+
+    pthread_join(pool->threads[i], NULL);
+
+  }
+
+  fsrv_helpers_stop(pool->helpers, pool->cnt);
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->cond);
+
+  ck_free(pool->threads);
+  ck_free(pool);
+
+}
+
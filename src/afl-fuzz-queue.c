@@ -479,7 +479,7 @@ void mark_as_redundant(afl_state_t *afl, struct queue_entry *q, u8 state) {
 
     if (unlikely(q->trace_mini)) {
 
-      ck_free(q->trace_mini);
+      trace_mini_free(afl, q->trace_mini);
       q->trace_mini = NULL;
 
     }
@@ -806,7 +806,7 @@ void destroy_queue(afl_state_t *afl) {
 
     q = afl->queue_buf[i];
     ck_free(q->fname);
-    ck_free(q->trace_mini);
+    ck_free(q->cmplog_sig);
     if (q->skipdet_e) {
 
       if (q->skipdet_e->done_inf_map) ck_free(q->skipdet_e->done_inf_map);
@@ -820,6 +820,140 @@ void destroy_queue(afl_state_t *afl) {
 
   }
 
+  trace_mini_store_destroy(afl);
+
+}
+
+/* Add a new slab to the trace_mini store. The first call also sizes the
+   slots for the current map size and, if requested, creates the backing
+   file. */
+
+static void trace_mini_add_slab(afl_state_t *afl) {
+
+  struct trace_mini_store *tm = &afl->tm_store;
+  u8                      *slab;
+
+  if (unlikely(!tm->slot_size)) {
+
+    u64 page = (u64)sysconf(_SC_PAGESIZE);
+
+    tm->slot_size = ((afl->fsrv.map_size >> 3) + 7) & ~7U;
+    tm->slab_slots = TRACE_MINI_SLAB_SIZE / tm->slot_size;
+    if (!tm->slab_slots) { tm->slab_slots = 1; }
+    tm->slab_size = (u64)tm->slab_slots * tm->slot_size;
+    tm->slab_size = (tm->slab_size + page - 1) & ~(page - 1);
+    tm->slab_slots = tm->slab_size / tm->slot_size;
+
+    if (afl->afl_env.afl_trace_mini_file) {
+
+      u8 fn[PATH_MAX];
+      snprintf(fn, PATH_MAX, "%s/.trace_mini", afl->out_dir);
+      tm->fd = open(fn, O_RDWR | O_CREAT | O_TRUNC, DEFAULT_PERMISSION);
+      if (tm->fd < 0) { PFATAL("Unable to create '%s'", fn); }
+
+    }
+
+  }
+
+  if (tm->fd >= 0) {
+
+    off_t offset = (off_t)tm->slab_cnt * tm->slab_size;
+
+    if (ftruncate(tm->fd, offset + tm->slab_size)) {
+
+      PFATAL("ftruncate() of the trace_mini store failed");
+
+    }
+
+    slab = mmap(NULL, tm->slab_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                tm->fd, offset);
+
+  } else {
+
+    slab = mmap(NULL, tm->slab_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  }
+
+  if (unlikely(slab == MAP_FAILED)) { PFATAL("mmap() trace_mini slab"); }
+
+  tm->slabs = ck_realloc(tm->slabs, (tm->slab_cnt + 1) * sizeof(u8 *));
+  tm->slabs[tm->slab_cnt++] = slab;
+  tm->next_fresh = 0;
+
+}
+
+/* Hand out a zeroed trace_mini slot, ready for minimize_bits(). */
+
+u8 *trace_mini_alloc(afl_state_t *afl) {
+
+  struct trace_mini_store *tm = &afl->tm_store;
+  u8                      *mini;
+
+  if (tm->free_list) {
+
+    mini = tm->free_list;
+    tm->free_list = *(u8 **)mini;
+    memset(mini, 0, tm->slot_size);
+
+  } else {
+
+    if (unlikely(!tm->slab_cnt || tm->next_fresh >= tm->slab_slots)) {
+
+      trace_mini_add_slab(afl);
+
+    }
+
+    /* fresh slab memory is zero already */
+    mini = tm->slabs[tm->slab_cnt - 1] + (u64)tm->next_fresh * tm->slot_size;
+    ++tm->next_fresh;
+
+  }
+
+  if (++tm->used > tm->peak) { tm->peak = tm->used; }
+
+  return mini;
+
+}
+
+/* Return a trace_mini slot to the store. NULL is ignored. */
+
+void trace_mini_free(afl_state_t *afl, u8 *mini) {
+
+  if (!mini) { return; }
+
+  *(u8 **)mini = afl->tm_store.free_list;
+  afl->tm_store.free_list = mini;
+  --afl->tm_store.used;
+
+}
+
+/* Unmap all slabs and remove the backing file, if any. */
+
+void trace_mini_store_destroy(afl_state_t *afl) {
+
+  struct trace_mini_store *tm = &afl->tm_store;
+
+  for (u32 i = 0; i < tm->slab_cnt; ++i) {
+
+    munmap(tm->slabs[i], tm->slab_size);
+
+  }
+
+  ck_free(tm->slabs);
+
+  if (tm->fd >= 0) {
+
+    u8 fn[PATH_MAX];
+    snprintf(fn, PATH_MAX, "%s/.trace_mini", afl->out_dir);
+    close(tm->fd);
+    unlink(fn);
+
+  }
+
+  memset(tm, 0, sizeof(struct trace_mini_store));
+  tm->fd = -1;
+
 }
 
 /* When we bump into a new path, we call this to see if the path appears
@@ -910,7 +1044,7 @@ void update_bitmap_score(afl_state_t *afl, struct queue_entry *q) {
 
         if (!--afl->top_rated[i]->tc_ref) {
 
-          ck_free(afl->top_rated[i]->trace_mini);
+          trace_mini_free(afl, afl->top_rated[i]->trace_mini);
           afl->top_rated[i]->trace_mini = NULL;
 
         }
@@ -924,8 +1058,7 @@ void update_bitmap_score(afl_state_t *afl, struct queue_entry *q) {
 
       if (!q->trace_mini) {
 
-        u32 len = (afl->fsrv.map_size >> 3);
-        q->trace_mini = (u8 *)ck_alloc(len);
+        q->trace_mini = trace_mini_alloc(afl);
         minimize_bits(afl, q->trace_mini, afl->fsrv.trace_bits);
 
       }
@@ -975,17 +1108,17 @@ void cull_queue(afl_state_t *afl) {
     if (afl->top_rated[i] && (temp_v[i >> 3] & (1 << (i & 7))) &&
         afl->top_rated[i]->trace_mini) {
 
-      u32 j = len;
+      /* Remove all bits belonging to the current entry from temp_v.
+         trace_mini slots are 8 byte aligned and len is a multiple of 8
+         as the map size is always a multiple of 64. */
 
-      /* Remove all bits belonging to the current entry from temp_v. */
+      u64 *mini = (u64 *)afl->top_rated[i]->trace_mini;
+      u64 *tv = (u64 *)temp_v;
+      u32  j = len >> 3;
 
       while (j--) {
 
-        if (afl->top_rated[i]->trace_mini[j]) {
-
-          temp_v[j] &= ~afl->top_rated[i]->trace_mini[j];
-
-        }
+        if (mini[j]) { tv[j] &= ~mini[j]; }
 
       }
 
@@ -1390,11 +1523,19 @@ inline void queue_testcase_retake_mem(afl_state_t *afl, struct queue_entry *q,
 
 inline u8 *queue_testcase_get(afl_state_t *afl, struct queue_entry *q) {
 
-  if (likely(q->testcase_buf)) { return q->testcase_buf; }
+  if (likely(q->testcase_buf)) {
+
+    q->tc_clock_ref = 1;
+    ++afl->q_testcase_hits;
+    return q->testcase_buf;
+
+  }
 
   u32    len = q->len;
   double weight = q->weight;
 
+  ++afl->q_testcase_misses;
+
   // first handle if no testcase cache is configured, or if the
   // weighting of the testcase is below average.
 
@@ -1468,22 +1609,30 @@ inline u8 *queue_testcase_get(afl_state_t *afl, struct queue_entry *q) {
 
     }
 
-    /* Cache full. We neet to evict one or more to map one.
-       Get a random one which is not in use */
+    /* Cache full. We need to evict one or more to map one.
+       CLOCK: sweep over the slots and evict the first entry that was not
+       used since the hand last passed it, clearing reference bits on the
+       way. After one full sweep every ref bit is clear, so this ends. */
 
-    do {
+    struct queue_entry *old_cached;
 
-      // if the cache (MB) is not enough for the queue then this gets
-      // undesirable because q_testcase_max_cache_count grows sometimes
-      // although the number of items in the cache will not change hence
-      // more and more loops
-      tid = rand_below(afl, afl->q_testcase_max_cache_count);
+    while (1) {
 
-    } while (afl->q_testcase_cache[tid] == NULL ||
+      tid = afl->q_testcase_clock_hand;
+      if (unlikely(++afl->q_testcase_clock_hand >=
+                   afl->q_testcase_max_cache_count)) {
 
-             afl->q_testcase_cache[tid] == afl->queue_cur);
+        afl->q_testcase_clock_hand = 0;
+
+      }
+
+      old_cached = afl->q_testcase_cache[tid];
+      if (!old_cached || old_cached == afl->queue_cur) { continue; }
+      if (!old_cached->tc_clock_ref) { break; }
+      old_cached->tc_clock_ref = 0;
+
+    }
 
-    struct queue_entry *old_cached = afl->q_testcase_cache[tid];
     free(old_cached->testcase_buf);
     old_cached->testcase_buf = NULL;
     afl->q_testcase_cache_size -= old_cached->len;
@@ -1525,6 +1674,7 @@ inline u8 *queue_testcase_get(afl_state_t *afl, struct queue_entry *q) {
   close(fd);
 
   /* Register testcase as cached */
+  q->tc_clock_ref = 1;
   afl->q_testcase_cache[tid] = q;
   afl->q_testcase_cache_size += len;
   ++afl->q_testcase_cache_count;
@@ -1590,6 +1740,7 @@ inline void queue_testcase_store_mem(afl_state_t *afl, struct queue_entry *q,
   memcpy(q->testcase_buf, mem, len);
 
   /* Register testcase as cached */
+  q->tc_clock_ref = 1;
   afl->q_testcase_cache[tid] = q;
   afl->q_testcase_cache_size += len;
   ++afl->q_testcase_cache_count;
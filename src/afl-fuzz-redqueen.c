@@ -29,7 +29,7 @@
 #include "cmplog.h"
 
 // #define _DEBUG
-// #define USE_HASHMAP
+#define USE_HASHMAP
 // #define CMPLOG_INTROSPECTION
 
 // CMP attribute enum
@@ -177,6 +177,26 @@ static u8 get_exec_checksum(afl_state_t *afl, u8 *buf, u32 len, u64 *cksum) {
 
 }
 
+/* Helper forkservers for colorization, started on first use if
+   AFL_CMPLOG_JOBS is set. */
+
+static struct exec_pool *colorization_pool(afl_state_t *afl) {
+
+  if (likely(afl->cmplog_pool_tried)) { return afl->cmplog_pool; }
+
+  afl->cmplog_pool_tried = 1;
+  if (!afl->afl_env.afl_cmplog_jobs) { return NULL; }
+
+  u32 jobs = MIN((u32)atoi(afl->afl_env.afl_cmplog_jobs), CMPLOG_JOBS_MAX);
+  if (afl->cpu_core_count > 0) { jobs = MIN(jobs, (u32)afl->cpu_core_count); }
+  if (jobs < 2) { return NULL; }
+
+  ACTF("Spinning up %u forkservers for colorization...", jobs);
+  afl->cmplog_pool = exec_pool_start(afl, jobs, "AFL_CMPLOG_JOBS", "color");
+  return afl->cmplog_pool;
+
+}
+
 /* replace everything with different values */
 static void random_replace(afl_state_t *afl, u8 *buf, u32 len) {
 
@@ -292,13 +312,150 @@ static void type_replace(afl_state_t *afl, u8 *buf, u32 len) {
 
 }
 
+/* Account the result of trying changed bytes in range rng of buf. If they
+   changed the path, buf is restored and the range is split in two halves
+   to try later. Returns the new head of the range list. */
+
+static struct range *colorization_verdict(struct range *ranges,
+                                          struct range *rng, u8 *buf,
+                                          u8 *backup, u8 same_path) {
+
+  u32 s = 1 + rng->end - rng->start;
+
+  if (same_path) {
+
+    rng->ok = 1;
+    return ranges;
+
+  }
+
+  memcpy(buf + rng->start, backup + rng->start, s);
+
+  if (s > 1) {  // to not add 0 size ranges
+
+    ranges = add_range(ranges, rng->start, rng->start - 1 + s / 2);
+    ranges = add_range(ranges, rng->start + s / 2, rng->end);
+
+  }
+
+  if (ranges == rng) {
+
+    ranges = rng->next;
+    if (ranges) { ranges->prev = NULL; }
+
+  } else if (rng->next) {
+
+    rng->prev->next = rng->next;
+    rng->next->prev = rng->prev;
+
+  } else {
+
+    if (rng->prev) { rng->prev->next = NULL; }
+
+  }
+
+  free(rng);
+  return ranges;
+
+}
+
+/* Try the next ranges that a serial colorization would pick on the helper
+   forkservers at once. Each job gets the changes of all ranges before it,
+   as if those kept the path. The results are then accounted in order until
+   the first range that changes the path, as all later jobs ran on top of
+   it; their ranges are left for the next batch. Returns 1 to abort. */
+
+static u8 colorization_batch(afl_state_t *afl, struct exec_pool *pool,
+                             struct exec_job *jobs, struct range **ranges,
+                             struct range *rng, u8 *buf, u8 *backup,
+                             u8 *changed, u32 len, u64 exec_cksum) {
+
+  struct range *batch[CMPLOG_JOBS_MAX];
+  u32           cnt, i;
+
+  cnt = MIN(exec_pool_size(pool), (u32)(afl->stage_max - afl->stage_cur));
+
+  for (i = 0; i < cnt && rng; ++i) {
+
+    batch[i] = rng;
+    rng->ok = 1;
+    memcpy(jobs[i].buf, i ? jobs[i - 1].buf : buf, len);
+    memcpy(jobs[i].buf + rng->start, changed + rng->start,
+           1 + rng->end - rng->start);
+    jobs[i].len = len;
+    rng = pop_biggest_range(ranges);
+
+  }
+
+  cnt = i;
+  exec_pool_run(pool, jobs, cnt);
+
+  for (i = 0; i < cnt; ++i) {
+
+    u32 s = 1 + batch[i]->end - batch[i]->start;
+
+    memcpy(buf + batch[i]->start, changed + batch[i]->start, s);
+    memcpy(afl->fsrv.trace_bits, jobs[i].trace, afl->fsrv.map_size);
+    afl->fsrv.last_kill_signal = jobs[i].kill_signal;
+
+    if (unlikely(common_fuzz_result(afl, buf, len, jobs[i].fault))) {
+
+      return 1;
+
+    }
+
+    u64 cksum = hash64(afl->fsrv.trace_bits, afl->fsrv.map_size, HASH_CONST);
+    u8  same_path = cksum == exec_cksum &&
+                   (likely(jobs[i].exec_us <= 3 * afl->queue_cur->exec_us) ||
+                    unlikely(afl->fixed_seed));
+
+    *ranges = colorization_verdict(*ranges, batch[i], buf, backup, same_path);
+
+    if (unlikely(++afl->stage_cur % screen_update == 0)) { show_stats(afl); };
+
+    if (!same_path) {
+
+      for (u32 j = i + 1; j < cnt; ++j) {
+
+        batch[j]->ok = 0;
+
+      }
+
+      break;
+
+    }
+
+  }
+
+  return 0;
+
+}
+
+static void colorization_free_jobs(struct exec_pool *pool,
+                                   struct exec_job  *jobs) {
+
+  if (!jobs) { return; }
+
+  for (u32 j = 0; j < exec_pool_size(pool); ++j) {
+
+    ck_free(jobs[j].buf);
+    ck_free(jobs[j].trace);
+
+  }
+
+  ck_free(jobs);
+
+}
+
 static u8 colorization(afl_state_t *afl, u8 *buf, u32 len,
                        struct tainted **taints) {
 
-  struct range   *ranges = add_range(NULL, 0, len - 1), *rng;
-  struct tainted *taint = NULL;
-  u8             *backup = ck_alloc_nozero(len);
-  u8             *changed = ck_alloc_nozero(len);
+  struct range     *ranges = add_range(NULL, 0, len - 1), *rng;
+  struct tainted   *taint = NULL;
+  u8               *backup = ck_alloc_nozero(len);
+  u8               *changed = ck_alloc_nozero(len);
+  struct exec_pool *pool = NULL;
+  struct exec_job  *jobs = NULL;
 
 #if defined(_DEBUG) || defined(CMPLOG_INTROSPECTION)
   u64 start_time = get_cur_time();
@@ -332,62 +489,59 @@ static u8 colorization(afl_state_t *afl, u8 *buf, u32 len,
 
   }
 
-  while ((rng = pop_biggest_range(&ranges)) != NULL &&
-         afl->stage_cur < afl->stage_max) {
+  pool = colorization_pool(afl);
 
-    u32 s = 1 + rng->end - rng->start;
+  if (pool) {
 
-    memcpy(buf + rng->start, changed + rng->start, s);
+    jobs = ck_alloc(exec_pool_size(pool) * sizeof(struct exec_job));
 
-    u64 cksum = 0;
-    u64 start_us = get_cur_time_us();
-    if (unlikely(get_exec_checksum(afl, buf, len, &cksum))) {
+    for (u32 j = 0; j < exec_pool_size(pool); ++j) {
 
-      goto checksum_fail;
+      jobs[j].buf = ck_alloc_nozero(len);
+      jobs[j].trace = ck_alloc_nozero(afl->fsrv.map_size);
 
     }
 
-    u64 stop_us = get_cur_time_us();
+  }
 
-    /* Discard if the mutations change the path or if it is too decremental
-      in speed - how could the same path have a much different speed
-      though ...*/
-    if (cksum != exec_cksum ||
-        (unlikely(stop_us - start_us > 3 * afl->queue_cur->exec_us) &&
-         likely(!afl->fixed_seed))) {
+  while ((rng = pop_biggest_range(&ranges)) != NULL &&
+         afl->stage_cur < afl->stage_max) {
 
-      memcpy(buf + rng->start, backup + rng->start, s);
+    if (pool) {
 
-      if (s > 1) {  // to not add 0 size ranges
+      if (unlikely(colorization_batch(afl, pool, jobs, &ranges, rng, buf,
+                                      backup, changed, len, exec_cksum))) {
 
-        ranges = add_range(ranges, rng->start, rng->start - 1 + s / 2);
-        ranges = add_range(ranges, rng->start + s / 2, rng->end);
+        goto checksum_fail;
 
       }
 
-      if (ranges == rng) {
-
-        ranges = rng->next;
-        if (ranges) { ranges->prev = NULL; }
-
-      } else if (rng->next) {
+      continue;
 
-        rng->prev->next = rng->next;
-        rng->next->prev = rng->prev;
+    }
 
-      } else {
+    u32 s = 1 + rng->end - rng->start;
 
-        if (rng->prev) { rng->prev->next = NULL; }
+    memcpy(buf + rng->start, changed + rng->start, s);
 
-      }
+    u64 cksum = 0;
+    u64 start_us = get_cur_time_us();
+    if (unlikely(get_exec_checksum(afl, buf, len, &cksum))) {
 
-      free(rng);
+      goto checksum_fail;
 
-    } else {
+    }
 
-      rng->ok = 1;
+    u64 stop_us = get_cur_time_us();
 
-    }
+    /* Discard if the mutations change the path or if it is too decremental
+      in speed - how could the same path have a much different speed
+      though ...*/
+    ranges = colorization_verdict(
+        ranges, rng, buf, backup,
+        cksum == exec_cksum &&
+            (likely(stop_us - start_us <= 3 * afl->queue_cur->exec_us) ||
+             unlikely(afl->fixed_seed)));
 
     if (unlikely(++afl->stage_cur % screen_update == 0)) { show_stats(afl); };
 
@@ -527,6 +681,8 @@ static u8 colorization(afl_state_t *afl, u8 *buf, u32 len,
 
   afl->stage_finds[STAGE_COLORIZATION] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_COLORIZATION] += afl->stage_cur;
+  stage_time_account(afl, STAGE_COLORIZATION);
+  colorization_free_jobs(pool, jobs);
   ck_free(backup);
   ck_free(changed);
 
@@ -542,6 +698,7 @@ checksum_fail:
 
   }
 
+  colorization_free_jobs(pool, jobs);
   ck_free(backup);
   ck_free(changed);
 
@@ -2936,10 +3093,63 @@ static u8 rtn_fuzz(afl_state_t *afl, u32 key, u8 *orig_buf, u8 *buf, u8 *cbuf,
 ///// Input to State stage
 
 // afl->queue_cur->exec_cksum
+/* Hash of the operands that comparison k logged on the original input.
+   The key is kept in the upper 16 bits, so a list built in key order is
+   sorted. */
+
+static u64 cmplog_sig(struct cmp_map *map, u32 k) {
+
+  struct cmp_header *h = &map->headers[k];
+  u32                loggeds = MIN((u32)h->hits, h->type == CMP_TYPE_INS
+                                                     ? (u32)CMP_MAP_H
+                                                     : (u32)CMP_MAP_RTN_H);
+  u64                sig = hash64((u8 *)map->log[k],
+                                  loggeds * sizeof(struct cmp_operands),
+                                  HASH_CONST ^ *(u16 *)h);
+
+  return ((u64)k << 48) | (sig >> 16);
+
+}
+
+/* Remember the operands of all comparisons of the current entry, so its
+   children can tell which ones changed. */
+
+static void cmplog_sig_store(afl_state_t *afl) {
+
+  struct queue_entry *q = afl->queue_cur;
+  u32                 k, cnt = 0;
+
+  for (k = 0; k < CMP_MAP_W; ++k) {
+
+    if (afl->orig_cmp_map->headers[k].hits) { ++cnt; }
+
+  }
+
+  ck_free(q->cmplog_sig);
+  q->cmplog_sig = cnt ? ck_alloc_nozero(cnt * sizeof(u64)) : NULL;
+  q->cmplog_sig_cnt = cnt;
+
+  for (k = 0, cnt = 0; k < CMP_MAP_W; ++k) {
+
+    if (afl->orig_cmp_map->headers[k].hits) {
+
+      q->cmplog_sig[cnt++] = cmplog_sig(afl->orig_cmp_map, k);
+
+    }
+
+  }
+
+}
+
 u8 input_to_state_stage(afl_state_t *afl, u8 *orig_buf, u8 *buf, u32 len) {
 
   u64 cmplog_start_us = get_cur_time_us();
   u8  r = 1;
+
+  /* Colorization and the rest are timed as separate stages. */
+
+  stage_time_mark(afl);
+
   if (unlikely(!afl->pass_stats)) {
 
     afl->pass_stats = ck_alloc(sizeof(struct afl_pass_stat) * CMP_MAP_W);
@@ -3098,6 +3308,22 @@ u8 input_to_state_stage(afl_state_t *afl, u8 *orig_buf, u8 *buf, u32 len) {
   u8 *cbuf = NULL;
 #endif
 
+  /* Comparisons that logged the same operands when the entry this one is
+     based on went through redqueen were already solved there, unless we
+     are at the highest cmplog level. */
+
+  struct queue_entry *mother = afl->queue_cur->mother;
+  u64                *msig = NULL;
+  u32                 mcnt = 0, m = 0;
+
+  if (mother && mother != afl->queue_cur && mother->cmplog_sig &&
+      !(lvl & LVL3)) {
+
+    msig = mother->cmplog_sig;
+    mcnt = mother->cmplog_sig_cnt;
+
+  }
+
   u32 k;
   for (k = 0; k < CMP_MAP_W; ++k) {
 
@@ -3114,6 +3340,20 @@ u8 input_to_state_stage(afl_state_t *afl, u8 *orig_buf, u8 *buf, u32 len) {
 
     }
 
+    while (m < mcnt && (msig[m] >> 48) < k) {
+
+      ++m;
+
+    }
+
+    if (m < mcnt && afl->orig_cmp_map->headers[k].hits &&
+        msig[m] == cmplog_sig(afl->orig_cmp_map, k)) {
+
+      afl->shm.cmp_map->headers[k].hits = 0;  // unchanged since the mother
+      ++afl->cmplog_unchanged;
+
+    }
+
     if (afl->shm.cmp_map->headers[k].type == CMP_TYPE_INS) {
 
       // fprintf(stderr, "INS %u\n", k);
@@ -3160,6 +3400,10 @@ u8 input_to_state_stage(afl_state_t *afl, u8 *orig_buf, u8 *buf, u32 len) {
 
   }
 
+  /* Only a pass that tried every comparison may tell the children what is
+     solved already. */
+
+  cmplog_sig_store(afl);
   r = 0;
 
 exit_its:
@@ -3256,6 +3500,7 @@ exit_its:
   new_hit_cnt = afl->queued_items + afl->saved_crashes;
   afl->stage_finds[STAGE_ITS] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_ITS] += afl->fsrv.total_execs - orig_execs;
+  stage_time_account(afl, STAGE_ITS);
 
 #if defined(_DEBUG) || defined(CMPLOG_INTROSPECTION)
   FILE *f = stderr;
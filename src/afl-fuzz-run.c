@@ -31,6 +31,9 @@
 #if !defined NAME_MAX
   #define NAME_MAX _XOPEN_NAME_MAX
 #endif
+#ifdef __linux__
+  #include <sys/inotify.h>
+#endif
 
 #include "cmplog.h"
 
@@ -427,6 +430,77 @@ static void write_with_gap(afl_state_t *afl, u8 *mem, u32 len, u32 skip_at,
 
 }
 
+/* Spin up the forkserver for calibration and drop the shared memory
+   testcase if the target does not support it. */
+
+void calibrate_fsrv_start(afl_state_t *afl) {
+
+  if (afl->fsrv.cmplog_binary &&
+      afl->fsrv.init_child_func != cmplog_exec_child) {
+
+    FATAL("BUG in afl-fuzz detected. Cmplog mode not set correctly.");
+
+  }
+
+  afl_fsrv_start(&afl->fsrv, afl->argv, &afl->stop_soon,
+                 afl->afl_env.afl_debug_child);
+
+  if (afl->fsrv.support_shmem_fuzz && !afl->fsrv.use_shmem_fuzz) {
+
+    afl_shm_deinit(afl->shm_fuzz);
+    ck_free(afl->shm_fuzz);
+    afl->shm_fuzz = NULL;
+    afl->fsrv.support_shmem_fuzz = 0;
+    afl->fsrv.shmem_fuzz = NULL;
+
+  }
+
+}
+
+/* Remember that edge idx is variable, once the edge list exists. */
+
+static void cal_var_edge_add(afl_state_t *afl, u32 idx) {
+
+  if (!afl->var_edges_built) { return; }
+
+  afl->var_edges = afl_realloc((void **)&afl->var_edges,
+                               (afl->var_edges_cnt + 1) * sizeof(u32));
+  if (unlikely(!afl->var_edges)) { PFATAL("alloc"); }
+  afl->var_edges[afl->var_edges_cnt++] = idx;
+
+}
+
+/* Returns 1 if the trace hits an edge that was seen to be variable. The
+   edges are kept as a list of map indices, usually much shorter than the
+   map, which is set up from var_bytes on first use. */
+
+static u8 cal_hits_var_edge(afl_state_t *afl) {
+
+  u32 i;
+
+  if (unlikely(!afl->var_edges_built)) {
+
+    afl->var_edges_built = 1;
+    afl->var_edges_cnt = 0;
+
+    for (i = 0; i < afl->fsrv.map_size; ++i) {
+
+      if (afl->var_bytes[i]) { cal_var_edge_add(afl, i); }
+
+    }
+
+  }
+
+  for (i = 0; i < afl->var_edges_cnt; ++i) {
+
+    if (afl->fsrv.trace_bits[afl->var_edges[i]]) { return 1; }
+
+  }
+
+  return 0;
+
+}
+
 /* Calibrate a new test case. This is done when processing the input directory
    to warn about flaky or otherwise problematic test cases early on; and when
    new paths are discovered to detect variable behavior and so on. */
@@ -436,7 +510,7 @@ u8 calibrate_case(afl_state_t *afl, struct queue_entry *q, u8 *use_mem,
 
   u8 fault = 0, new_bits = 0, var_detected = 0, hnb = 0,
      first_run = (q->exec_cksum == 0);
-  u64 start_us, stop_us, diff_us;
+  u64 start_us, stop_us, diff_us, run_us, min_us = UINT64_MAX, max_us = 0;
   s32 old_sc = afl->stage_cur, old_sm = afl->stage_max;
   u32 use_tmout = afl->fsrv.exec_tmout;
   u8 *old_sn = afl->stage_name;
@@ -463,29 +537,7 @@ u8 calibrate_case(afl_state_t *afl, struct queue_entry *q, u8 *use_mem,
   /* Make sure the forkserver is up before we do anything, and let's not
      count its spin-up time toward binary calibration. */
 
-  if (!afl->fsrv.fsrv_pid) {
-
-    if (afl->fsrv.cmplog_binary &&
-        afl->fsrv.init_child_func != cmplog_exec_child) {
-
-      FATAL("BUG in afl-fuzz detected. Cmplog mode not set correctly.");
-
-    }
-
-    afl_fsrv_start(&afl->fsrv, afl->argv, &afl->stop_soon,
-                   afl->afl_env.afl_debug_child);
-
-    if (afl->fsrv.support_shmem_fuzz && !afl->fsrv.use_shmem_fuzz) {
-
-      afl_shm_deinit(afl->shm_fuzz);
-      ck_free(afl->shm_fuzz);
-      afl->shm_fuzz = NULL;
-      afl->fsrv.support_shmem_fuzz = 0;
-      afl->fsrv.shmem_fuzz = NULL;
-
-    }
-
-  }
+  if (!afl->fsrv.fsrv_pid) { calibrate_fsrv_start(afl); }
 
   u8 saved_afl_post_process_keep_original =
       afl->afl_env.afl_post_process_keep_original;
@@ -497,6 +549,7 @@ u8 calibrate_case(afl_state_t *afl, struct queue_entry *q, u8 *use_mem,
     (void)write_to_testcase(afl, (void **)&use_mem, q->len, 1);
 
     fault = fuzz_run_target(afl, &afl->fsrv, use_tmout);
+    ++afl->calibration_execs;
 
     /* afl->stop_soon is set by the handler for Ctrl+C. When it's pressed,
        we want to bail out quickly. */
@@ -539,7 +592,10 @@ u8 calibrate_case(afl_state_t *afl, struct queue_entry *q, u8 *use_mem,
 
     (void)write_to_testcase(afl, (void **)&use_mem, q->len, 1);
 
+    run_us = get_cur_time_us();
     fault = fuzz_run_target(afl, &afl->fsrv, use_tmout);
+    run_us = get_cur_time_us() - run_us;
+    ++afl->calibration_execs;
 
     // update the time spend in calibration after each execution, as those may
     // be slow
@@ -579,6 +635,7 @@ u8 calibrate_case(afl_state_t *afl, struct queue_entry *q, u8 *use_mem,
               unlikely(afl->first_trace[i] != afl->fsrv.trace_bits[i])) {
 
             afl->var_bytes[i] = 1;
+            cal_var_edge_add(afl, i);
             // ignore the variable edge by setting it to fully discovered
             afl->virgin_bits[i] = 0;
 
@@ -614,6 +671,25 @@ u8 calibrate_case(afl_state_t *afl, struct queue_entry *q, u8 *use_mem,
 
     }
 
+    /* With AFL_CAL_ADAPTIVE an entry whose runs agree in trace and time is
+       done after CAL_CYCLES_MIN runs, only a divergence asks for the full
+       (or the long) cycle count. */
+
+    min_us = MIN(min_us, run_us);
+    max_us = MAX(max_us, run_us);
+
+    if (afl->afl_env.afl_cal_adaptive && !var_detected &&
+        afl->stage_cur + 1 >= (s32)CAL_CYCLES_MIN &&
+        afl->stage_cur + 1 < afl->stage_max && q->exec_cksum == cksum &&
+        (afl->fixed_seed ||
+         max_us <= min_us * CAL_STABLE_PERC / 100 + CAL_STABLE_SLACK_US) &&
+        !cal_hits_var_edge(afl)) {
+
+      afl->stage_max = afl->stage_cur + 1;
+      break;
+
+    }
+
   }
 
   if (unlikely(afl->fixed_seed)) {
@@ -703,6 +779,342 @@ abort_calibration:
 
 /* Grab interesting test cases from other fuzzers. */
 
+/* Import the new entries of a peer that writes a queue.pack. Returns 0 if
+   the peer has no pack, so the caller falls back to scanning its queue/. */
+
+static u8 sync_fuzzer_pack(afl_state_t *afl, u8 *peer, u32 sync_cnt) {
+
+  struct afl_pack_record rec;
+  u8                     path[PATH_MAX], synced_path[PATH_MAX];
+  s32                    fd, idx_fd, id_fd;
+  u32                    next = 0, cnt;
+
+  snprintf(path, PATH_MAX, "%s/%s/queue.pack", afl->sync_dir, peer);
+  if (afl_pack_open_ro(path, &fd, &idx_fd)) { return 0; }
+
+  snprintf(synced_path, PATH_MAX, "%s/.synced/%s.pack", afl->out_dir, peer);
+  id_fd = open(synced_path, O_RDWR | O_CREAT, DEFAULT_PERMISSION);
+  if (id_fd < 0) { PFATAL("Unable to create '%s'", synced_path); }
+
+  if (read(id_fd, &next, sizeof(u32)) != sizeof(u32)) { next = 0; }
+
+  /* a peer that started a new session has a shorter pack */
+  cnt = afl_pack_count(idx_fd);
+  if (next > cnt) { next = 0; }
+
+  snprintf(afl->stage_name_buf, STAGE_BUF_SIZE, "sync %u", sync_cnt);
+  afl->stage_name = afl->stage_name_buf;
+  afl->stage_cur = 0;
+  afl->stage_max = 0;
+
+  show_stats(afl);
+
+  while (next < cnt) {
+
+    u8 *mem = afl_pack_read(fd, idx_fd, next++, &rec), *buf = mem;
+
+    if (!mem) { continue; }
+
+    afl->syncing_case = rec.id;
+
+    if (rec.len && !sync_bus_known(afl, peer, rec.id, mem, rec.len)) {
+
+      u32 new_len = write_to_testcase(afl, (void **)&buf, rec.len, 1);
+      u8  fault = fuzz_run_target(afl, &afl->fsrv, afl->fsrv.exec_tmout);
+
+      if (afl->stop_soon) {
+
+        ck_free(mem);
+        goto close_pack;
+
+      }
+
+      afl->syncing_party = peer;
+      afl->queued_imported += save_if_interesting(afl, buf, new_len, fault);
+      show_stats(afl);
+      afl->syncing_party = 0;
+
+    }
+
+    ck_free(mem);
+
+  }
+
+  lseek(id_fd, 0, SEEK_SET);
+  ck_write(id_fd, &next, sizeof(u32), synced_path);
+
+close_pack:
+  close(id_fd);
+  close(idx_fd);
+  close(fd);
+  return 1;
+
+}
+
+/* Run one file of a peer and keep it if it is interesting. Returns 1 if
+   we are told to stop. */
+
+static u8 sync_one_file(afl_state_t *afl, u8 *peer, u8 *path) {
+
+  s32         fd;
+  struct stat st;
+
+  /* Allow this to fail in case the other fuzzer is resuming or so... */
+
+  fd = open(path, O_RDONLY);
+
+  if (fd < 0) { return 0; }
+
+  if (fstat(fd, &st)) { WARNF("fstat() failed"); }
+
+  /* Ignore zero-sized or oversized files. */
+
+  if (st.st_size && st.st_size <= MAX_FILE) {
+
+    u8  fault;
+    u8 *mem = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (mem == MAP_FAILED) { PFATAL("Unable to mmap '%s'", path); }
+
+    /* The sync bus may tell us already that this brings nothing new. */
+
+    if (sync_bus_known(afl, peer, afl->syncing_case, mem, st.st_size)) {
+
+      munmap(mem, st.st_size);
+      close(fd);
+      return 0;
+
+    }
+
+    /* See what happens. We rely on save_if_interesting() to catch major
+       errors and save the test case. */
+
+    u32 new_len = write_to_testcase(afl, (void **)&mem, st.st_size, 1);
+
+    fault = fuzz_run_target(afl, &afl->fsrv, afl->fsrv.exec_tmout);
+
+    if (afl->stop_soon) {
+
+      munmap(mem, st.st_size);
+      close(fd);
+      return 1;
+
+    }
+
+    afl->syncing_party = peer;
+    afl->queued_imported += save_if_interesting(afl, mem, new_len, fault);
+    show_stats(afl);
+    afl->syncing_party = 0;
+
+    munmap(mem, st.st_size);
+
+  }
+
+  close(fd);
+  return 0;
+
+}
+
+#ifdef __linux__
+
+/* Return the inotify watch of a peer, setting one up if it does not exist
+   yet. A fresh watch asks for a full scan, as we do not know what was
+   added to the queue before it was set up. */
+
+static struct sync_watch *sync_watch_get(afl_state_t *afl, u8 *peer,
+                                         u8 *qd_path) {
+
+  struct sync_watch *w = NULL;
+
+  for (u32 i = 0; i < afl->sync_watch_cnt; ++i) {
+
+    if (!strcmp(afl->sync_watches[i].peer, peer)) {
+
+      w = &afl->sync_watches[i];
+      break;
+
+    }
+
+  }
+
+  if (!w) {
+
+    afl->sync_watches =
+        ck_realloc(afl->sync_watches,
+                   (afl->sync_watch_cnt + 1) * sizeof(struct sync_watch));
+    w = &afl->sync_watches[afl->sync_watch_cnt++];
+    memset(w, 0, sizeof(struct sync_watch));
+    w->peer = ck_strdup(peer);
+    w->wd = -1;
+
+  }
+
+  /* Inputs that a peer hard links into its queue (pivot_inputs()) only
+     raise IN_CREATE. A written file raises it as well, its name is then
+     seen twice but only synced once. */
+
+  if (w->wd < 0) {
+
+    w->wd = inotify_add_watch(afl->sync_inotify_fd, qd_path,
+                              IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO |
+                                  IN_ONLYDIR);
+    w->rescan = 1;
+
+  }
+
+  return w;
+
+}
+
+/* Forget the file names collected for a peer. */
+
+static void sync_watch_clear(struct sync_watch *w) {
+
+  for (u32 i = 0; i < w->name_cnt; ++i) {
+
+    ck_free(w->names[i]);
+
+  }
+
+  w->name_cnt = 0;
+
+}
+
+/* Read all pending inotify events without blocking and remember the new
+   queue entries per peer. */
+
+static void sync_watch_drain(afl_state_t *afl) {
+
+  u8 buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t len;
+
+  while ((len = read(afl->sync_inotify_fd, buf, sizeof(buf))) > 0) {
+
+    struct inotify_event *ev;
+
+    for (u8 *p = buf; p < buf + len;
+         p += sizeof(struct inotify_event) + ev->len) {
+
+      struct sync_watch *w = NULL;
+
+      ev = (struct inotify_event *)p;
+
+      if (unlikely(ev->mask & IN_Q_OVERFLOW)) {
+
+        for (u32 i = 0; i < afl->sync_watch_cnt; ++i) {
+
+          sync_watch_clear(&afl->sync_watches[i]);
+          afl->sync_watches[i].rescan = 1;
+
+        }
+
+        continue;
+
+      }
+
+      for (u32 i = 0; i < afl->sync_watch_cnt; ++i) {
+
+        if (afl->sync_watches[i].wd == ev->wd) {
+
+          w = &afl->sync_watches[i];
+          break;
+
+        }
+
+      }
+
+      if (!w) { continue; }
+
+      /* The queue directory is gone, e.g. the peer was restarted. */
+
+      if (unlikely(ev->mask & IN_IGNORED)) {
+
+        sync_watch_clear(w);
+        w->wd = -1;
+        w->rescan = 1;
+        continue;
+
+      }
+
+      if (!ev->len || strncmp(ev->name, "id:", 3) || w->rescan) { continue; }
+
+      if (w->name_cnt == w->name_max) {
+
+        w->name_max = w->name_max ? w->name_max * 2 : 64;
+        w->names = ck_realloc(w->names, w->name_max * sizeof(u8 *));
+
+      }
+
+      w->names[w->name_cnt++] = ck_strdup(ev->name);
+
+    }
+
+  }
+
+}
+
+/* Order the id: names by their number, ids can have more than six digits. */
+
+static int sync_name_cmp(const void *a, const void *b) {
+
+  const char *name_a = *(char *const *)a, *name_b = *(char *const *)b;
+  unsigned long id_a = strtoul(name_a + 3, NULL, 10),
+                id_b = strtoul(name_b + 3, NULL, 10);
+
+  if (id_a != id_b) { return id_a < id_b ? -1 : 1; }
+  return strcmp(name_a, name_b);
+
+}
+
+/* Run the files of a peer that inotify told us about. */
+
+static void sync_fuzzer_events(afl_state_t *afl, struct sync_watch *w,
+                               u8 *qd_path, u32 sync_cnt) {
+
+  u8  synced_path[PATH_MAX], path[PATH_MAX + 1 + NAME_MAX];
+  u32 min_accept = 0;
+  s32 id_fd;
+
+  snprintf(synced_path, PATH_MAX, "%s/.synced/%s", afl->out_dir, w->peer);
+  id_fd = open(synced_path, O_RDWR | O_CREAT, DEFAULT_PERMISSION);
+  if (id_fd < 0) { PFATAL("Unable to create '%s'", synced_path); }
+
+  if (read(id_fd, &min_accept, sizeof(u32)) != sizeof(u32)) { min_accept = 0; }
+
+  snprintf(afl->stage_name_buf, STAGE_BUF_SIZE, "sync %u", sync_cnt);
+  afl->stage_name = afl->stage_name_buf;
+  afl->stage_cur = 0;
+  afl->stage_max = 0;
+
+  show_stats(afl);
+
+  qsort(w->names, w->name_cnt, sizeof(u8 *), sync_name_cmp);
+
+  for (u32 i = 0; i < w->name_cnt; ++i) {
+
+    u32 id = strtoul(w->names[i] + 3, NULL, 10);
+
+    if (id < min_accept) { continue; }
+
+    snprintf(path, sizeof(path), "%s/%s", qd_path, w->names[i]);
+    afl->syncing_case = id;
+    min_accept = id + 1;
+
+    if (sync_one_file(afl, w->peer, path)) { goto close_sync; }
+
+  }
+
+  lseek(id_fd, 0, SEEK_SET);
+  ck_write(id_fd, &min_accept, sizeof(u32), synced_path);
+
+close_sync:
+  close(id_fd);
+  sync_watch_clear(w);
+
+}
+
+#endif
+
 void sync_fuzzers(afl_state_t *afl) {
 
   if (unlikely(afl->afl_env.afl_no_sync)) { return; }
@@ -719,6 +1131,31 @@ void sync_fuzzers(afl_state_t *afl) {
   afl->cur_depth = 0;
 
   u64 sync_start_us = get_cur_time_us();
+
+  sync_bus_read(afl);
+
+#ifdef __linux__
+  if (unlikely(afl->afl_env.afl_sync_inotify)) {
+
+    if (afl->sync_inotify_fd < 0) {
+
+      afl->sync_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+      if (afl->sync_inotify_fd < 0) {
+
+        WARNF("inotify_init1() failed, AFL_SYNC_INOTIFY is disabled");
+        afl->afl_env.afl_sync_inotify = 0;
+
+      }
+
+    }
+
+    if (afl->sync_inotify_fd >= 0) { sync_watch_drain(afl); }
+
+  }
+
+#endif
+
   /* Look at the entries created for every other fuzzer in the sync directory.
    */
 
@@ -775,10 +1212,47 @@ void sync_fuzzers(afl_state_t *afl) {
         open(qd_synced_path, O_RDWR | O_CREAT | O_TRUNC, DEFAULT_PERMISSION);
     if (id_fd >= 0) close(id_fd);
 
+    /* Peers with a packed corpus are read from their queue.pack. */
+
+    if (unlikely(afl->afl_env.afl_pack_corpus) &&
+        sync_fuzzer_pack(afl, sd_ent->d_name, ++sync_cnt)) {
+
+      if (afl->stop_soon) { break; }
+      continue;
+
+    }
+
     /* Skip anything that doesn't have a queue/ subdirectory. */
 
     sprintf(qd_path, "%s/%s/queue", afl->sync_dir, sd_ent->d_name);
 
+#ifdef __linux__
+    if (unlikely(afl->sync_inotify_fd >= 0)) {
+
+      struct sync_watch *w = sync_watch_get(afl, sd_ent->d_name, qd_path);
+
+      if (!w->rescan) {
+
+        if (w->name_cnt) {
+
+          sync_fuzzer_events(afl, w, qd_path, ++sync_cnt);
+          if (afl->stop_soon) { break; }
+
+        }
+
+        continue;
+
+      }
+
+      /* The full scan below picks up everything reported so far. */
+
+      sync_watch_clear(w);
+      if (w->wd >= 0) { w->rescan = 0; }
+
+    }
+
+#endif
+
     struct dirent **namelist = NULL;
     int             m = 0, n, o;
 
@@ -840,49 +1314,11 @@ void sync_fuzzers(afl_state_t *afl) {
 
     for (o = m; o < n; o++) {
 
-      s32         fd;
-      struct stat st;
-
       snprintf(path, sizeof(path), "%s/%s", qd_path, namelist[o]->d_name);
       afl->syncing_case = next_min_accept;
       next_min_accept++;
 
-      /* Allow this to fail in case the other fuzzer is resuming or so... */
-
-      fd = open(path, O_RDONLY);
-
-      if (fd < 0) { continue; }
-
-      if (fstat(fd, &st)) { WARNF("fstat() failed"); }
-
-      /* Ignore zero-sized or oversized files. */
-
-      if (st.st_size && st.st_size <= MAX_FILE) {
-
-        u8  fault;
-        u8 *mem = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-
-        if (mem == MAP_FAILED) { PFATAL("Unable to mmap '%s'", path); }
-
-        /* See what happens. We rely on save_if_interesting() to catch major
-           errors and save the test case. */
-
-        u32 new_len = write_to_testcase(afl, (void **)&mem, st.st_size, 1);
-
-        fault = fuzz_run_target(afl, &afl->fsrv, afl->fsrv.exec_tmout);
-
-        if (afl->stop_soon) { goto close_sync; }
-
-        afl->syncing_party = sd_ent->d_name;
-        afl->queued_imported += save_if_interesting(afl, mem, new_len, fault);
-        show_stats(afl);
-        afl->syncing_party = 0;
-
-        munmap(mem, st.st_size);
-
-      }
-
-      close(fd);
+      if (sync_one_file(afl, sd_ent->d_name, path)) { goto close_sync; }
 
     }
 
@@ -925,15 +1361,72 @@ void sync_fuzzers(afl_state_t *afl) {
 
 }
 
+/* Helper forkservers for trimming, started on first use if AFL_TRIM_JOBS
+   is set. */
+
+static struct exec_pool *trim_pool(afl_state_t *afl) {
+
+  if (likely(afl->trim_pool_tried)) { return afl->trim_pool; }
+
+  afl->trim_pool_tried = 1;
+  if (!afl->afl_env.afl_trim_jobs) { return NULL; }
+
+  u32 jobs = MIN((u32)atoi(afl->afl_env.afl_trim_jobs), TRIM_JOBS_MAX);
+  if (afl->cpu_core_count > 0) { jobs = MIN(jobs, (u32)afl->cpu_core_count); }
+  if (jobs < 2) { return NULL; }
+
+  ACTF("Spinning up %u forkservers for trimming...", jobs);
+  afl->trim_pool = exec_pool_start(afl, jobs, "AFL_TRIM_JOBS", "trim");
+  return afl->trim_pool;
+
+}
+
+/* Run the next removals of remove_len bytes from remove_pos on the helper
+   forkservers at once, each one as if the removals in front of it did not
+   keep the path. Returns the number of jobs that ran. */
+
+static u32 trim_batch(struct exec_pool *pool, struct exec_job *jobs,
+                      u8 *in_buf, u32 len, u32 remove_pos, u32 remove_len) {
+
+  u32 cnt;
+
+  for (cnt = 0; cnt < exec_pool_size(pool) && remove_pos < len; ++cnt) {
+
+    u32 trim_avail = MIN(remove_len, len - remove_pos);
+
+    memcpy(jobs[cnt].buf, in_buf, remove_pos);
+    memcpy(jobs[cnt].buf + remove_pos, in_buf + remove_pos + trim_avail,
+           len - remove_pos - trim_avail);
+    jobs[cnt].len = len - trim_avail;
+
+    remove_pos += remove_len;
+
+  }
+
+  exec_pool_run(pool, jobs, cnt);
+
+  return cnt;
+
+}
+
 /* Trim all new test cases to save cycles when doing deterministic checks. The
    trimmer uses power-of-two increments somewhere between 1/16 and 1/1024 of
-   file size, to keep the stage short and sweet. */
+   file size, to keep the stage short and sweet. With AFL_TRIM_JOBS the
+   removals of a step are run in batches on helper forkservers. The results
+   are taken in order up to the first one that keeps the path, so the
+   outcome is the same as with one forkserver. Step sizes that did not
+   shorten any entry in TRIM_STEP_TRIES tries are only tried on every
+   TRIM_STEP_PROBE-th entry. */
 
 u8 trim_case(afl_state_t *afl, struct queue_entry *q, u8 *in_buf) {
 
   u8  needs_write = 0, fault = 0;
   u32 orig_len = q->len;
   u64 trim_start_us = get_cur_time_us();
+
+  struct exec_pool *pool = NULL;
+  struct exec_job  *jobs = NULL;
+
   /* Custom mutator trimmer */
   if (afl->custom_mutators_count) {
 
@@ -992,12 +1485,38 @@ u8 trim_case(afl_state_t *afl, struct queue_entry *q, u8 *in_buf) {
 
   remove_len = MAX(len_p2 / TRIM_START_STEPS, (u32)TRIM_MIN_BYTES);
 
+  pool = trim_pool(afl);
+
+  if (pool) {
+
+    jobs = ck_alloc(exec_pool_size(pool) * sizeof(struct exec_job));
+
+    for (u32 j = 0; j < exec_pool_size(pool); ++j) {
+
+      jobs[j].buf = ck_alloc_nozero(q->len);
+      jobs[j].trace = ck_alloc_nozero(afl->fsrv.map_size);
+
+    }
+
+  }
+
   /* Continue until the number of steps gets too high or the stepover
      gets too small. */
 
   while (remove_len >= MAX(len_p2 / TRIM_END_STEPS, (u32)TRIM_MIN_BYTES)) {
 
     u32 remove_pos = remove_len;
+    u32 step = __builtin_ctz(remove_len);
+
+    if (unlikely(afl->trim_step_tries[step] >= TRIM_STEP_TRIES &&
+                 !afl->trim_step_hits[step]) &&
+        ++afl->trim_step_skips[step] % TRIM_STEP_PROBE) {
+
+      ++afl->trim_steps_skipped;
+      remove_len >>= 1;
+      continue;
+
+    }
 
     sprintf(afl->stage_name_buf, "trim %s/%s",
             u_stringify_int(val_bufs[0], remove_len),
@@ -1008,58 +1527,92 @@ u8 trim_case(afl_state_t *afl, struct queue_entry *q, u8 *in_buf) {
 
     while (remove_pos < q->len) {
 
-      u32 trim_avail = MIN(remove_len, q->len - remove_pos);
-      u64 cksum;
+      u32 batch = 1, i;
+
+      if (pool) {
+
+        batch =
+            trim_batch(pool, jobs, in_buf, q->len, remove_pos, remove_len);
+
+      } else {
+
+        write_with_gap(afl, in_buf, q->len, remove_pos,
+                       MIN(remove_len, q->len - remove_pos));
 
-      write_with_gap(afl, in_buf, q->len, remove_pos, trim_avail);
+        fault = fuzz_run_target(afl, &afl->fsrv, afl->fsrv.exec_tmout);
 
-      fault = fuzz_run_target(afl, &afl->fsrv, afl->fsrv.exec_tmout);
+      }
 
       update_trim_time(afl, &trim_start_us);
 
-      if (afl->stop_soon || fault == FSRV_RUN_ERROR) { goto abort_trimming; }
+      for (i = 0; i < batch; ++i) {
+
+        u32 trim_avail = MIN(remove_len, q->len - remove_pos);
+        u64 cksum;
+
+        if (pool) {
+
+          fault = jobs[i].fault;
+          memcpy(afl->fsrv.trace_bits, jobs[i].trace, afl->fsrv.map_size);
+
+        }
+
+        if (afl->stop_soon || fault == FSRV_RUN_ERROR) {
+
+          goto abort_trimming;
+
+        }
+
+        /* Note that we don't keep track of crashes or hangs here; maybe
+           TODO? */
+
+        ++afl->trim_execs;
+        ++afl->trim_step_tries[step];
+        classify_counts(&afl->fsrv);
+        cksum = hash64(afl->fsrv.trace_bits, afl->fsrv.map_size, HASH_CONST);
 
-      /* Note that we don't keep track of crashes or hangs here; maybe TODO?
-       */
+        /* If the deletion had no impact on the trace, make it permanent. This
+           isn't perfect for variable-path inputs, but we're just making a
+           best-effort pass, so it's not a big deal if we end up with false
+           negatives every now and then. */
 
-      ++afl->trim_execs;
-      classify_counts(&afl->fsrv);
-      cksum = hash64(afl->fsrv.trace_bits, afl->fsrv.map_size, HASH_CONST);
+        if (cksum == q->exec_cksum) {
 
-      /* If the deletion had no impact on the trace, make it permanent. This
-         isn't perfect for variable-path inputs, but we're just making a
-         best-effort pass, so it's not a big deal if we end up with false
-         negatives every now and then. */
+          u32 move_tail = q->len - remove_pos - trim_avail;
 
-      if (cksum == q->exec_cksum) {
+          ++afl->trim_step_hits[step];
 
-        u32 move_tail = q->len - remove_pos - trim_avail;
+          q->len -= trim_avail;
+          len_p2 = next_pow2(q->len);
 
-        q->len -= trim_avail;
-        len_p2 = next_pow2(q->len);
+          memmove(in_buf + remove_pos, in_buf + remove_pos + trim_avail,
+                  move_tail);
 
-        memmove(in_buf + remove_pos, in_buf + remove_pos + trim_avail,
-                move_tail);
+          /* Let's save a clean trace, which will be needed by
+             update_bitmap_score once we're done with the trimming stuff. */
+          if (!needs_write) {
 
-        /* Let's save a clean trace, which will be needed by
-           update_bitmap_score once we're done with the trimming stuff. */
-        if (!needs_write) {
+            needs_write = 1;
+            memcpy(afl->clean_trace, afl->fsrv.trace_bits,
+                   afl->fsrv.map_size);
 
-          needs_write = 1;
-          memcpy(afl->clean_trace, afl->fsrv.trace_bits, afl->fsrv.map_size);
+          }
+
+        } else {
+
+          remove_pos += remove_len;
 
         }
 
-      } else {
+        /* Since this can be slow, update the screen every now and then. */
+        if (!(trim_exec++ % afl->stats_update_freq)) { show_stats(afl); }
+        ++afl->stage_cur;
 
-        remove_pos += remove_len;
+        /* The later jobs of the batch ran without this removal. */
+        if (cksum == q->exec_cksum) { break; }
 
       }
 
-      /* Since this can be slow, update the screen every now and then. */
-      if (!(trim_exec++ % afl->stats_update_freq)) { show_stats(afl); }
-      ++afl->stage_cur;
-
     }
 
     remove_len >>= 1;
@@ -1170,6 +1723,19 @@ u8 trim_case(afl_state_t *afl, struct queue_entry *q, u8 *in_buf) {
   }
 
 abort_trimming:
+  if (jobs) {
+
+    for (u32 j = 0; j < exec_pool_size(pool); ++j) {
+
+      ck_free(jobs[j].buf);
+      ck_free(jobs[j].trace);
+
+    }
+
+    ck_free(jobs);
+
+  }
+
   afl->bytes_trim_out += q->len;
   update_trim_time(afl, &trim_start_us);
 
@@ -1194,6 +1760,16 @@ u8 __attribute__((hot)) common_fuzz_stuff(afl_state_t *afl, u8 *out_buf,
 
   fault = fuzz_run_target(afl, &afl->fsrv, afl->fsrv.exec_tmout);
 
+  return common_fuzz_result(afl, out_buf, len, fault);
+
+}
+
+/* Process the result of running out_buf, which left its trace in
+   trace_bits. The second half of common_fuzz_stuff(), for callers that
+   ran the target themselves. */
+
+u8 common_fuzz_result(afl_state_t *afl, u8 *out_buf, u32 len, u8 fault) {
+
   if (afl->stop_soon) { return 1; }
 
   if (fault == FSRV_RUN_TMOUT) {
@@ -1,6 +1,162 @@
 
 
 #include "afl-fuzz.h"
+#include <dirent.h>
+
+/* The result of a finished inference is saved as
+   queue/.state/skipdet/<hash of the input>: this header, followed by
+   skip_eff_map as a bitmap. As the name only depends on the content it
+   survives the renames of a resume, and instances syncing the entry can
+   pick it up from the peer they got it from. */
+
+#define SKIPDET_MAGIC 0x53444554                /* "SDET"                   */
+
+struct skipdet_file {
+
+  u32 magic;
+  u32 len;                              /* Input length                     */
+  u64 hash;                             /* hash64() of the input            */
+  u32 undet_bits, quick_eff_bytes;
+
+};
+
+/* Open the saved result with the given name, our own or that of a peer.
+   Sets *from_peer if it is not ours. Returns -1 if there is none. */
+
+static s32 skipdet_open(afl_state_t *afl, u8 *name, u8 *from_peer) {
+
+  u8             fn[PATH_MAX];
+  s32            fd;
+  DIR           *sd;
+  struct dirent *sd_ent;
+
+  *from_peer = 0;
+
+  snprintf(fn, PATH_MAX, "%s/queue/.state/skipdet/%s", afl->out_dir, name);
+  fd = open(fn, O_RDONLY);
+
+  if (fd >= 0 || !afl->sync_id || afl->afl_env.afl_no_sync) { return fd; }
+
+  sd = opendir(afl->sync_dir);
+  if (!sd) { return -1; }
+
+  while ((sd_ent = readdir(sd))) {
+
+    if (sd_ent->d_name[0] == '.' || !strcmp(afl->sync_id, sd_ent->d_name)) {
+
+      continue;
+
+    }
+
+    snprintf(fn, PATH_MAX, "%s/%s/queue/.state/skipdet/%s", afl->sync_dir,
+             sd_ent->d_name, name);
+    fd = open(fn, O_RDONLY);
+
+    if (fd >= 0) {
+
+      *from_peer = 1;
+      break;
+
+    }
+
+  }
+
+  closedir(sd);
+  return fd;
+
+}
+
+static void skipdet_save(afl_state_t *afl, struct queue_entry *q, u64 hash) {
+
+  struct skipdet_file hdr = {0};
+  u8                  fn[PATH_MAX], tmp[PATH_MAX];
+  u8                 *bits = ck_alloc((q->len + 7) >> 3);
+  s32                 fd;
+
+  hdr.magic = SKIPDET_MAGIC;
+  hdr.len = q->len;
+  hdr.hash = hash;
+  hdr.undet_bits = q->skipdet_e->undet_bits;
+  hdr.quick_eff_bytes = q->skipdet_e->quick_eff_bytes;
+
+  for (u32 i = 0; i < q->len; ++i) {
+
+    if (q->skipdet_e->skip_eff_map[i]) { bits[i >> 3] |= 1 << (i & 7); }
+
+  }
+
+  /* Peers may read it any time, so it has to appear complete. */
+
+  snprintf(fn, PATH_MAX, "%s/queue/.state/skipdet/%016llx", afl->out_dir,
+           hash);
+  snprintf(tmp, PATH_MAX, "%s.tmp", fn);
+
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_PERMISSION);
+  if (fd < 0) { PFATAL("Unable to create '%s'", tmp); }
+
+  ck_write(fd, &hdr, sizeof(hdr), tmp);
+  ck_write(fd, bits, (q->len + 7) >> 3, tmp);
+  close(fd);
+
+  if (rename(tmp, fn)) { PFATAL("Unable to rename '%s'", tmp); }
+
+  ck_free(bits);
+
+}
+
+/* Take over a finished inference of this input from an earlier session or
+   a peer. Returns 1 on success. */
+
+static u8 skipdet_load(afl_state_t *afl, struct queue_entry *q, u64 hash) {
+
+  struct skipdet_file hdr;
+  u8                  name[32], from_peer, *bits;
+  u32                 bits_len = (q->len + 7) >> 3;
+  s32                 fd;
+
+  snprintf(name, sizeof(name), "%016llx", hash);
+  fd = skipdet_open(afl, name, &from_peer);
+  if (fd < 0) { return 0; }
+
+  bits = ck_alloc(bits_len);
+
+  if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+      hdr.magic != SKIPDET_MAGIC || hdr.len != q->len || hdr.hash != hash ||
+      read(fd, bits, bits_len) != (ssize_t)bits_len) {
+
+    close(fd);
+    ck_free(bits);
+    return 0;
+
+  }
+
+  close(fd);
+
+  if (!q->skipdet_e->skip_eff_map) {
+
+    q->skipdet_e->skip_eff_map = ck_alloc(q->len);
+
+  }
+
+  for (u32 i = 0; i < q->len; ++i) {
+
+    q->skipdet_e->skip_eff_map[i] = (bits[i >> 3] >> (i & 7)) & 1;
+
+  }
+
+  ck_free(bits);
+
+  q->skipdet_e->undet_bits = hdr.undet_bits;
+  q->skipdet_e->quick_eff_bytes = hdr.quick_eff_bytes;
+  q->skipdet_e->continue_inf = 0;
+  q->skipdet_e->done_eff = 1;
+
+  if (from_peer) { skipdet_save(afl, q, hash); }
+
+  ++afl->skipdet_g->inf_prof->inf_reused;
+  return 1;
+
+}
 
 void flip_range(u8 *input, u32 pos, u32 size) {
 
@@ -110,6 +266,15 @@ u8 skip_deterministic_stage(afl_state_t *afl, u8 *orig_buf, u8 *out_buf,
 
   if (!should_det_fuzz(afl, afl->queue_cur)) return 1;
 
+  u64 input_hash = hash64(orig_buf, len, HASH_CONST);
+
+  if (len == afl->queue_cur->len &&
+      skipdet_load(afl, afl->queue_cur, input_hash)) {
+
+    return 1;
+
+  }
+
   /* Add check to make sure that for seeds without too much undet bits,
      we ignore them */
 
@@ -120,6 +285,7 @@ u8 skip_deterministic_stage(afl_state_t *afl, u8 *orig_buf, u8 *out_buf,
   afl->stage_short = "inf";
   afl->stage_name = "inference";
   afl->stage_cur = 0;
+  stage_time_mark(afl);
   orig_hit_cnt = afl->queued_items + afl->saved_crashes;
 
   static u8 *inf_eff_map;
@@ -215,6 +381,7 @@ u8 skip_deterministic_stage(afl_state_t *afl, u8 *orig_buf, u8 *out_buf,
 
   afl->stage_finds[STAGE_INF] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_INF] += afl->stage_cur;
+  stage_time_account(afl, STAGE_INF);
 
   /****************************
    * Quick Skip Effective Map *
@@ -353,6 +520,7 @@ u8 skip_deterministic_stage(afl_state_t *afl, u8 *orig_buf, u8 *out_buf,
 
   afl->stage_finds[STAGE_QUICK] += new_hit_cnt - orig_hit_cnt;
   afl->stage_cycles[STAGE_QUICK] += (afl->fsrv.total_execs - before_eff_execs);
+  stage_time_account(afl, STAGE_QUICK);
 
 cleanup_skipdet:
 
@@ -392,6 +560,12 @@ cleanup_skipdet:
     afl->queue_cur->skipdet_e->continue_inf = 0;
     afl->queue_cur->skipdet_e->done_eff = 1;
 
+    if (len == afl->queue_cur->len) {
+
+      skipdet_save(afl, afl->queue_cur, input_hash);
+
+    }
+
   } else {
 
     afl->queue_cur->skipdet_e->continue_inf = 1;
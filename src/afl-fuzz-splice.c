@@ -0,0 +1,266 @@
+/*
+   american fuzzy lop++ - splice index
+   -----------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   Content defined anchors for splicing. A gear hash is rolled over every
+   queue entry that reaches the splice stage, and the positions where its
+   low SPLICE_ANCHOR_BITS bits are zero become anchors, keyed by the hash
+   value. As the hash only depends on the last 64 bytes, two inputs that
+   share some content get anchors with the same key at the end of it, no
+   matter where it is. Each entry keeps its SPLICE_ANCHORS strongest
+   anchors (most trailing zero bits) in one table for all entries.
+
+   splice_index_pick() takes a random anchor of the current entry and
+   looks up another entry with the same key, which is a donor that can be
+   spliced in right behind the shared content. This needs no donor to be
+   loaded and no scan for differences.
+
+ */
+
+#include "afl-fuzz.h"
+
+#define SPLICE_INDEX_INITIAL_BITS 12
+#define SPLICE_INDEX_MAX_PROBE 64               /* Matches looked at        */
+
+struct splice_slot {
+
+  u64 key;                              /* Gear hash, 0 if the slot is free */
+  u32 id;                               /* Queue entry                      */
+  u32 pos;                              /* Offset behind the anchor         */
+
+};
+
+struct splice_index {
+
+  struct splice_slot *slots;
+  u32                 bits, cnt;
+  u64                 gear[256];        /* Random value per byte            */
+
+  struct splice_slot cur[SPLICE_ANCHORS];  /* Anchors of the current entry */
+  u32                cur_cnt, cur_id;
+
+};
+
+static inline u32 splice_strength(u64 key) {
+
+  return __builtin_ctzll(key);
+
+}
+
+static inline u32 splice_slot_of(u64 key, u32 bits) {
+
+  return (key * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+
+}
+
+static void splice_index_alloc(struct splice_index *si, u32 bits) {
+
+  si->slots = ck_alloc(sizeof(struct splice_slot) << bits);
+  si->bits = bits;
+
+}
+
+static void splice_index_put(struct splice_index *si, struct splice_slot *s) {
+
+  u32 mask = (1U << si->bits) - 1, pos = splice_slot_of(s->key, si->bits);
+
+  while (si->slots[pos].key) {
+
+    pos = (pos + 1) & mask;
+
+  }
+
+  si->slots[pos] = *s;
+
+}
+
+static void splice_index_grow(struct splice_index *si) {
+
+  struct splice_slot *old = si->slots;
+  u32                 old_size = 1U << si->bits;
+
+  splice_index_alloc(si, si->bits + 1);
+
+  for (u32 i = 0; i < old_size; ++i) {
+
+    if (old[i].key) { splice_index_put(si, &old[i]); }
+
+  }
+
+  ck_free(old);
+
+}
+
+static struct splice_index *splice_index_get(afl_state_t *afl) {
+
+  struct splice_index *si = afl->splice_index;
+
+  if (likely(si)) { return si; }
+
+  si = ck_alloc(sizeof(struct splice_index));
+  splice_index_alloc(si, SPLICE_INDEX_INITIAL_BITS);
+
+  /* splitmix64, so the anchors are the same in every instance. */
+
+  u64 x = HASH_CONST;
+  for (u32 i = 0; i < 256; ++i) {
+
+    u64 z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    si->gear[i] = z ^ (z >> 31);
+
+  }
+
+  si->cur_id = UINT32_MAX;
+  afl->splice_index = si;
+  return si;
+
+}
+
+/* Find the strongest anchors of buf and leave them in si->cur. */
+
+static void splice_anchors(struct splice_index *si, u8 *buf, u32 len) {
+
+  u64 h = 0, mask = (1ULL << SPLICE_ANCHOR_BITS) - 1;
+  u32 weak = 0, i;
+
+  si->cur_cnt = 0;
+
+  /* Anchors at the very end would leave nothing to splice in. */
+
+  for (i = 0; i + 1 < len; ++i) {
+
+    h = (h << 1) + si->gear[buf[i]];
+
+    if (likely(h & mask) || i < SPLICE_ANCHOR_MIN) { continue; }
+
+    u64 key = h ? h : 1;
+
+    if (si->cur_cnt < SPLICE_ANCHORS) {
+
+      si->cur[si->cur_cnt].key = key;
+      si->cur[si->cur_cnt++].pos = i + 1;
+
+    } else if (splice_strength(key) > splice_strength(si->cur[weak].key)) {
+
+      si->cur[weak].key = key;
+      si->cur[weak].pos = i + 1;
+
+    } else {
+
+      continue;
+
+    }
+
+    /* Remember the weakest one, it is replaced next. */
+
+    for (u32 j = 0; j < si->cur_cnt; ++j) {
+
+      if (splice_strength(si->cur[j].key) <
+          splice_strength(si->cur[weak].key)) {
+
+        weak = j;
+
+      }
+
+    }
+
+  }
+
+}
+
+/* Index the current queue entry q with its content buf, if that was not
+   done yet. Must be called after trimming, the anchors are offsets. */
+
+void splice_index_add(afl_state_t *afl, struct queue_entry *q, u8 *buf,
+                      u32 len) {
+
+  struct splice_index *si = splice_index_get(afl);
+
+  if (si->cur_id != q->id) {
+
+    splice_anchors(si, buf, len);
+    si->cur_id = q->id;
+
+  }
+
+  if (q->splice_indexed) { return; }
+  q->splice_indexed = 1;
+
+  for (u32 i = 0; i < si->cur_cnt; ++i) {
+
+    si->cur[i].id = q->id;
+
+    if (unlikely(++si->cnt > (1U << si->bits) / 2)) { splice_index_grow(si); }
+    splice_index_put(si, &si->cur[i]);
+
+  }
+
+}
+
+/* Pick a donor for the current entry q (see splice_index_add()) that
+   shares the content in front of a random anchor. Returns 1 and sets the
+   donor and the split offsets in q and the donor on success. */
+
+u8 splice_index_pick(afl_state_t *afl, struct queue_entry *q, u32 *tid,
+                     u32 *split_cur, u32 *split_donor) {
+
+  struct splice_index *si = afl->splice_index;
+  struct splice_slot  *a, *found = NULL;
+  u32                  mask, pos, seen = 0, probe = 0;
+
+  if (!si || si->cur_id != q->id || !si->cur_cnt) { return 0; }
+
+  a = &si->cur[rand_below(afl, si->cur_cnt)];
+  mask = (1U << si->bits) - 1;
+  pos = splice_slot_of(a->key, si->bits);
+
+  /* Reservoir sampling over the matching entries, a probe run of common
+     content is only looked at in part. */
+
+  while (si->slots[pos].key && probe++ < SPLICE_INDEX_MAX_PROBE * 4) {
+
+    struct splice_slot *s = &si->slots[pos];
+    pos = (pos + 1) & mask;
+
+    if (s->key != a->key || s->id == q->id) { continue; }
+
+    struct queue_entry *d = afl->queue_buf[s->id];
+    if (d->disabled || s->pos >= d->len) { continue; }
+
+    if (!rand_below(afl, ++seen)) { found = s; }
+    if (seen >= SPLICE_INDEX_MAX_PROBE) { break; }
+
+  }
+
+  if (!found) { return 0; }
+
+  *tid = found->id;
+  *split_cur = a->pos;
+  *split_donor = found->pos;
+  return 1;
+
+}
+
+void splice_index_destroy(afl_state_t *afl) {
+
+  if (!afl->splice_index) { return; }
+
+  ck_free(afl->splice_index->slots);
+  ck_free(afl->splice_index);
+  afl->splice_index = NULL;
+
+}
+
@@ -98,6 +98,8 @@ void afl_state_init(afl_state_t *afl, uint32_t map_size) {
   afl->stats_update_freq = 1;
   afl->stats_file_update_freq_msecs = STATS_UPDATE_SEC * 1000;
   afl->stats_avg_exec = 0;
+  afl->tsc_start = get_cur_tsc();
+  afl->tsc_start_us = get_cur_time_us();
   afl->skip_deterministic = 0;
   afl->sync_time = SYNC_TIME;
   afl->cmplog_lvl = 2;
@@ -132,6 +134,13 @@ void afl_state_init(afl_state_t *afl, uint32_t map_size) {
   afl->fsrv.dev_null_fd = -1;
   afl->fsrv.child_pid = -1;
   afl->fsrv.out_dir_fd = -1;
+  afl->tm_store.fd = -1;
+  afl->sync_inotify_fd = -1;
+  for (u32 i = 0; i < AFL_PACK_KINDS; ++i) {
+
+    afl->pack_fd[i] = afl->pack_idx_fd[i] = -1;
+
+  }
 
   /* Init SkipDet */
   afl->skipdet_g =
@@ -234,6 +243,13 @@ void read_afl_environment(afl_state_t *afl, char **envp) {
 
             // we should mark this obsolete in a few versions
 
+          } else if (!strncmp(env, "AFL_HAVOC_BANDIT",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_havoc_bandit =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
           } else if (!strncmp(env, "AFL_HANG_TMOUT",
 
                               afl_environment_variable_len)) {
@@ -290,6 +306,34 @@ void read_afl_environment(afl_state_t *afl, char **envp) {
             afl->afl_env.afl_no_fastresume =
                 get_afl_env(afl_environment_variables[i]) ? 1 : 0;
 
+          } else if (!strncmp(env, "AFL_PACK_CORPUS",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_pack_corpus =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
+          } else if (!strncmp(env, "AFL_SYNC_BUS",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_sync_bus =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
+          } else if (!strncmp(env, "AFL_SYNC_INOTIFY",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_sync_inotify =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
+          } else if (!strncmp(env, "AFL_TRACE_MINI_FILE",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_trace_mini_file =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
           } else if (!strncmp(env, "AFL_CUSTOM_MUTATOR_ONLY",
 
                               afl_environment_variable_len)) {
@@ -311,6 +355,20 @@ void read_afl_environment(afl_state_t *afl, char **envp) {
             afl->afl_env.afl_cmplog_only_new =
                 get_afl_env(afl_environment_variables[i]) ? 1 : 0;
 
+          } else if (!strncmp(env, "AFL_CMPLOG_JOBS",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_cmplog_jobs =
+                (u8 *)get_afl_env(afl_environment_variables[i]);
+
+          } else if (!strncmp(env, "AFL_TRIM_JOBS",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_trim_jobs =
+                (u8 *)get_afl_env(afl_environment_variables[i]);
+
           } else if (!strncmp(env, "AFL_DISABLE_REDUNDANT",
 
                               afl_environment_variable_len) ||
@@ -328,6 +386,13 @@ void read_afl_environment(afl_state_t *afl, char **envp) {
             afl->afl_env.afl_no_startup_calibration =
                 get_afl_env(afl_environment_variables[i]) ? 1 : 0;
 
+          } else if (!strncmp(env, "AFL_NO_STATS_TEXT",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_no_stats_text =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
           } else if (!strncmp(env, "AFL_NO_UI", afl_environment_variable_len)) {
 
             afl->afl_env.afl_no_ui =
@@ -433,6 +498,20 @@ void read_afl_environment(afl_state_t *afl, char **envp) {
             afl->afl_env.afl_cal_fast =
                 get_afl_env(afl_environment_variables[i]) ? 1 : 0;
 
+          } else if (!strncmp(env, "AFL_CAL_ADAPTIVE",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_cal_adaptive =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
+          } else if (!strncmp(env, "AFL_CAL_JOBS",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_cal_jobs =
+                (u8 *)get_afl_env(afl_environment_variables[i]);
+
           } else if (!strncmp(env, "AFL_FAST_CAL",
 
                               afl_environment_variable_len)) {
@@ -440,6 +519,27 @@ void read_afl_environment(afl_state_t *afl, char **envp) {
             afl->afl_env.afl_cal_fast =
                 get_afl_env(afl_environment_variables[i]) ? 1 : 0;
 
+          } else if (!strncmp(env, "AFL_METRICS",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_metrics =
+                get_afl_env(afl_environment_variables[i]) ? 1 : 0;
+
+          } else if (!strncmp(env, "AFL_METRICS_HOST",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_metrics_host =
+                (u8 *)get_afl_env(afl_environment_variables[i]);
+
+          } else if (!strncmp(env, "AFL_METRICS_PORT",
+
+                              afl_environment_variable_len)) {
+
+            afl->afl_env.afl_metrics_port =
+                (u8 *)get_afl_env(afl_environment_variables[i]);
+
           } else if (!strncmp(env, "AFL_STATSD",
 
                               afl_environment_variable_len)) {
@@ -743,6 +843,7 @@ void afl_state_deinit(afl_state_t *afl) {
   afl_free(afl->out_buf);
   afl_free(afl->out_scratch_buf);
   afl_free(afl->eff_buf);
+  afl_free(afl->tok_end_buf);
   afl_free(afl->in_buf);
   afl_free(afl->in_scratch_buf);
   afl_free(afl->ex_buf);
@@ -751,12 +852,36 @@ void afl_state_deinit(afl_state_t *afl) {
   ck_free(afl->virgin_tmout);
   ck_free(afl->virgin_crash);
   ck_free(afl->var_bytes);
+  afl_free(afl->var_edges);
   ck_free(afl->top_rated);
   ck_free(afl->clean_trace);
   ck_free(afl->clean_trace_custom);
   ck_free(afl->first_trace);
   ck_free(afl->map_tmp_buf);
 
+  for (u32 i = 0; i < afl->sync_watch_cnt; ++i) {
+
+    for (u32 j = 0; j < afl->sync_watches[i].name_cnt; ++j) {
+
+      ck_free(afl->sync_watches[i].names[j]);
+
+    }
+
+    ck_free(afl->sync_watches[i].names);
+    ck_free(afl->sync_watches[i].peer);
+
+  }
+
+  ck_free(afl->sync_watches);
+  sync_bus_destroy(afl);
+  metrics_destroy(afl);
+  stats_page_destroy(afl);
+  exec_pool_stop(afl->cmplog_pool);
+  exec_pool_stop(afl->trim_pool);
+  ck_free(afl->havoc_bandit);
+  splice_index_destroy(afl);
+  if (afl->sync_inotify_fd >= 0) { close(afl->sync_inotify_fd); }
+
   list_remove(&afl_states, afl);
 
 }
@@ -25,6 +25,7 @@
  */
 
 #include "afl-fuzz.h"
+#include "afl-stats-page.h"
 #include "envs.h"
 #include <limits.h>
 
@@ -302,6 +303,253 @@ void load_stats_file(afl_state_t *afl) {
 
 }
 
+/* Update the exec speed of the last minute if it is due. */
+
+static void update_last_min_execs(afl_state_t *afl, u64 cur_time) {
+
+  if ((unlikely(!afl->last_avg_exec_update ||
+                cur_time - afl->last_avg_exec_update >= 60000))) {
+
+    afl->last_avg_execs_saved =
+        (double)(1000 * (afl->fsrv.total_execs - afl->last_avg_total_execs)) /
+        (double)(cur_time - afl->last_avg_exec_update);
+    afl->last_avg_total_execs = afl->fsrv.total_execs;
+    afl->last_avg_exec_update = cur_time;
+
+  }
+
+}
+
+/* Create and map the binary stats page out_dir/fuzzer_stats.bin. */
+
+void stats_page_init(afl_state_t *afl) {
+
+  u8                 fn[PATH_MAX];
+  s32                fd;
+  struct stats_page *p;
+
+  snprintf(fn, PATH_MAX, "%s/" STATS_PAGE_FILE, afl->out_dir);
+
+  /* Readers may still have the page of an earlier session mapped, so it is
+     replaced instead of reused. */
+
+  if (unlink(fn) && errno != ENOENT) { PFATAL("Unable to delete '%s'", fn); }
+
+  fd = open(fn, O_RDWR | O_CREAT | O_EXCL, DEFAULT_PERMISSION);
+  if (fd < 0) { PFATAL("Unable to create '%s'", fn); }
+
+  if (ftruncate(fd, sizeof(struct stats_page))) {
+
+    PFATAL("Unable to resize '%s'", fn);
+
+  }
+
+  p = mmap(NULL, sizeof(struct stats_page), PROT_READ | PROT_WRITE, MAP_SHARED,
+           fd, 0);
+  if (p == MAP_FAILED) { PFATAL("Unable to mmap '%s'", fn); }
+  close(fd);
+
+  p->version = STATS_PAGE_VERSION;
+  p->size = sizeof(struct stats_page);
+  p->samples = STATS_PAGE_SAMPLES;
+  p->data.fuzzer_pid = (u32)getpid();
+  if (afl->use_banner) {
+
+    strncpy(p->data.banner, afl->use_banner, sizeof(p->data.banner) - 1);
+
+  }
+
+  __atomic_store_n(&p->magic, STATS_PAGE_MAGIC, __ATOMIC_RELEASE);
+
+  afl->stats_page = p;
+
+}
+
+/* Mark the session as ended and unmap the page. */
+
+void stats_page_destroy(afl_state_t *afl) {
+
+  struct stats_page *p = afl->stats_page;
+
+  if (!p) { return; }
+
+  stats_page_write_begin(&p->seq);
+  p->data.stopped = 1;
+  p->data.last_update = get_cur_time();
+  stats_page_write_end(&p->seq);
+
+  munmap(p, sizeof(struct stats_page));
+  afl->stats_page = NULL;
+
+}
+
+/* Publish the current numbers in the stats page. This only stores some
+   counters, so it is done on every UI refresh. */
+
+void stats_page_update(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
+                       double stability, double eps) {
+
+  struct stats_page      *p = afl->stats_page;
+  struct stats_page_data *d;
+
+  if (unlikely(!p)) { return; }
+
+  u64 cur_time = get_cur_time();
+  u64 runtime_ms = afl->prev_run_time + cur_time - afl->start_time;
+  u64 overhead_ms = (afl->calibration_time_us + afl->sync_time_us +
+                     afl->trim_time_us + afl->cmplog_time_us) /
+                    1000;
+  if (!runtime_ms) { runtime_ms = 1; }
+
+  update_last_min_execs(afl, cur_time);
+
+  stats_page_write_begin(&p->seq);
+
+  d = &p->data;
+  d->start_time = afl->start_time;
+  d->last_update = cur_time;
+  d->run_time = runtime_ms;
+  d->fuzz_time = runtime_ms - MIN(runtime_ms, overhead_ms);
+  d->calibration_time = afl->calibration_time_us / 1000;
+  d->cmplog_time = afl->cmplog_time_us / 1000;
+  d->sync_time = afl->sync_time_us / 1000;
+  d->trim_time = afl->trim_time_us / 1000;
+  d->cycles_done = afl->queue_cycle ? (afl->queue_cycle - 1) : 0;
+  d->cycles_wo_finds = afl->cycles_wo_finds;
+  d->execs_done = afl->fsrv.total_execs;
+  d->calibration_execs = afl->calibration_execs;
+  d->saved_crashes = afl->saved_crashes;
+  d->saved_hangs = afl->saved_hangs;
+  d->last_find = afl->last_find_time;
+  d->last_crash = afl->last_crash_time;
+  d->last_hang = afl->last_hang_time;
+  d->execs_since_crash = afl->fsrv.total_execs - afl->last_crash_execs;
+  d->total_crashes = afl->total_crashes;
+  d->total_tmouts = afl->total_tmouts;
+  d->saved_tmouts = afl->saved_tmouts;
+  d->trim_execs = afl->trim_execs;
+  d->bytes_trim_in = afl->bytes_trim_in;
+  d->bytes_trim_out = afl->bytes_trim_out;
+  d->trim_steps_skipped = afl->trim_steps_skipped;
+  d->sync_skipped = afl->sync_bus_skipped;
+  d->cmplog_unchanged = afl->cmplog_unchanged;
+  d->testcache_size = afl->q_testcase_cache_size;
+  d->testcache_hits = afl->q_testcase_hits;
+  d->testcache_misses = afl->q_testcase_misses;
+  d->execs_per_sec = afl->fsrv.total_execs / ((double)runtime_ms / 1000);
+  d->execs_ps_last_min = afl->last_avg_execs_saved;
+  d->execs_ps_now = eps;
+  d->stability = stability;
+  d->bitmap_cvg = bitmap_cvg;
+  d->corpus_count = afl->queued_items;
+  d->corpus_favored = afl->queued_favored;
+  d->corpus_found = afl->queued_discovered;
+  d->corpus_imported = afl->queued_imported;
+  d->corpus_variable = afl->queued_variable;
+  d->max_depth = afl->max_depth;
+  d->cur_item = afl->current_entry;
+  d->pending_favs = afl->pending_favored;
+  d->pending_total = afl->pending_not_fuzzed;
+  d->edges_found = t_bytes;
+  d->total_edges = afl->fsrv.real_map_size;
+  d->var_byte_count = afl->var_byte_count;
+  d->exec_timeout = afl->fsrv.exec_tmout;
+  d->slowest_exec_ms = afl->slowest_exec_ms;
+  d->corpus_with_cov = afl->queued_with_cov;
+  d->havoc_expansion = afl->expand_havoc;
+  d->auto_dict_entries = afl->a_extras_cnt;
+  d->testcache_count = afl->q_testcase_cache_count;
+  d->testcache_evict = afl->q_testcase_evictions;
+  d->skipdet_reused = afl->skipdet_g->inf_prof->inf_reused;
+
+  stats_page_write_end(&p->seq);
+
+}
+
+/* Add a plot_data line to the stats page. */
+
+static void stats_page_sample(afl_state_t *afl, u64 relative_time,
+                              u32 t_bytes, double bitmap_cvg, double eps) {
+
+  struct stats_page        *p = afl->stats_page;
+  struct stats_page_sample *s;
+
+  if (unlikely(!p)) { return; }
+
+  stats_page_write_begin(&p->sample_seq);
+
+  s = &p->sample[p->sample_head % STATS_PAGE_SAMPLES];
+  s->relative_time = relative_time;
+  s->cycles_done = afl->queue_cycle - 1;
+  s->execs_done = afl->fsrv.total_execs;
+  s->saved_crashes = afl->saved_crashes;
+  s->saved_hangs = afl->saved_hangs;
+  s->bitmap_cvg = bitmap_cvg;
+  s->execs_per_sec = eps;
+  s->cur_item = afl->current_entry;
+  s->corpus_count = afl->queued_items;
+  s->pending_total = afl->pending_not_fuzzed;
+  s->pending_favs = afl->pending_favored;
+  s->max_depth = afl->max_depth;
+  s->edges_found = t_bytes;
+  ++p->sample_head;
+
+  stats_page_write_end(&p->sample_seq);
+
+}
+
+/* The stages as reported in fuzzer_stats, each a range of STAGE_*. */
+
+static const struct {
+
+  const char *key;
+  u8          first, last;
+
+} stats_stages[] = {
+
+    {"stage_bitflip", STAGE_FLIP1, STAGE_FLIP4},
+    {"stage_byteflip", STAGE_FLIP8, STAGE_FLIP32},
+    {"stage_arith", STAGE_ARITH8, STAGE_ARITH32},
+    {"stage_interest", STAGE_INTEREST8, STAGE_INTEREST32},
+    {"stage_dictionary", STAGE_EXTRAS_UO, STAGE_EXTRAS_AI},
+    {"stage_havoc", STAGE_HAVOC, STAGE_HAVOC},
+    {"stage_splice", STAGE_SPLICE, STAGE_SPLICE},
+    {"stage_custom", STAGE_PYTHON, STAGE_CUSTOM_MUTATOR},
+    {"stage_colorization", STAGE_COLORIZATION, STAGE_COLORIZATION},
+    {"stage_redqueen", STAGE_ITS, STAGE_ITS},
+    {"stage_skipdet", STAGE_INF, STAGE_QUICK},
+    {NULL, 0, 0}
+
+};
+
+/* Write one "finds/execs/ms" line per stage. The stage_ticks are converted
+   with the get_cur_tsc() rate measured since afl_state_init(). */
+
+static void write_stage_stats(afl_state_t *afl, FILE *f) {
+
+  u64    ticks = get_cur_tsc() - afl->tsc_start;
+  u64    us = get_cur_time_us() - afl->tsc_start_us;
+  double ms_per_tick = ticks ? (double)us / 1000 / ticks : 0;
+
+  for (u32 i = 0; stats_stages[i].key; ++i) {
+
+    u64 finds = 0, execs = 0, stage_ticks = 0;
+
+    for (u32 s = stats_stages[i].first; s <= stats_stages[i].last; ++s) {
+
+      finds += afl->stage_finds[s];
+      execs += afl->stage_cycles[s];
+      stage_ticks += afl->stage_ticks[s];
+
+    }
+
+    fprintf(f, "%-18s: %llu/%llu/%llu\n", stats_stages[i].key, finds, execs,
+            (u64)(stage_ticks * ms_per_tick));
+
+  }
+
+}
+
 /* Update stats file for unattended monitoring. */
 
 void write_stats_file(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
@@ -336,16 +584,7 @@ void write_stats_file(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
 
   }
 
-  if ((unlikely(!afl->last_avg_exec_update ||
-                cur_time - afl->last_avg_exec_update >= 60000))) {
-
-    afl->last_avg_execs_saved =
-        (double)(1000 * (afl->fsrv.total_execs - afl->last_avg_total_execs)) /
-        (double)(cur_time - afl->last_avg_exec_update);
-    afl->last_avg_total_execs = afl->fsrv.total_execs;
-    afl->last_avg_exec_update = cur_time;
-
-  }
+  update_last_min_execs(afl, cur_time);
 
 #ifndef __HAIKU__
   if (getrusage(RUSAGE_CHILDREN, &rus)) { rus.ru_maxrss = 0; }
@@ -402,11 +641,17 @@ void write_stats_file(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
       "testcache_size    : %llu\n"
       "testcache_count   : %u\n"
       "testcache_evict   : %u\n"
+      "testcache_hits    : %llu\n"
+      "testcache_misses  : %llu\n"
+      "sync_skipped      : %llu\n"
+      "cmplog_unchanged  : %llu\n"
+      "skipdet_reused    : %u\n"
+      "trim_steps_skipped: %llu\n"
+      "calibration_execs : %llu\n"
       "afl_banner        : %s\n"
       "afl_version       : " VERSION
       "\n"
-      "target_mode       : %s%s%s%s%s%s%s%s%s%s\n"
-      "command_line      : %s\n",
+      "target_mode       : %s%s%s%s%s%s%s%s%s%s\n",
       (afl->start_time /*- afl->prev_run_time*/) / 1000, cur_time / 1000,
       runtime_ms / 1000, (u32)getpid(),
       afl->queue_cycle ? (afl->queue_cycle - 1) : 0, afl->cycles_wo_finds,
@@ -443,7 +688,11 @@ void write_stats_file(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
 #endif
       t_bytes, afl->fsrv.real_map_size, afl->var_byte_count, afl->expand_havoc,
       afl->a_extras_cnt, afl->q_testcase_cache_size,
-      afl->q_testcase_cache_count, afl->q_testcase_evictions, afl->use_banner,
+      afl->q_testcase_cache_count, afl->q_testcase_evictions,
+      afl->q_testcase_hits, afl->q_testcase_misses, afl->sync_bus_skipped,
+      afl->cmplog_unchanged, afl->skipdet_g->inf_prof->inf_reused,
+      afl->trim_steps_skipped, afl->calibration_execs,
+      afl->use_banner,
       afl->unicorn_mode ? "unicorn" : "", afl->fsrv.qemu_mode ? "qemu " : "",
       afl->fsrv.cs_mode ? "coresight" : "",
       afl->non_instrumented_mode ? " non_instrumented " : "",
@@ -455,8 +704,12 @@ void write_stats_file(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
        afl->non_instrumented_mode || afl->no_forkserver || afl->crash_mode ||
        afl->persistent_mode || afl->deferred_mode)
           ? ""
-          : "default",
-      afl->orig_cmdline);
+          : "default");
+
+  /* command_line stays the last entry, scripts read it up to the end */
+
+  write_stage_stats(afl, f);
+  fprintf(f, "command_line      : %s\n", afl->orig_cmdline);
 
   /* ignore errors */
 
@@ -557,6 +810,13 @@ void maybe_update_plot_file(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
   afl->plot_prev_md = afl->max_depth;
   afl->plot_prev_ed = afl->fsrv.total_execs;
 
+  u64 relative_time = (afl->prev_run_time + get_cur_time() - afl->start_time) /
+                      1000;
+
+  stats_page_sample(afl, relative_time, t_bytes, bitmap_cvg, eps);
+
+  if (afl->afl_env.afl_no_stats_text) { return; }
+
   /* Fields in the file:
 
      relative_time, afl->cycles_done, cur_item, corpus_count, corpus_not_fuzzed,
@@ -566,11 +826,10 @@ void maybe_update_plot_file(afl_state_t *afl, u32 t_bytes, double bitmap_cvg,
   fprintf(afl->fsrv.plot_file,
           "%llu, %llu, %u, %u, %u, %u, %0.02f%%, %llu, %llu, %u, %0.02f, %llu, "
           "%u\n",
-          ((afl->prev_run_time + get_cur_time() - afl->start_time) / 1000),
-          afl->queue_cycle - 1, afl->current_entry, afl->queued_items,
-          afl->pending_not_fuzzed, afl->pending_favored, bitmap_cvg,
-          afl->saved_crashes, afl->saved_hangs, afl->max_depth, eps,
-          afl->plot_prev_ed, t_bytes);                     /* ignore errors */
+          relative_time, afl->queue_cycle - 1, afl->current_entry,
+          afl->queued_items, afl->pending_not_fuzzed, afl->pending_favored,
+          bitmap_cvg, afl->saved_crashes, afl->saved_hangs, afl->max_depth,
+          eps, afl->plot_prev_ed, t_bytes);                /* ignore errors */
 
   fflush(afl->fsrv.plot_file);
 
@@ -774,6 +1033,9 @@ void show_stats_normal(afl_state_t *afl) {
 
   }
 
+  stats_page_update(afl, t_bytes, t_byte_ratio, stab_ratio,
+                    afl->stats_avg_exec);
+
   /* Roughly every minute, update fuzzer stats and save auto tokens. */
 
   if (unlikely(
@@ -782,9 +1044,18 @@ void show_stats_normal(afl_state_t *afl) {
                                        afl->stats_file_update_freq_msecs))) {
 
     afl->stats_last_stats_ms = cur_ms;
-    write_stats_file(afl, t_bytes, t_byte_ratio, stab_ratio,
-                     afl->stats_avg_exec);
+
+    /* With AFL_NO_STATS_TEXT the text file is only written at the end. */
+
+    if (!afl->afl_env.afl_no_stats_text || afl->force_ui_update) {
+
+      write_stats_file(afl, t_bytes, t_byte_ratio, stab_ratio,
+                       afl->stats_avg_exec);
+
+    }
+
     save_auto(afl);
+    bandit_save(afl);
     write_bitmap(afl);
 
   }
@@ -1596,6 +1867,9 @@ void show_stats_pizza(afl_state_t *afl) {
 
   }
 
+  stats_page_update(afl, t_bytes, t_byte_ratio, stab_ratio,
+                    afl->stats_avg_exec);
+
   /* Roughly every minute, update fuzzer stats and save auto tokens. */
 
   if (unlikely(!afl->non_instrumented_mode &&
@@ -1603,9 +1877,18 @@ void show_stats_pizza(afl_state_t *afl) {
                 cur_ms - afl->stats_last_stats_ms > STATS_UPDATE_SEC * 1000))) {
 
     afl->stats_last_stats_ms = cur_ms;
-    write_stats_file(afl, t_bytes, t_byte_ratio, stab_ratio,
-                     afl->stats_avg_exec);
+
+    /* With AFL_NO_STATS_TEXT the text file is only written at the end. */
+
+    if (!afl->afl_env.afl_no_stats_text || afl->force_ui_update) {
+
+      write_stats_file(afl, t_bytes, t_byte_ratio, stab_ratio,
+                       afl->stats_avg_exec);
+
+    }
+
     save_auto(afl);
+    bandit_save(afl);
     write_bitmap(afl);
 
   }
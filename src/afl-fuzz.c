@@ -320,6 +320,9 @@ static void usage(u8 *argv0, int more_help) {
       "AFL_AUTORESUME: resume fuzzing if directory specified by -o already exists\n"
       "AFL_BENCH_JUST_ONE: run the target just once\n"
       "AFL_BENCH_UNTIL_CRASH: exit soon when the first crashing input has been found\n"
+      "AFL_CAL_ADAPTIVE: stop calibrating an entry early if its runs are stable\n"
+      "AFL_CAL_JOBS: calibrate the initial seeds with this many forkservers\n"
+      "AFL_CMPLOG_JOBS: run colorization with this many forkservers in parallel\n"
       "AFL_CMPLOG_ONLY_NEW: do not run cmplog on initial testcases (good for resumes!)\n"
       "AFL_CRASH_EXITCODE: optional child exit code to be interpreted as crash\n"
       "AFL_CUSTOM_MUTATOR_LIBRARY: lib with afl_custom_fuzz() to mutate inputs\n"
@@ -339,6 +342,7 @@ static void usage(u8 *argv0, int more_help) {
       "AFL_FORCE_UI: force showing the status screen (for virtual consoles)\n"
       "AFL_FORKSRV_INIT_TMOUT: time spent waiting for forkserver during startup (in ms)\n"
       "AFL_HANG_TMOUT: override timeout value (in milliseconds)\n"
+      "AFL_HAVOC_BANDIT: learn which havoc mutations and stack depths find paths\n"
       "AFL_I_DONT_CARE_ABOUT_MISSING_CRASHES: don't warn about core dump handlers\n"
       "AFL_IGNORE_PROBLEMS: do not abort fuzzing if an incorrect setup is detected\n"
       "AFL_IGNORE_PROBLEMS_COVERAGE: if set in addition to AFL_IGNORE_PROBLEMS - also\n"
@@ -361,6 +365,8 @@ static void usage(u8 *argv0, int more_help) {
       "AFL_MAX_DET_EXTRAS: if more entries are in the dictionary list than this value\n"
       "                    then they are randomly selected instead all of them being\n"
       "                    used. Defaults to 200.\n"
+      "AFL_METRICS: serve OpenMetrics (Prometheus) on http://AFL_METRICS_HOST:\n"
+      "             AFL_METRICS_PORT/metrics (default 127.0.0.1:9464)\n"
       "AFL_NO_AFFINITY: do not check for an unused cpu core to use for fuzzing\n"
       "AFL_TRY_AFFINITY: try to bind to an unused core, but don't fail if unsuccessful\n"
       "AFL_NO_ARITH: skip arithmetic mutations in deterministic stage\n"
@@ -369,6 +375,7 @@ static void usage(u8 *argv0, int more_help) {
       "AFL_NO_FORKSRV: run target via execve instead of using the forkserver\n"
       "AFL_NO_SNAPSHOT: do not use the snapshot feature (if the snapshot lkm is loaded)\n"
       "AFL_NO_STARTUP_CALIBRATION: no initial seed calibration, start fuzzing at once\n"
+      "AFL_NO_STATS_TEXT: only write fuzzer_stats.bin while fuzzing, no plot_data\n"
       "AFL_NO_WARN_INSTABILITY: no warn about instability issues on startup calibration\n"
       "AFL_NO_UI: switch status screen off\n"
       "AFL_NYX_AUX_SIZE: size of the Nyx auxiliary buffer. Must be a multiple of 4096.\n"
@@ -399,12 +406,18 @@ static void usage(u8 *argv0, int more_help) {
       "AFL_STATSD_TAGS_FLAVOR: set statsd tags format (default: disable tags)\n"
       "                        suported formats: dogstatsd, librato, signalfx, influxdb\n"
       "AFL_NO_FASTRESUME: do not read or write a fast resume file\n"
+      "AFL_PACK_CORPUS: also write finds to queue/crashes/hangs.pack and sync\n"
+      "                 from the packs of other instances\n"
       "AFL_NO_SYNC: disables all syncing\n"
       "AFL_SYNC_TIME: sync time between fuzzing instances (in minutes)\n"
+      "AFL_SYNC_INOTIFY: only look at new files of other instances (Linux)\n"
+      "AFL_SYNC_BUS: share traces of new finds with instances on this host\n"
       "AFL_FINAL_SYNC: sync a final time when exiting (will delay the exit!)\n"
       "AFL_NO_CRASH_README: do not create a README in the crashes directory\n"
       "AFL_TESTCACHE_SIZE: use a cache for testcases, improves performance (in MB)\n"
       "AFL_TMPDIR: directory to use for input file generation (ramdisk recommended)\n"
+      "AFL_TRACE_MINI_FILE: keep the minimized queue traces in a file mapping\n"
+      "AFL_TRIM_JOBS: trim new queue entries with this many forkservers\n"
       "AFL_EARLY_FORKSERVER: force an early forkserver in an afl-clang-fast/\n"
       "                      afl-clang-lto/afl-gcc-fast target\n"
       "AFL_PERSISTENT: enforce persistent mode (if __AFL_LOOP is in a shared lib)\n"
@@ -2037,6 +2050,8 @@ int main(int argc, char **argv_orig, char **envp) {
   atexit(at_exit);
 
   setup_dirs_fds(afl);
+  stats_page_init(afl);
+  metrics_init(afl);
 
   #ifdef HAVE_AFFINITY
   bind_to_free_cpu(afl);
@@ -2338,6 +2353,9 @@ int main(int argc, char **argv_orig, char **envp) {
 
   read_testcases(afl, NULL);
 
+  /* Before pivot_inputs() removes the state of a resumed session. */
+  bandit_init(afl);
+
   pivot_inputs(afl);
 
   if (!afl->timeout_given) { find_timeout(afl); }  // only for resumes!
@@ -2734,7 +2752,7 @@ int main(int argc, char **argv_orig, char **envp) {
       ZLIBREAD(fr_fd, res, 1, "check map");
       if (res[0]) {
 
-        q->trace_mini = ck_alloc(m_len);
+        q->trace_mini = trace_mini_alloc(afl);
         ZLIBREAD(fr_fd, q->trace_mini, m_len, "trace_mini");
         r += q_len + m_len + 1;
 
@@ -2818,6 +2836,8 @@ int main(int argc, char **argv_orig, char **envp) {
   }
 
   cull_queue(afl);
+  setup_pack_files(afl);
+  sync_bus_init(afl);
 
   // ensure we have at least one seed that is not disabled.
   u32 entry, valid_seeds = 0;
@@ -3304,6 +3324,7 @@ stop_fuzzing:
   show_stats(afl);           // print the screen one last time
   write_bitmap(afl);
   save_auto(afl);
+  bandit_save(afl);
 
   #ifdef __AFL_CODE_COVERAGE
   if (afl->fsrv.persistent_trace_bits) {
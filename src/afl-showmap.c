@@ -53,6 +53,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include <dirent.h>
 #include <sys/wait.h>
@@ -97,6 +98,7 @@ static bool quiet_mode,                /* Hide non-essential messages?      */
     no_classify,                       /* do not classify counts            */
     debug,                             /* debug mode                        */
     print_filenames,                   /* print the current filename        */
+    minimize_mode,                     /* minimize the corpus like afl-cmin */
     wait_for_gdb;
 
 static volatile u8 stop_soon,          /* Ctrl-C pressed?                   */
@@ -984,6 +986,938 @@ u32 execute_testcases_filelist(u8 *fn) {
 
 }
 
+/* Execute all testcases of a packed corpus (see include/afl-pack.h). */
+
+u32 execute_testcases_pack(u8 *fn) {
+
+  struct afl_pack_record rec;
+  s32                    fd, idx_fd;
+  u32                    i, cnt, done = 0;
+
+  if (!be_quiet) { ACTF("Reading from pack '%s'...", fn); }
+
+  if (afl_pack_open_ro(fn, &fd, &idx_fd)) {
+
+    PFATAL("Unable to open '%s'", fn);
+
+  }
+
+  cnt = afl_pack_count(idx_fd);
+
+  for (i = 0; i < cnt && !stop_soon; ++i) {
+
+    u8 *buf = afl_pack_read(fd, idx_fd, i, &rec);
+
+    if (!buf) {
+
+      WARNF("Unable to read record %u from '%s'", i, fn);
+      continue;
+
+    }
+
+    if (!rec.len) {
+
+      ck_free(buf);
+      continue;
+
+    }
+
+    if (print_filenames) {
+
+      SAYF("Processing %s:%u\n", fn, i);
+      fflush(stdout);
+
+    }
+
+    if (!collect_coverage) {
+
+      if (rec.desc_len) {
+
+        snprintf(outfile, sizeof(outfile), "%s/%s", out_file, buf + rec.len);
+
+      } else {
+
+        snprintf(outfile, sizeof(outfile), "%s/id:%06u", out_file, rec.id);
+
+      }
+
+    }
+
+    showmap_run_target_forkserver(fsrv, buf, rec.len);
+    ck_free(buf);
+    ++done;
+
+    if (child_crashed && debug) { WARNF("crashed: %s:%u", fn, i); }
+
+    if (collect_coverage)
+      analyze_results(fsrv);
+    else
+      tcnt = write_results_to_file(fsrv, outfile);
+
+  }
+
+  close(fd);
+  close(idx_fd);
+  return done;
+
+}
+
+/* Native corpus minimization (-M), the engine of afl-cmin. Every file below
+   in_dir is run once, spread over -T forkservers, and the tuples of its
+   trace are counted. The smallest file that has a tuple is the best file
+   for it, ties are broken by reverse path order like the sort in afl-cmin
+   did. Then the tuples are walked from rare to common, and the best file of
+   every tuple that is not covered yet goes into the output directory and
+   covers all of its tuples. Only the tuples of files that are the best
+   file for at least one tuple are kept in memory. */
+
+enum {
+
+  /* 00 */ CMIN_SLOT_FREE,
+  /* 01 */ CMIN_SLOT_RUNNING,
+  /* 02 */ CMIN_SLOT_DONE
+
+};
+
+enum {
+
+  /* 00 */ CMIN_RUN_OK,
+  /* 01 */ CMIN_RUN_UNREADABLE,
+  /* 02 */ CMIN_RUN_TMOUT,
+  /* 03 */ CMIN_RUN_SKIPPED             /* Crashed, or not with crashes only */
+
+};
+
+struct cmin_file {
+
+  u8  *path;                            /* pack:nr for a pack record        */
+  u8  *name;                            /* Basename, or own copy for a pack */
+  u64  size;
+  u32 *tuples;                          /* Tuple ids, if it is a candidate  */
+  u32  tuple_cnt;
+  u32  pack_nr;                         /* Record number, if from a pack    */
+  u8   taken;                           /* Copied to the output             */
+
+};
+
+struct cmin_tuple {
+
+  u64 key;                              /* Edge << 8 | value                */
+  u32 cnt;                              /* Files that have the tuple        */
+  u32 best;                             /* First of them in size order      */
+
+};
+
+struct cmin_slot {
+
+  u32  idx;                             /* Index of the file                */
+  u8   state;                           /* CMIN_SLOT_*                      */
+  u8   result;                          /* CMIN_RUN_*                       */
+  u64 *keys;                            /* Tuples of the trace              */
+  u32  key_cnt;
+
+};
+
+struct cmin_task {
+
+  struct cmin_state *cm;
+  afl_forkserver_t  *fsrv;
+  afl_forkserver_t   own;               /* Unless it is the main forkserver */
+  sharedmem_t        shm, shm_fuzz;
+  u8                *in_file;           /* Input file of own                */
+  u8                *buf;
+  pthread_t          thread;
+
+};
+
+struct cmin_state {
+
+  struct cmin_file  *files;
+  struct cmin_tuple *tuples;
+  struct cmin_slot  *slots;
+  struct cmin_task  *tasks;
+  u32               *hash;              /* Tuple id + 1 by key              */
+  u32                file_cnt, tuple_cnt, hash_bits, task_cnt;
+  u32                window, next, taken;
+  s32                pack_fd, pack_idx_fd;    /* If -i is a pack, or -1 */
+  u8                 crashes_only, allow_any;
+  pthread_mutex_t    lock;
+  pthread_cond_t     cond;
+
+};
+
+static u32 cmin_tasks = 1;             /* -T, forkservers for -M            */
+
+static void cmin_scan(struct cmin_state *cm, u8 *dir) {
+
+  DIR           *d = opendir(dir);
+  struct dirent *de;
+
+  if (!d) { PFATAL("Unable to open '%s'", dir); }
+
+  /* Like the find in afl-cmin: all regular files, hidden ones and those in
+     hidden directories included. */
+
+  while ((de = readdir(d))) {
+
+    struct stat st;
+
+    if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) { continue; }
+
+    u8 *fn = alloc_printf("%s/%s", dir, de->d_name);
+
+    if (lstat(fn, &st)) { PFATAL("Unable to access '%s'", fn); }
+
+    if (S_ISDIR(st.st_mode)) {
+
+      cmin_scan(cm, fn);
+      ck_free(fn);
+      continue;
+
+    }
+
+    if (!S_ISREG(st.st_mode) || !st.st_size) {
+
+      ck_free(fn);
+      continue;
+
+    }
+
+    cm->files = afl_realloc((void **)&cm->files,
+                            (cm->file_cnt + 1) * sizeof(struct cmin_file));
+    if (!cm->files) { PFATAL("alloc"); }
+
+    struct cmin_file *f = &cm->files[cm->file_cnt++];
+    memset(f, 0, sizeof(struct cmin_file));
+    f->path = fn;
+    f->name = fn + strlen(fn) - strlen(de->d_name);
+    f->size = st.st_size;
+
+  }
+
+  closedir(d);
+
+}
+
+/* Add the records of a packed corpus (see include/afl-pack.h). The output
+   files are named after the description of the records. */
+
+static void cmin_scan_pack(struct cmin_state *cm, u8 *fn) {
+
+  struct afl_pack_record rec;
+  u32                    i, cnt;
+
+  if (afl_pack_open_ro(fn, &cm->pack_fd, &cm->pack_idx_fd)) {
+
+    PFATAL("Unable to open '%s'", fn);
+
+  }
+
+  cnt = afl_pack_count(cm->pack_idx_fd);
+
+  for (i = 0; i < cnt; ++i) {
+
+    u8 *buf = afl_pack_read(cm->pack_fd, cm->pack_idx_fd, i, &rec), *desc;
+
+    if (!buf) {
+
+      WARNF("Unable to read record %u from '%s'", i, fn);
+      continue;
+
+    }
+
+    if (!rec.len) {
+
+      ck_free(buf);
+      continue;
+
+    }
+
+    cm->files = afl_realloc((void **)&cm->files,
+                            (cm->file_cnt + 1) * sizeof(struct cmin_file));
+    if (!cm->files) { PFATAL("alloc"); }
+
+    struct cmin_file *f = &cm->files[cm->file_cnt++];
+    memset(f, 0, sizeof(struct cmin_file));
+
+    desc = buf + rec.len;
+    f->path = alloc_printf("%s:%u", fn, i);
+    f->name = !desc[0] || desc[0] == '.' || strchr(desc, '/')
+                  ? alloc_printf("pack_%06u", i)
+                  : ck_strdup(desc);
+    f->size = rec.len;
+    f->pack_nr = i;
+    ck_free(buf);
+
+  }
+
+}
+
+/* Small files first, equal sizes in reverse path order. */
+
+static int cmin_file_cmp(const void *a, const void *b) {
+
+  const struct cmin_file *fa = a, *fb = b;
+
+  if (fa->size != fb->size) { return fa->size < fb->size ? -1 : 1; }
+  return strcmp(fb->path, fa->path);
+
+}
+
+static struct cmin_tuple *cmin_sort_tuples;
+
+static u32 cmin_digits(u64 v) {
+
+  u32 ret = 1;
+
+  while (v >= 10) {
+
+    v /= 10;
+    ++ret;
+
+  }
+
+  return ret;
+
+}
+
+/* Rare tuples first. afl-cmin broke ties by comparing the lines it wrote
+   for the tuples, the edge in decimal followed by the value in three
+   digits, which is what the second part does. */
+
+static int cmin_tuple_cmp(const void *a, const void *b) {
+
+  struct cmin_tuple *ta = &cmin_sort_tuples[*(u32 *)a],
+                    *tb = &cmin_sort_tuples[*(u32 *)b];
+
+  if (ta->cnt != tb->cnt) { return ta->cnt < tb->cnt ? -1 : 1; }
+
+  u64 va = (ta->key >> 8) * 1000 + (ta->key & 255),
+      vb = (tb->key >> 8) * 1000 + (tb->key & 255);
+  u32 la = cmin_digits(ta->key >> 8) + 3, lb = cmin_digits(tb->key >> 8) + 3,
+      i;
+
+  for (i = la; i < lb; ++i) {
+
+    va *= 10;
+
+  }
+
+  for (i = lb; i < la; ++i) {
+
+    vb *= 10;
+
+  }
+
+  if (va != vb) { return va < vb ? -1 : 1; }
+  return la < lb ? -1 : la > lb;
+
+}
+
+static inline u32 cmin_hash_pos(u64 key, u32 bits) {
+
+  return (key * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
+
+}
+
+static void cmin_hash_grow(struct cmin_state *cm) {
+
+  u32 mask, pos;
+
+  ck_free(cm->hash);
+  ++cm->hash_bits;
+  cm->hash = ck_alloc(sizeof(u32) << cm->hash_bits);
+  mask = (1U << cm->hash_bits) - 1;
+
+  for (u32 i = 0; i < cm->tuple_cnt; ++i) {
+
+    pos = cmin_hash_pos(cm->tuples[i].key, cm->hash_bits);
+    while (cm->hash[pos]) {
+
+      pos = (pos + 1) & mask;
+
+    }
+
+    cm->hash[pos] = i + 1;
+
+  }
+
+}
+
+/* Returns the id of the tuple with key, adding it if it is new. */
+
+static u32 cmin_tuple_id(struct cmin_state *cm, u64 key) {
+
+  u32 mask = (1U << cm->hash_bits) - 1,
+      pos = cmin_hash_pos(key, cm->hash_bits);
+
+  while (cm->hash[pos]) {
+
+    if (cm->tuples[cm->hash[pos] - 1].key == key) { return cm->hash[pos] - 1; }
+    pos = (pos + 1) & mask;
+
+  }
+
+  if (cm->tuple_cnt + 1 > (1U << cm->hash_bits) / 2) {
+
+    cmin_hash_grow(cm);
+    return cmin_tuple_id(cm, key);
+
+  }
+
+  cm->tuples = afl_realloc((void **)&cm->tuples,
+                           (cm->tuple_cnt + 1) * sizeof(struct cmin_tuple));
+  if (!cm->tuples) { PFATAL("alloc"); }
+
+  cm->tuples[cm->tuple_cnt].key = key;
+  cm->tuples[cm->tuple_cnt].cnt = 0;
+  cm->hash[pos] = ++cm->tuple_cnt;
+  return cm->tuple_cnt - 1;
+
+}
+
+/* The value afl-showmap -Z would have written for a hit count. */
+
+static inline u8 cmin_value(u8 v) {
+
+  if (edges_only) { return 1; }
+  if (raw_instr_output || no_classify) { return v; }
+  return count_class_human[v];
+
+}
+
+/* Run one file on the forkserver of a task and leave its tuples in slot. */
+
+static void cmin_run(struct cmin_task *t, struct cmin_file *f,
+                     struct cmin_slot *slot) {
+
+  struct cmin_state *cm = t->cm;
+  afl_forkserver_t  *fs = t->fsrv;
+  u8                *tb = fs->trace_bits, crashed;
+  u32                len = MIN(f->size, (u64)MAX_FILE), i, j;
+  s32                fd;
+
+  slot->result = CMIN_RUN_UNREADABLE;
+  slot->key_cnt = 0;
+
+  t->buf = afl_realloc((void **)&t->buf, len);
+  if (!t->buf) { PFATAL("alloc"); }
+
+  if (cm->pack_fd >= 0) {
+
+    struct afl_pack_record rec;
+    u8 *mem = afl_pack_read(cm->pack_fd, cm->pack_idx_fd, f->pack_nr, &rec);
+
+    if (!mem || rec.len != len) {
+
+      ck_free(mem);
+      return;
+
+    }
+
+    memcpy(t->buf, mem, len);
+    ck_free(mem);
+
+  } else {
+
+    fd = open(f->path, O_RDONLY);
+    if (fd < 0 || read(fd, t->buf, len) != (ssize_t)len) {
+
+      if (fd >= 0) { close(fd); }
+      return;
+
+    }
+
+    close(fd);
+
+  }
+
+  pre_afl_fsrv_write_to_testcase(fs, t->buf, len);
+
+  if (afl_fsrv_run_target(fs, fs->exec_tmout, &stop_soon) == FSRV_RUN_ERROR) {
+
+    FATAL("Error running target");
+
+  }
+
+  if (tb[0]) { tb[0] -= 1; }
+
+  crashed = !fs->last_run_timed_out && !stop_soon &&
+            WIFSIGNALED(fs->child_status);
+
+  if (fs->last_run_timed_out) {
+
+    slot->result = CMIN_RUN_TMOUT;
+    return;
+
+  }
+
+  if (!cm->allow_any && crashed != cm->crashes_only) {
+
+    slot->result = CMIN_RUN_SKIPPED;
+    return;
+
+  }
+
+  for (i = 0; i < map_size; i += 8) {
+
+    if (likely(i + 8 <= map_size) && !*(u64 *)(tb + i)) { continue; }
+
+    for (j = i; j < i + 8 && j < map_size; ++j) {
+
+      if (!tb[j]) { continue; }
+
+      slot->keys = afl_realloc((void **)&slot->keys,
+                               (slot->key_cnt + 1) * sizeof(u64));
+      if (!slot->keys) { PFATAL("alloc"); }
+      slot->keys[slot->key_cnt++] = ((u64)j << 8) | cmin_value(tb[j]);
+
+    }
+
+  }
+
+  slot->result = CMIN_RUN_OK;
+
+}
+
+static void *cmin_task_main(void *arg) {
+
+  struct cmin_task  *t = arg;
+  struct cmin_state *cm = t->cm;
+
+  pthread_mutex_lock(&cm->lock);
+
+  while (!stop_soon && cm->next < cm->file_cnt) {
+
+    if (cm->next >= cm->taken + cm->window) {
+
+      pthread_cond_wait(&cm->cond, &cm->lock);
+      continue;
+
+    }
+
+    u32               idx = cm->next++;
+    struct cmin_slot *slot = &cm->slots[idx % cm->window];
+
+    slot->idx = idx;
+    slot->state = CMIN_SLOT_RUNNING;
+
+    pthread_mutex_unlock(&cm->lock);
+    cmin_run(t, &cm->files[idx], slot);
+    pthread_mutex_lock(&cm->lock);
+
+    slot->state = CMIN_SLOT_DONE;
+    pthread_cond_broadcast(&cm->cond);
+
+  }
+
+  /* Wake up the main thread in case we stopped early. */
+
+  pthread_cond_broadcast(&cm->cond);
+  pthread_mutex_unlock(&cm->lock);
+  return NULL;
+
+}
+
+/* Give task nr its own trace map, input and forkserver. */
+
+static void cmin_task_init(struct cmin_task *t, u32 nr, char **argv) {
+
+  if (!fsrv->use_shmem_fuzz) {
+
+    t->in_file = alloc_printf("%s.%u", stdin_file, nr);
+
+  }
+
+  afl_fsrv_start_helper(&t->own, fsrv, &t->shm, &t->shm_fuzz, t->in_file,
+                        stdin_file, argv, &stop_soon,
+                        (get_afl_env("AFL_DEBUG_CHILD") ||
+                         get_afl_env("AFL_DEBUG_CHILD_OUTPUT"))
+                            ? 1
+                            : 0);
+
+  t->fsrv = &t->own;
+
+}
+
+/* Returns 1 if the inputs can be run on several forkservers. */
+
+static u8 cmin_tasks_possible(char **argv) {
+
+  u8 *reason = NULL;
+
+  if (afl->custom_mutators_count) {
+
+    reason = "custom mutators";
+
+  } else if (fsrv->nyx_mode || fsrv->use_fauxsrv) {
+
+    reason = "this mode";
+
+  } else if (!fsrv->use_shmem_fuzz && fsrv->use_stdin && at_file) {
+
+    reason = "a fixed input file (-H without @@)";
+
+  } else if (!fsrv->use_shmem_fuzz && !fsrv->use_stdin) {
+
+    char **probe = afl_fsrv_argv_replace(argv, stdin_file, stdin_file);
+    if (!probe) { reason = "an input file that is not on the command line"; }
+    afl_fsrv_argv_free(probe, argv);
+
+  }
+
+  if (reason) { WARNF("-T is not supported with %s, using one task.", reason); }
+  return !reason;
+
+}
+
+/* Take over file f into out_file. Returns 1 if it was written. */
+
+static u8 cmin_copy(struct cmin_state *cm, struct cmin_file *f) {
+
+  u8 *fn = alloc_printf("%s/%s", out_file, f->name), buf[65536];
+  s32 in_fd, out_fd;
+  ssize_t len;
+
+  if (cm->pack_fd >= 0) {
+
+    struct afl_pack_record rec;
+    u8 *mem = afl_pack_read(cm->pack_fd, cm->pack_idx_fd, f->pack_nr, &rec);
+
+    if (!mem) { FATAL("Unable to read '%s'", f->path); }
+
+    out_fd = open(fn, O_WRONLY | O_CREAT | O_EXCL, DEFAULT_PERMISSION);
+
+    if (out_fd < 0) {
+
+      if (errno != EEXIST) { PFATAL("Unable to create '%s'", fn); }
+      ck_free(mem);
+      ck_free(fn);
+      return 0;
+
+    }
+
+    ck_write(out_fd, mem, rec.len, fn);
+    close(out_fd);
+    ck_free(mem);
+    ck_free(fn);
+    return 1;
+
+  }
+
+  if (!link(f->path, fn)) {
+
+    ck_free(fn);
+    return 1;
+
+  }
+
+  /* afl-cmin kept one file per name as well. */
+
+  if (errno == EEXIST) {
+
+    ck_free(fn);
+    return 0;
+
+  }
+
+  in_fd = open(f->path, O_RDONLY);
+  if (in_fd < 0) { PFATAL("Unable to open '%s'", f->path); }
+
+  out_fd = open(fn, O_WRONLY | O_CREAT | O_EXCL, DEFAULT_PERMISSION);
+  if (out_fd < 0) { PFATAL("Unable to create '%s'", fn); }
+
+  while ((len = read(in_fd, buf, sizeof(buf))) > 0) {
+
+    ck_write(out_fd, buf, len, fn);
+
+  }
+
+  if (len < 0) { PFATAL("Unable to read '%s'", f->path); }
+
+  close(in_fd);
+  close(out_fd);
+  ck_free(fn);
+  return 1;
+
+}
+
+/* Minimize the corpus in in_dir into out_file, argv is the target argv of
+   the main forkserver. */
+
+static void cmin_corpus(char **argv) {
+
+  struct cmin_state cm = {0};
+  struct stat       st;
+  u32              *order, *ids = NULL, i, j, out_cnt = 0;
+  u64              *covered;
+
+  cm.crashes_only = !!getenv("AFL_CMIN_CRASHES_ONLY");
+  cm.allow_any = !!getenv("AFL_CMIN_ALLOW_ANY");
+  cm.pack_fd = cm.pack_idx_fd = -1;
+
+  if (!stat(in_dir, &st) && S_ISREG(st.st_mode)) {
+
+    cmin_scan_pack(&cm, in_dir);
+
+  } else {
+
+    cmin_scan(&cm, in_dir);
+
+  }
+
+  if (!cm.file_cnt) { FATAL("No inputs in '%s'", in_dir); }
+
+  qsort(cm.files, cm.file_cnt, sizeof(struct cmin_file), cmin_file_cmp);
+
+  cm.task_cnt = MIN(cmin_tasks, cm.file_cnt);
+  if (cm.task_cnt > 1 && !cmin_tasks_possible(argv)) { cm.task_cnt = 1; }
+
+  cm.window = cm.task_cnt * CMIN_TASK_AHEAD;
+  cm.slots = ck_alloc(cm.window * sizeof(struct cmin_slot));
+  cm.tasks = ck_alloc(cm.task_cnt * sizeof(struct cmin_task));
+  cm.hash_bits = 16;
+  cm.hash = ck_alloc(sizeof(u32) << cm.hash_bits);
+
+  pthread_mutex_init(&cm.lock, NULL);
+  pthread_cond_init(&cm.cond, NULL);
+
+  OKF("Obtaining traces for %u input files in '%s' with %u task%s.",
+      cm.file_cnt, in_dir, cm.task_cnt, cm.task_cnt == 1 ? "" : "s");
+
+  u8 save_be_quiet = be_quiet;
+  be_quiet = !debug;
+
+  for (i = 0; i < cm.task_cnt; ++i) {
+
+    cm.tasks[i].cm = &cm;
+
+    if (i) {
+
+      cmin_task_init(&cm.tasks[i], i, argv);
+
+    } else {
+
+      cm.tasks[i].fsrv = fsrv;
+
+    }
+
+  }
+
+  be_quiet = save_be_quiet;
+
+  for (i = 0; i < cm.task_cnt; ++i) {
+
+    if (pthread_create(&cm.tasks[i].thread, NULL, cmin_task_main,
+                       &cm.tasks[i])) {
+
+      PFATAL("pthread_create() failed");
+
+    }
+
+  }
+
+  /* Count the tuples of the traces in size order, so the first file that
+     has a tuple is its best file. */
+
+  for (i = 0; i < cm.file_cnt; ++i) {
+
+    struct cmin_file *f = &cm.files[i];
+    struct cmin_slot *slot = &cm.slots[i % cm.window];
+    u8                best = 0;
+
+    pthread_mutex_lock(&cm.lock);
+
+    while (!stop_soon &&
+           (slot->idx != i || slot->state != CMIN_SLOT_DONE)) {
+
+      pthread_cond_wait(&cm.cond, &cm.lock);
+
+    }
+
+    pthread_mutex_unlock(&cm.lock);
+
+    if (stop_soon) { break; }
+
+    if (slot->result == CMIN_RUN_UNREADABLE) {
+
+      WARNF("Unable to read '%s'", f->path);
+
+    } else if (slot->result == CMIN_RUN_TMOUT) {
+
+      WARNF("File '%s' timed out, ignoring...", f->path);
+
+    } else if (slot->result != CMIN_RUN_OK || !slot->key_cnt) {
+
+      WARNF("File '%s' is crashing the target, ignoring...", f->path);
+
+    } else {
+
+      ids = afl_realloc((void **)&ids, slot->key_cnt * sizeof(u32));
+      if (!ids) { PFATAL("alloc"); }
+
+      for (j = 0; j < slot->key_cnt; ++j) {
+
+        ids[j] = cmin_tuple_id(&cm, slot->keys[j]);
+
+        struct cmin_tuple *t = &cm.tuples[ids[j]];
+        if (!t->cnt++) {
+
+          t->best = i;
+          best = 1;
+
+        }
+
+      }
+
+      if (best) {
+
+        f->tuples = ck_alloc(slot->key_cnt * sizeof(u32));
+        memcpy(f->tuples, ids, slot->key_cnt * sizeof(u32));
+        f->tuple_cnt = slot->key_cnt;
+
+      }
+
+    }
+
+    pthread_mutex_lock(&cm.lock);
+    cm.taken = i + 1;
+    slot->state = CMIN_SLOT_FREE;
+    pthread_cond_broadcast(&cm.cond);
+    pthread_mutex_unlock(&cm.lock);
+
+  }
+
+  for (i = 0; i < cm.task_cnt; ++i) {
+
+    pthread_join(cm.tasks[i].thread, NULL);
+
+  }
+
+  if (stop_soon) {
+
+    SAYF(cRST cLRD "\n+++ afl-showmap folder mode aborted by user +++\n" cRST);
+    exit(1);
+
+  }
+
+  if (!cm.tuple_cnt) {
+
+    FATAL("No traces obtained from the test cases, check syntax!");
+
+  }
+
+  OKF("Found %u unique tuples across %u files.", cm.tuple_cnt, cm.file_cnt);
+
+  /* Greedy set cover, from rare to common tuples. */
+
+  order = ck_alloc(cm.tuple_cnt * sizeof(u32));
+  covered = ck_alloc(((cm.tuple_cnt + 63) / 64) * sizeof(u64));
+
+  for (i = 0; i < cm.tuple_cnt; ++i) {
+
+    order[i] = i;
+
+  }
+
+  cmin_sort_tuples = cm.tuples;
+  qsort(order, cm.tuple_cnt, sizeof(u32), cmin_tuple_cmp);
+
+  for (i = 0; i < cm.tuple_cnt; ++i) {
+
+    u32 id = order[i];
+
+    if (covered[id >> 6] & (1ULL << (id & 63))) { continue; }
+
+    struct cmin_file *f = &cm.files[cm.tuples[id].best];
+
+    for (j = 0; j < f->tuple_cnt; ++j) {
+
+      covered[f->tuples[j] >> 6] |= 1ULL << (f->tuples[j] & 63);
+
+    }
+
+    if (!f->taken) {
+
+      f->taken = 1;
+      out_cnt += cmin_copy(&cm, f);
+
+    }
+
+  }
+
+  if (out_cnt == 1) {
+
+    WARNF("All test cases had the same traces, check syntax!");
+
+  }
+
+  OKF("Narrowed down to %u files, saved in '%s'.", out_cnt, out_file);
+
+  /* Task 0 is the main forkserver, at_exit_handler() takes care of it. */
+
+  for (i = 1; i < cm.task_cnt; ++i) {
+
+    struct cmin_task *t = &cm.tasks[i];
+
+    afl_fsrv_deinit(&t->own);
+    afl_shm_deinit(&t->shm);
+
+    if (t->shm_fuzz.map) {
+
+      afl_shm_deinit(&t->shm_fuzz);
+
+    } else {
+
+      close(t->own.out_fd);
+      unlink(t->in_file);
+      ck_free(t->in_file);
+
+    }
+
+  }
+
+  for (i = 0; i < cm.task_cnt; ++i) {
+
+    afl_free(cm.tasks[i].buf);
+
+  }
+
+  for (i = 0; i < cm.window; ++i) {
+
+    afl_free(cm.slots[i].keys);
+
+  }
+
+  for (i = 0; i < cm.file_cnt; ++i) {
+
+    if (cm.pack_fd >= 0) { ck_free(cm.files[i].name); }
+    ck_free(cm.files[i].path);
+    ck_free(cm.files[i].tuples);
+
+  }
+
+  pthread_mutex_destroy(&cm.lock);
+  pthread_cond_destroy(&cm.cond);
+
+  afl_free(ids);
+  afl_free(cm.files);
+  afl_free(cm.tuples);
+  ck_free(cm.hash);
+  ck_free(cm.slots);
+  ck_free(cm.tasks);
+  ck_free(order);
+  ck_free(covered);
+
+  if (cm.pack_fd >= 0) {
+
+    close(cm.pack_fd);
+    close(cm.pack_idx_fd);
+
+  }
+
+}
+
 /* Show banner. */
 
 static void show_banner(void) {
@@ -1026,10 +1960,16 @@ static void usage(u8 *argv0) {
       "               With -C, -o is a file, without -C it must be a "
       "directory\n"
       "               and each bitmap will be written there individually.\n"
+      "               A packed corpus (e.g. queue.pack) can be given instead.\n"
       "  -I filelist - alternatively to -i, -I is a list of files\n"
       "  -C         - collect coverage, writes all edges to -o and gives a "
       "summary\n"
       "               Must be combined with -i.\n"
+      "  -M         - minimize the corpus in -i like afl-cmin, the smallest "
+      "input for\n"
+      "               every tuple is linked or copied to the -o directory\n"
+      "  -T tasks   - with -M, how many inputs to run in parallel (default: "
+      "1, all=nproc)\n"
       "  -q         - sink program's output and don't show messages\n"
       "  -e         - show edge coverage only, ignore hit counts\n"
       "  -r         - show real tuple values instead of AFL filter values\n"
@@ -1101,7 +2041,7 @@ int main(int argc, char **argv_orig, char **envp) {
 
   if (getenv("AFL_QUIET") != NULL) { be_quiet = true; }
 
-  while ((opt = getopt(argc, argv, "+i:I:o:f:m:t:AeqCZOH:QUWbcrshXY")) > 0) {
+  while ((opt = getopt(argc, argv, "+i:I:o:f:m:t:T:AeqCMZOH:QUWbcrshXY")) > 0) {
 
     switch (opt) {
 
@@ -1236,6 +2176,30 @@ int main(int argc, char **argv_orig, char **envp) {
         quiet_mode = true;
         break;
 
+      case 'M':
+        minimize_mode = true;
+        quiet_mode = true;
+        break;
+
+      case 'T':
+        if (!strcmp(optarg, "all")) {
+
+          cmin_tasks = MIN(sysconf(_SC_NPROCESSORS_ONLN), CMIN_TASKS_MAX);
+
+        } else {
+
+          cmin_tasks = atoi(optarg);
+
+        }
+
+        if (cmin_tasks < 1 || cmin_tasks > CMIN_TASKS_MAX) {
+
+          FATAL("-T must be between 1 and %u or \"all\"", CMIN_TASKS_MAX);
+
+        }
+
+        break;
+
       case 'Z':
 
         /* This is an undocumented option to write data in the syntax expected
@@ -1350,6 +2314,12 @@ int main(int argc, char **argv_orig, char **envp) {
 
   if (in_dir && in_filelist) { FATAL("you can only specify either -i or -I"); }
 
+  if (minimize_mode && (!in_dir || collect_coverage)) {
+
+    FATAL("-M needs -i and cannot be combined with -C");
+
+  }
+
   if (in_dir || in_filelist) {
 
     if (!out_file && !collect_coverage)
@@ -1651,10 +2621,10 @@ int main(int argc, char **argv_orig, char **envp) {
 
     } else {
 
-      // if a queue subdirectory exists switch to that
+      // if a queue subdirectory exists switch to that, afl-cmin does not
       dn = alloc_printf("%s/queue", in_dir);
 
-      if ((dir_in = opendir(dn)) != NULL) {
+      if (!minimize_mode && (dir_in = opendir(dn)) != NULL) {
 
         closedir(dir_in);
         in_dir = dn;
@@ -1711,7 +2681,20 @@ int main(int argc, char **argv_orig, char **envp) {
 
     }
 
-    if (in_dir) {
+    if (minimize_mode) {
+
+      cmin_corpus(use_argv);
+
+    } else if (in_dir && strlen(in_dir) > 5 &&
+               !strcmp(in_dir + strlen(in_dir) - 5, ".pack")) {
+
+      if (execute_testcases_pack(in_dir) == 0) {
+
+        FATAL("could not read input testcases from %s", in_dir);
+
+      }
+
+    } else if (in_dir) {
 
       if (execute_testcases(in_dir) == 0) {
 
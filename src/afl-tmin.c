@@ -37,6 +37,7 @@
 #include "forkserver.h"
 #include "sharedmem.h"
 #include "common.h"
+#include "afl-pack.h"
 
 #include <stdio.h>
 #include <unistd.h>
@@ -48,6 +49,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include <sys/wait.h>
 #include <sys/time.h>
@@ -214,6 +216,23 @@ static void at_exit_handler(void) {
 
 static void read_initial_file(void) {
 
+  /* A record of a packed corpus, given as queue.pack:<nr> */
+
+  if ((in_data = afl_pack_load_spec(in_file, &in_len))) {
+
+    if (!in_len) { FATAL("Zero-sized input file."); }
+    if (in_len >= TMIN_MAX_FILE) {
+
+      FATAL("Input file is too large (%ld MB max)",
+            TMIN_MAX_FILE / 1024 / 1024);
+
+    }
+
+    OKF("Read %u byte%s from '%s'.", in_len, in_len == 1 ? "" : "s", in_file);
+    return;
+
+  }
+
   struct stat st;
   s32         fd = open(in_file, O_RDONLY);
 
@@ -258,11 +277,24 @@ static s32 write_to_file(u8 *path, u8 *mem, u32 len) {
 
 }
 
-/* Execute target application. Returns 0 if the changes are a dud, or
-   1 if they should be kept. */
+/* Save what we have and leave if the user asked us to stop. */
 
-static u8 tmin_run_target(afl_forkserver_t *fsrv, u8 *mem, u32 len,
-                          u8 first_run) {
+static void tmin_check_stop(void) {
+
+  if (!stop_soon) { return; }
+
+  SAYF(cRST cLRD "\n+++ Minimization aborted by user +++\n" cRST);
+  close(write_to_file(output_file, in_data, in_len));
+  exit(1);
+
+}
+
+/* Execute target application and leave the classified trace in trace_bits
+   and its checksum in *cksum. Does not touch any global state apart from
+   fsrv, so the tasks can run it on their own forkservers. */
+
+static fsrv_run_result_t tmin_exec(afl_forkserver_t *fsrv, u8 *mem, u32 len,
+                                   u64 *cksum) {
 
   afl_fsrv_write_to_testcase(fsrv, mem, len);
 
@@ -271,14 +303,25 @@ static u8 tmin_run_target(afl_forkserver_t *fsrv, u8 *mem, u32 len,
 
   if (ret == FSRV_RUN_ERROR) { FATAL("Couldn't run child"); }
 
-  if (stop_soon) {
+  /* In hang mode only the result counts. */
 
-    SAYF(cRST cLRD "\n+++ Minimization aborted by user +++\n" cRST);
-    close(write_to_file(output_file, in_data, in_len));
-    exit(1);
+  if (!hang_mode) {
+
+    classify_counts(fsrv);
+    apply_mask((u32 *)fsrv->trace_bits, (u32 *)mask_bitmap);
+    *cksum = hash64(fsrv->trace_bits, fsrv->map_size, HASH_CONST);
 
   }
 
+  return ret;
+
+}
+
+/* Judge the result of tmin_exec(). Returns 0 if the changes are a dud, or
+   1 if they should be kept. */
+
+static u8 tmin_judge(fsrv_run_result_t ret, u64 cksum, u8 first_run) {
+
   /* Always discard inputs that time out, unless we are in hang mode */
 
   if (hang_mode) {
@@ -298,9 +341,6 @@ static u8 tmin_run_target(afl_forkserver_t *fsrv, u8 *mem, u32 len,
 
   }
 
-  classify_counts(fsrv);
-  apply_mask((u32 *)fsrv->trace_bits, (u32 *)mask_bitmap);
-
   if (ret == FSRV_RUN_TMOUT) {
 
     missed_hangs++;
@@ -340,8 +380,6 @@ static u8 tmin_run_target(afl_forkserver_t *fsrv, u8 *mem, u32 len,
 
   if (ret == FSRV_RUN_NOINST) { FATAL("Binary not instrumented?"); }
 
-  u64 cksum = hash64(fsrv->trace_bits, fsrv->map_size, HASH_CONST);
-
   if (first_run) { orig_cksum = cksum; }
 
   if (orig_cksum == cksum) { return 1; }
@@ -351,242 +389,889 @@ static u8 tmin_run_target(afl_forkserver_t *fsrv, u8 *mem, u32 len,
 
 }
 
-/* Actually minimize! */
+/* Execute target application. Returns 0 if the changes are a dud, or
+   1 if they should be kept. */
 
-static void minimize(afl_forkserver_t *fsrv) {
+static u8 tmin_run_target(afl_forkserver_t *fsrv, u8 *mem, u32 len,
+                          u8 first_run) {
 
-  static u32 alpha_map[256];
+  u64 cksum = 0;
 
-  u8 *tmp_buf = ck_alloc_nozero(in_len);
-  u32 orig_len = in_len, stage_o_len;
+  fsrv_run_result_t ret = tmin_exec(fsrv, mem, len, &cksum);
 
-  u32 del_len, set_len, del_pos, set_pos, i, alpha_size, cur_pass = 0;
-  u32 syms_removed, alpha_del0 = 0, alpha_del1, alpha_del2, alpha_d_total = 0;
-  u8  changed_any, prev_del;
+  tmin_check_stop();
 
-  /***********************
-   * BLOCK NORMALIZATION *
-   ***********************/
+  return tmin_judge(ret, cksum, first_run);
 
-  set_len = next_pow2(in_len / TMIN_SET_STEPS);
-  set_pos = 0;
+}
 
-  if (set_len < TMIN_SET_MIN_SIZE) { set_len = TMIN_SET_MIN_SIZE; }
+/*
+ * parallel minimization
+ */
 
-  ACTF(cBRI "Stage #0: " cRST "One-time block normalization...");
+/* Every stage of minimize() walks over its candidates in a fixed order and
+   keeps a candidate if the target still behaves the same. With -T the
+   candidates are run ahead on several forkservers, as if all candidates
+   in flight failed. The results are taken in the order of the candidates,
+   and when one is kept, everything that was run behind it is discarded
+   and the stage goes on from there. That makes the result the same as
+   with a single forkserver. With -F the first candidate that is kept by
+   completion time wins instead, candidates in front of it that are still
+   running are taken as failures. */
 
-  while (set_pos < in_len) {
+enum {
 
-    u32 use_len = MIN(set_len, in_len - set_pos);
+  /* 00 */ TMIN_STAGE_NORM,                /* Block normalization           */
+  /* 01 */ TMIN_STAGE_DEL,                 /* Block deletion                */
+  /* 02 */ TMIN_STAGE_ALPHA,               /* Alphabet minimization         */
+  /* 03 */ TMIN_STAGE_CHAR                 /* Character minimization        */
 
-    for (i = 0; i < use_len; i++) {
+};
 
-      if (in_data[set_pos + i] != '0') { break; }
+enum {
 
-    }
+  /* 00 */ TMIN_JOB_RUNNING,
+  /* 01 */ TMIN_JOB_DONE,
+  /* 02 */ TMIN_JOB_FAILED                 /* Judged, not kept (-F)         */
+
+};
+
+enum {
+
+  /* 00 */ TMIN_TASK_IDLE,
+  /* 01 */ TMIN_TASK_QUEUED,
+  /* 02 */ TMIN_TASK_RUNNING
+
+};
+
+struct tmin_step {
+
+  u32 pos;                              /* Offset, or symbol for alphabet   */
+  u32 len;                              /* Block length                     */
+  u8  prev_del;                         /* Previous block was deleted       */
+  u8  level;                            /* First block of a block length    */
+
+};
+
+struct tmin_stage {
+
+  u8               type;                /* TMIN_STAGE_*                     */
+  u8               exhausted;           /* No candidates left               */
+  u32              set_len;             /* Block size for normalization     */
+  u32              kept;                /* Candidates kept                  */
+  u32              bytes;               /* Bytes replaced                   */
+  struct tmin_step cur;                 /* Next candidate if all fail       */
+
+};
+
+struct tmin_job {
+
+  struct tmin_step  step;
+  u32               seq;
+  u8                state;              /* TMIN_JOB_*                       */
+  fsrv_run_result_t ret;
+  u64               cksum;
+
+};
+
+struct tmin_task {
+
+  afl_forkserver_t *fsrv;
+  afl_forkserver_t  own;                /* Unless it is the main forkserver */
+  sharedmem_t       shm, shm_fuzz;
+  u8               *in_file;            /* Input file of own                */
+  u8               *buf;                /* Candidate                        */
+  u32               len;
+  u32               seq, epoch;         /* Job that is run                  */
+  u8                state;              /* TMIN_TASK_*                      */
+  pthread_t         thread;
+
+};
+
+static struct tmin_task *tasks;
+static struct tmin_job  *jobs;
+
+static u32 task_cnt = 1,               /* -T, number of forkservers         */
+    job_window,                        /* Candidates that may be in flight  */
+    next_seq,                          /* Next candidate to hand out        */
+    done_seq,                          /* Oldest candidate not taken yet    */
+    epoch;                             /* Bumped when in_data changes       */
+
+static u8 first_success,               /* -F, keep the first one that ends  */
+    tasks_stop;                        /* Tell the tasks to leave           */
+
+static u32 alpha_map[256];             /* Symbol counts of in_data          */
+
+static pthread_mutex_t tmin_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  tmin_cond = PTHREAD_COND_INITIALIZER;
+
+static void tmin_stage_init(struct tmin_stage *st, u8 type, u32 len) {
+
+  memset(st, 0, sizeof(struct tmin_stage));
+
+  st->type = type;
+
+  if (type == TMIN_STAGE_NORM) {
+
+    st->set_len = len;
+
+  } else if (type == TMIN_STAGE_DEL) {
+
+    st->cur.len = len;
+    st->cur.prev_del = 1;
+    st->cur.level = 1;
+
+  }
+
+}
+
+/* Take the next candidate of the stage into *step, assuming that all
+   candidates before it fail. Returns 0 if there are none left. */
+
+static u8 tmin_next(struct tmin_stage *st, struct tmin_step *step) {
+
+  struct tmin_step *cur = &st->cur;
+  u32               i;
+
+  memset(step, 0, sizeof(struct tmin_step));
+
+  switch (st->type) {
+
+    case TMIN_STAGE_NORM:
+
+      while (cur->pos < in_len) {
+
+        u32 use_len = MIN(st->set_len, in_len - cur->pos);
+
+        for (i = 0; i < use_len; i++) {
+
+          if (in_data[cur->pos + i] != '0') { break; }
+
+        }
+
+        if (i != use_len) {
+
+          *step = *cur;
+          step->len = use_len;
+          cur->pos += st->set_len;
+          return 1;
+
+        }
+
+        cur->pos += st->set_len;
+
+      }
+
+      return 0;
+
+    case TMIN_STAGE_DEL:
+
+      while (1) {
+
+        if (cur->pos < in_len) {
+
+          s32 tail_len = in_len - cur->pos - cur->len;
+          if (tail_len < 0) { tail_len = 0; }
+
+          /* If we have processed at least one full block (initially,
+             prev_del == 1), and we did so without deleting the previous
+             one, and we aren't at the very end of the buffer (tail_len > 0),
+             and the current block is the same as the previous one... skip
+             this step as a no-op. */
+
+          if (!cur->prev_del && tail_len &&
+              !memcmp(in_data + cur->pos - cur->len, in_data + cur->pos,
+                      cur->len)) {
+
+            cur->pos += cur->len;
+            continue;
+
+          }
+
+          *step = *cur;
+          cur->prev_del = 0;
+          cur->level = 0;
+          cur->pos += cur->len;
+          return 1;
+
+        }
+
+        /* Only possible when we start with nothing left. */
 
-    if (i != use_len) {
+        if (cur->level) {
 
-      memcpy(tmp_buf, in_data, in_len);
-      memset(tmp_buf + set_pos, '0', use_len);
+          SAYF(cGRA "    Block length = %u, remaining size = %u\n" cRST,
+               cur->len, in_len);
 
-      u8 res;
-      res = tmin_run_target(fsrv, tmp_buf, in_len, 0);
+        }
+
+        if (cur->len > del_len_limit && in_len >= 1) {
+
+          cur->len /= 2;
+          cur->pos = 0;
+          cur->prev_del = 1;
+          cur->level = 1;
+          continue;
+
+        }
+
+        return 0;
+
+      }
+
+    case TMIN_STAGE_ALPHA:
+
+      while (cur->pos < 256) {
+
+        u32 sym = cur->pos++;
 
-      if (res) {
+        if (sym != '0' && alpha_map[sym]) {
 
-        memset(in_data + set_pos, '0', use_len);
-        /*        changed_any = 1; value is not used */
-        alpha_del0 += use_len;
+          step->pos = sym;
+          return 1;
+
+        }
 
       }
 
+      return 0;
+
+    case TMIN_STAGE_CHAR:
+
+      while (cur->pos < in_len) {
+
+        u32 pos = cur->pos++;
+
+        if (in_data[pos] != '0') {
+
+          step->pos = pos;
+          return 1;
+
+        }
+
+      }
+
+      return 0;
+
+  }
+
+  return 0;
+
+}
+
+/* Build the candidate for step from in_data into buf, returns its
+   length. */
+
+static u32 tmin_build(struct tmin_stage *st, struct tmin_step *step,
+                      u8 *buf) {
+
+  u32 r;
+
+  switch (st->type) {
+
+    case TMIN_STAGE_NORM:
+
+      memcpy(buf, in_data, in_len);
+      memset(buf + step->pos, '0', step->len);
+      return in_len;
+
+    case TMIN_STAGE_DEL: {
+
+      s32 tail_len = in_len - step->pos - step->len;
+      if (tail_len < 0) { tail_len = 0; }
+
+      /* Head */
+      memcpy(buf, in_data, step->pos);
+
+      /* Tail */
+      memcpy(buf + step->pos, in_data + step->pos + step->len, tail_len);
+
+      return step->pos + tail_len;
+
     }
 
-    set_pos += set_len;
+    case TMIN_STAGE_ALPHA:
+
+      memcpy(buf, in_data, in_len);
+
+      for (r = 0; r < in_len; r++) {
+
+        if (buf[r] == step->pos) { buf[r] = '0'; }
+
+      }
+
+      return in_len;
+
+    default:
+
+      memcpy(buf, in_data, in_len);
+      buf[step->pos] = '0';
+      return in_len;
 
   }
 
-  alpha_d_total += alpha_del0;
+}
 
-  OKF("Block normalization complete, %u byte%s replaced.", alpha_del0,
-      alpha_del0 == 1 ? "" : "s");
+/* Apply the kept candidate step to in_data and go on behind it. */
 
-next_pass:
+static void tmin_keep(struct tmin_stage *st, struct tmin_step *step) {
 
-  ACTF(cYEL "--- " cBRI "Pass #%u " cYEL "---", ++cur_pass);
-  changed_any = 0;
+  u32 r;
 
-  /******************
-   * BLOCK DELETION *
-   ******************/
+  ++st->kept;
 
-  del_len = next_pow2(in_len / TRIM_START_STEPS);
-  stage_o_len = in_len;
+  switch (st->type) {
 
-  ACTF(cBRI "Stage #1: " cRST "Removing blocks of data...");
+    case TMIN_STAGE_NORM:
 
-next_del_blksize:
+      memset(in_data + step->pos, '0', step->len);
+      st->bytes += step->len;
+      st->cur.pos = step->pos + st->set_len;
+      break;
 
-  if (!del_len) { del_len = 1; }
-  del_pos = 0;
-  prev_del = 1;
+    case TMIN_STAGE_DEL: {
+
+      s32 tail_len = in_len - step->pos - step->len;
+      if (tail_len < 0) { tail_len = 0; }
+
+      memmove(in_data + step->pos, in_data + step->pos + step->len, tail_len);
+      in_len = step->pos + tail_len;
+
+      st->cur = *step;
+      st->cur.prev_del = 1;
+      st->cur.level = 0;
+      break;
+
+    }
+
+    case TMIN_STAGE_ALPHA:
+
+      for (r = 0; r < in_len; r++) {
+
+        if (in_data[r] == step->pos) { in_data[r] = '0'; }
+
+      }
+
+      st->bytes += alpha_map[step->pos];
+      st->cur.pos = step->pos + 1;
+      break;
+
+    default:
+
+      in_data[step->pos] = '0';
+      ++st->bytes;
+      st->cur.pos = step->pos + 1;
+      break;
+
+  }
+
+  st->exhausted = 0;
+
+}
+
+/* The stage is past the candidate of job. */
+
+static void tmin_pass(struct tmin_job *job) {
+
+  if (job->step.level) {
 
-  SAYF(cGRA "    Block length = %u, remaining size = %u\n" cRST, del_len,
-       in_len);
+    SAYF(cGRA "    Block length = %u, remaining size = %u\n" cRST,
+         job->step.len, in_len);
 
-  while (del_pos < in_len) {
+  }
+
+}
+
+/* Run the candidate of task t and leave the result in its job, unless the
+   job was discarded in the meantime. Called with tmin_lock held. */
+
+static void tmin_task_run(struct tmin_task *t) {
+
+  struct tmin_job  *job = &jobs[t->seq % job_window];
+  fsrv_run_result_t ret;
+  u64               cksum = 0;
+
+  t->state = TMIN_TASK_RUNNING;
+
+  if (task_cnt > 1) { pthread_mutex_unlock(&tmin_lock); }
+  ret = tmin_exec(t->fsrv, t->buf, t->len, &cksum);
+  if (task_cnt > 1) { pthread_mutex_lock(&tmin_lock); }
+
+  if (t->epoch == epoch && job->seq == t->seq) {
+
+    job->ret = ret;
+    job->cksum = cksum;
+    job->state = TMIN_JOB_DONE;
+
+  }
+
+  t->state = TMIN_TASK_IDLE;
+
+}
 
-    u8  res;
-    s32 tail_len;
+static void *tmin_task_main(void *arg) {
 
-    tail_len = in_len - del_pos - del_len;
-    if (tail_len < 0) { tail_len = 0; }
+  struct tmin_task *t = arg;
 
-    /* If we have processed at least one full block (initially, prev_del == 1),
-       and we did so without deleting the previous one, and we aren't at the
-       very end of the buffer (tail_len > 0), and the current block is the same
-       as the previous one... skip this step as a no-op. */
+  pthread_mutex_lock(&tmin_lock);
 
-    if (!prev_del && tail_len &&
-        !memcmp(in_data + del_pos - del_len, in_data + del_pos, del_len)) {
+  while (!tasks_stop) {
 
-      del_pos += del_len;
+    if (t->state != TMIN_TASK_QUEUED) {
+
+      pthread_cond_wait(&tmin_cond, &tmin_lock);
       continue;
 
     }
 
-    prev_del = 0;
+    tmin_task_run(t);
+    pthread_cond_broadcast(&tmin_cond);
+
+  }
+
+  pthread_mutex_unlock(&tmin_lock);
+  return NULL;
+
+}
 
-    /* Head */
-    memcpy(tmp_buf, in_data, del_pos);
+/* Take the results that are done. Returns 1 if any was taken. */
 
-    /* Tail */
-    memcpy(tmp_buf + del_pos, in_data + del_pos + del_len, tail_len);
+static u8 tmin_take(struct tmin_stage *st) {
 
-    res = tmin_run_target(fsrv, tmp_buf, del_pos + tail_len, 0);
+  struct tmin_job *job;
+  u32              seq, kept_seq = 0;
+  u8               kept = 0, taken = 0;
 
-    if (res) {
+  if (!first_success) {
 
-      memcpy(in_data, tmp_buf, del_pos + tail_len);
-      prev_del = 1;
-      in_len = del_pos + tail_len;
+    /* In order, the first one that is kept ends the run. */
 
-      changed_any = 1;
+    while (done_seq < next_seq) {
 
-    } else {
+      job = &jobs[done_seq % job_window];
+      if (job->state != TMIN_JOB_DONE) { break; }
 
-      del_pos += del_len;
+      taken = 1;
+      tmin_pass(job);
+
+      if (tmin_judge(job->ret, job->cksum, 0)) {
+
+        kept = 1;
+        kept_seq = done_seq;
+        break;
+
+      }
+
+      ++done_seq;
+
+    }
+
+  } else {
+
+    for (seq = done_seq; seq < next_seq; ++seq) {
+
+      job = &jobs[seq % job_window];
+      if (job->state != TMIN_JOB_DONE) { continue; }
+
+      taken = 1;
+
+      if (tmin_judge(job->ret, job->cksum, 0)) {
+
+        kept = 1;
+        kept_seq = seq;
+        break;
+
+      }
+
+      job->state = TMIN_JOB_FAILED;
+
+    }
+
+    /* Whatever is still running in front of the kept one counts as
+       failed. */
+
+    while (done_seq < next_seq) {
+
+      job = &jobs[done_seq % job_window];
+      if (!kept && job->state != TMIN_JOB_FAILED) { break; }
+
+      tmin_pass(job);
+      if (kept && done_seq == kept_seq) { break; }
+      ++done_seq;
 
     }
 
   }
 
-  if (del_len > del_len_limit && in_len >= 1) {
+  if (kept) {
 
-    del_len /= 2;
-    goto next_del_blksize;
+    /* The candidates behind it were built from the old in_data. */
+
+    tmin_keep(st, &jobs[kept_seq % job_window].step);
+    ++epoch;
+    done_seq = next_seq;
 
   }
 
-  OKF("Block removal complete, %u bytes deleted.", stage_o_len - in_len);
+  return taken;
 
-  if (!in_len && changed_any) {
+}
 
-    WARNF(cLRD
-          "Down to zero bytes - check the command line and mem limit!" cRST);
+/* Run one stage of minimize() on the tasks. Returns 1 if anything was
+   changed. */
+
+static u8 tmin_stage_run(struct tmin_stage *st) {
+
+  u32 i;
+  u8  progress;
+
+  pthread_mutex_lock(&tmin_lock);
+
+  while (1) {
+
+    progress = 0;
+
+    /* Hand out candidates to the idle tasks. */
+
+    for (i = 0; i < task_cnt && !st->exhausted; ++i) {
+
+      struct tmin_task *t = &tasks[i];
+      struct tmin_job  *job;
+
+      if (t->state != TMIN_TASK_IDLE) { continue; }
+      if (next_seq - done_seq >= job_window) { break; }
+
+      job = &jobs[next_seq % job_window];
+
+      if (!tmin_next(st, &job->step)) {
+
+        st->exhausted = 1;
+        break;
+
+      }
+
+      job->seq = next_seq;
+      job->state = TMIN_JOB_RUNNING;
+
+      t->len = tmin_build(st, &job->step, t->buf);
+      t->seq = next_seq++;
+      t->epoch = epoch;
+      t->state = TMIN_TASK_QUEUED;
+
+      if (task_cnt == 1) { tmin_task_run(t); }
+      progress = 1;
+
+    }
+
+    if (progress && task_cnt > 1) { pthread_cond_broadcast(&tmin_cond); }
+
+    if (tmin_take(st)) { progress = 1; }
+
+    if (stop_soon) {
+
+      pthread_mutex_unlock(&tmin_lock);
+      tmin_check_stop();
+
+    }
+
+    if (st->exhausted && done_seq == next_seq) { break; }
+
+    if (!progress) { pthread_cond_wait(&tmin_cond, &tmin_lock); }
 
   }
 
-  if (cur_pass > 1 && !changed_any) { goto finalize_all; }
+  /* Let the discarded candidates finish before anyone looks at the
+     forkservers. */
 
-  /*************************
-   * ALPHABET MINIMIZATION *
-   *************************/
+  for (i = 0; i < task_cnt; ++i) {
 
-  alpha_size = 0;
-  alpha_del1 = 0;
-  syms_removed = 0;
+    while (tasks[i].state != TMIN_TASK_IDLE) {
 
-  memset(alpha_map, 0, sizeof(alpha_map));
+      pthread_cond_wait(&tmin_cond, &tmin_lock);
 
-  for (i = 0; i < in_len; i++) {
+    }
 
-    if (!alpha_map[in_data[i]]) { alpha_size++; }
-    alpha_map[in_data[i]]++;
+  }
+
+  pthread_mutex_unlock(&tmin_lock);
+
+  return st->kept > 0;
+
+}
+
+/* Give task nr its own trace map, input and forkserver. */
+
+static void tmin_task_init(struct tmin_task *t, u32 nr, char **argv) {
+
+  if (!fsrv->use_shmem_fuzz) {
+
+    t->in_file = alloc_printf("%s.%u", out_file, nr);
 
   }
 
-  ACTF(cBRI "Stage #2: " cRST "Minimizing symbols (%u code point%s)...",
-       alpha_size, alpha_size == 1 ? "" : "s");
+  afl_fsrv_start_helper(&t->own, fsrv, &t->shm, &t->shm_fuzz, t->in_file,
+                        out_file, argv, &stop_soon,
+                        (get_afl_env("AFL_DEBUG_CHILD") ||
+                         get_afl_env("AFL_DEBUG_CHILD_OUTPUT"))
+                            ? 1
+                            : 0);
+
+  t->fsrv = &t->own;
+
+}
 
-  for (i = 0; i < 256; i++) {
+/* Returns 1 if the target can be run on several forkservers. */
 
-    u32 r;
-    u8  res;
+static u8 tmin_tasks_possible(char **argv) {
 
-    if (i == '0' || !alpha_map[i]) { continue; }
+  u8 *reason = NULL;
 
-    memcpy(tmp_buf, in_data, in_len);
+  if (fsrv->nyx_mode || fsrv->use_fauxsrv) {
 
-    for (r = 0; r < in_len; r++) {
+    reason = "this mode";
 
-      if (tmp_buf[r] == i) { tmp_buf[r] = '0'; }
+  } else if (!fsrv->use_shmem_fuzz && !fsrv->use_stdin) {
+
+    char **probe = afl_fsrv_argv_replace(argv, out_file, out_file);
+    if (!probe) { reason = "an input file that is not on the command line"; }
+    afl_fsrv_argv_free(probe, argv);
+
+  }
+
+  if (reason) { WARNF("-T is not supported with %s, using one task.", reason); }
+  return !reason;
+
+}
+
+/* Get rid of the inputs and maps of the tasks if we are stopped while
+   minimizing (atexit handler). */
+
+static void tmin_tasks_atexit(void) {
+
+  if (!tasks) { return; }
+
+  for (u32 i = 1; i < task_cnt; ++i) {
+
+    if (tasks[i].in_file) { unlink(tasks[i].in_file); }
+
+    if (remove_shm) {
+
+      if (tasks[i].shm.map) { afl_shm_deinit(&tasks[i].shm); }
+      if (tasks[i].shm_fuzz.map) { afl_shm_deinit(&tasks[i].shm_fuzz); }
 
     }
 
-    res = tmin_run_target(fsrv, tmp_buf, in_len, 0);
+  }
+
+}
+
+/* Set up the tasks for minimize(), argv is the target argv of the main
+   forkserver. */
+
+static void tmin_tasks_start(char **argv) {
+
+  u32 i;
+
+  if (task_cnt > 1 && !tmin_tasks_possible(argv)) { task_cnt = 1; }
+
+  job_window = task_cnt * TMIN_TASK_AHEAD;
+  jobs = ck_alloc(job_window * sizeof(struct tmin_job));
+  tasks = ck_alloc(task_cnt * sizeof(struct tmin_task));
+
+  atexit(tmin_tasks_atexit);
+
+  if (task_cnt > 1) {
+
+    ACTF("Spinning up %u forkservers%s...", task_cnt,
+         first_success ? ", keeping the first success" : "");
+
+  }
+
+  u8 save_be_quiet = be_quiet;
+  be_quiet = !debug;
+
+  for (i = 0; i < task_cnt; ++i) {
+
+    tasks[i].buf = ck_alloc_nozero(in_len);
+
+    if (i) {
 
-    if (res) {
+      tmin_task_init(&tasks[i], i, argv);
 
-      memcpy(in_data, tmp_buf, in_len);
-      syms_removed++;
-      alpha_del1 += alpha_map[i];
-      changed_any = 1;
+    } else {
+
+      tasks[i].fsrv = fsrv;
 
     }
 
   }
 
-  alpha_d_total += alpha_del1;
+  be_quiet = save_be_quiet;
 
-  OKF("Symbol minimization finished, %u symbol%s (%u byte%s) replaced.",
-      syms_removed, syms_removed == 1 ? "" : "s", alpha_del1,
-      alpha_del1 == 1 ? "" : "s");
+  for (i = 0; task_cnt > 1 && i < task_cnt; ++i) {
 
-  /**************************
-   * CHARACTER MINIMIZATION *
-   **************************/
+    if (pthread_create(&tasks[i].thread, NULL, tmin_task_main, &tasks[i])) {
 
-  alpha_del2 = 0;
+      PFATAL("pthread_create() failed");
 
-  ACTF(cBRI "Stage #3: " cRST "Character minimization...");
+    }
 
-  memcpy(tmp_buf, in_data, in_len);
+  }
 
-  for (i = 0; i < in_len; i++) {
+}
+
+static void tmin_tasks_stop(void) {
 
-    u8 res, orig = tmp_buf[i];
+  u32 i;
 
-    if (orig == '0') { continue; }
-    tmp_buf[i] = '0';
+  if (task_cnt > 1) {
 
-    res = tmin_run_target(fsrv, tmp_buf, in_len, 0);
+    pthread_mutex_lock(&tmin_lock);
+    tasks_stop = 1;
+    pthread_cond_broadcast(&tmin_cond);
+    pthread_mutex_unlock(&tmin_lock);
 
-    if (res) {
+    for (i = 0; i < task_cnt; ++i) {
 
-      in_data[i] = '0';
-      alpha_del2++;
-      changed_any = 1;
+      pthread_join(tasks[i].thread, NULL);
+
+    }
+
+  }
+
+  /* Task 0 is the main forkserver, at_exit_handler() takes care of it. */
+
+  for (i = 1; i < task_cnt; ++i) {
+
+    struct tmin_task *t = &tasks[i];
+
+    afl_fsrv_deinit(&t->own);
+    afl_shm_deinit(&t->shm);
+
+    if (t->shm_fuzz.map) {
+
+      afl_shm_deinit(&t->shm_fuzz);
 
     } else {
 
-      tmp_buf[i] = orig;
+      close(t->own.out_fd);
+      unlink(t->in_file);
+      ck_free(t->in_file);
 
     }
 
   }
 
+  for (i = 0; i < task_cnt; ++i) {
+
+    ck_free(tasks[i].buf);
+
+  }
+
+  ck_free(tasks);
+  ck_free(jobs);
+  tasks = NULL;
+
+}
+
+/* Actually minimize! */
+
+static void minimize(afl_forkserver_t *fsrv) {
+
+  struct tmin_stage st;
+
+  u32 orig_len = in_len, stage_o_len;
+
+  u32 del_len, set_len, i, alpha_size, cur_pass = 0;
+  u32 alpha_del0, alpha_del1, alpha_del2, alpha_d_total = 0;
+  u8  changed_any;
+
+  /***********************
+   * BLOCK NORMALIZATION *
+   ***********************/
+
+  set_len = next_pow2(in_len / TMIN_SET_STEPS);
+
+  if (set_len < TMIN_SET_MIN_SIZE) { set_len = TMIN_SET_MIN_SIZE; }
+
+  ACTF(cBRI "Stage #0: " cRST "One-time block normalization...");
+
+  tmin_stage_init(&st, TMIN_STAGE_NORM, set_len);
+  tmin_stage_run(&st);
+  alpha_del0 = st.bytes;
+
+  alpha_d_total += alpha_del0;
+
+  OKF("Block normalization complete, %u byte%s replaced.", alpha_del0,
+      alpha_del0 == 1 ? "" : "s");
+
+next_pass:
+
+  ACTF(cYEL "--- " cBRI "Pass #%u " cYEL "---", ++cur_pass);
+  changed_any = 0;
+
+  /******************
+   * BLOCK DELETION *
+   ******************/
+
+  del_len = next_pow2(in_len / TRIM_START_STEPS);
+  if (!del_len) { del_len = 1; }
+  stage_o_len = in_len;
+
+  ACTF(cBRI "Stage #1: " cRST "Removing blocks of data...");
+
+  tmin_stage_init(&st, TMIN_STAGE_DEL, del_len);
+  if (tmin_stage_run(&st)) { changed_any = 1; }
+
+  OKF("Block removal complete, %u bytes deleted.", stage_o_len - in_len);
+
+  if (!in_len && changed_any) {
+
+    WARNF(cLRD
+          "Down to zero bytes - check the command line and mem limit!" cRST);
+
+  }
+
+  if (cur_pass > 1 && !changed_any) { goto finalize_all; }
+
+  /*************************
+   * ALPHABET MINIMIZATION *
+   *************************/
+
+  alpha_size = 0;
+
+  memset(alpha_map, 0, sizeof(alpha_map));
+
+  for (i = 0; i < in_len; i++) {
+
+    if (!alpha_map[in_data[i]]) { alpha_size++; }
+    alpha_map[in_data[i]]++;
+
+  }
+
+  ACTF(cBRI "Stage #2: " cRST "Minimizing symbols (%u code point%s)...",
+       alpha_size, alpha_size == 1 ? "" : "s");
+
+  tmin_stage_init(&st, TMIN_STAGE_ALPHA, 0);
+  if (tmin_stage_run(&st)) { changed_any = 1; }
+  alpha_del1 = st.bytes;
+
+  alpha_d_total += alpha_del1;
+
+  OKF("Symbol minimization finished, %u symbol%s (%u byte%s) replaced.",
+      st.kept, st.kept == 1 ? "" : "s", alpha_del1,
+      alpha_del1 == 1 ? "" : "s");
+
+  /**************************
+   * CHARACTER MINIMIZATION *
+   **************************/
+
+  ACTF(cBRI "Stage #3: " cRST "Character minimization...");
+
+  tmin_stage_init(&st, TMIN_STAGE_CHAR, 0);
+  if (tmin_stage_run(&st)) { changed_any = 1; }
+  alpha_del2 = st.bytes;
+
   alpha_d_total += alpha_del2;
 
   OKF("Character minimization done, %u byte%s replaced.", alpha_del2,
@@ -596,7 +1281,11 @@ next_del_blksize:
 
 finalize_all:
 
-  if (tmp_buf) { ck_free(tmp_buf); }
+  for (i = 1; i < task_cnt; ++i) {
+
+    fsrv->total_execs += tasks[i].own.total_execs;
+
+  }
 
   if (hang_mode) {
 
@@ -779,6 +1468,7 @@ static void usage(u8 *argv0) {
       "Required parameters:\n"
 
       "  -i file       - input test case to be shrunk by the tool\n"
+      "                  (or a packed corpus record: queue.pack:<nr>)\n"
       "  -o file       - final output location for the minimized data\n\n"
 
       "Execution control settings:\n"
@@ -806,7 +1496,11 @@ static void usage(u8 *argv0) {
       "  -e            - solve for edge coverage only, ignore hit counts\n"
       "  -l bytes      - set minimum block deletion length to speed up minimization\n"
       "  -x            - treat non-zero exit codes as crashes\n"
-      "  -H            - minimize a hang (hang mode)\n\n"
+      "  -H            - minimize a hang (hang mode)\n"
+      "  -T tasks      - number of forkservers to run candidates on in\n"
+      "                  parallel, or 'all' for one per core (1)\n"
+      "  -F            - with -T, keep the first success by completion time,\n"
+      "                  faster but not deterministic\n\n"
 
       "For additional tips, please consult %s/README.md.\n\n"
 
@@ -840,7 +1534,7 @@ int main(int argc, char **argv_orig, char **envp) {
 
   s32 opt;
   u8  mem_limit_given = 0, timeout_given = 0, unicorn_mode = 0, use_wine = 0,
-     del_limit_given = 0;
+     del_limit_given = 0, tasks_given = 0;
   char **use_argv;
 
   char **argv = argv_cpy_dup(argc, argv_orig);
@@ -856,7 +1550,7 @@ int main(int argc, char **argv_orig, char **envp) {
 
   SAYF(cCYA "afl-tmin" VERSION cRST " by Michal Zalewski\n");
 
-  while ((opt = getopt(argc, argv, "+i:o:f:m:t:l:B:xeAOQUWXYHh")) > 0) {
+  while ((opt = getopt(argc, argv, "+i:o:f:m:t:l:T:B:xeAFOQUWXYHh")) > 0) {
 
     switch (opt) {
 
@@ -1083,6 +1777,35 @@ int main(int argc, char **argv_orig, char **envp) {
 
         break;
 
+      case 'T':
+
+        if (tasks_given) { FATAL("Multiple -T options not supported"); }
+        tasks_given = 1;
+
+        if (!strcmp(optarg, "all")) {
+
+          task_cnt = MIN(sysconf(_SC_NPROCESSORS_ONLN), TMIN_TASKS_MAX);
+
+        } else {
+
+          task_cnt = atoi(optarg);
+
+        }
+
+        if (task_cnt < 1 || task_cnt > TMIN_TASKS_MAX) {
+
+          FATAL("Value of -T out of range between 1 and %u", TMIN_TASKS_MAX);
+
+        }
+
+        break;
+
+      case 'F':
+
+        if (first_success) { FATAL("Multiple -F options not supported"); }
+        first_success = 1;
+        break;
+
       case 'h':
         usage(argv[0]);
         return -1;
@@ -1338,8 +2061,12 @@ int main(int argc, char **argv_orig, char **envp) {
 
   }
 
+  tmin_tasks_start(use_argv);
+
   minimize(fsrv);
 
+  tmin_tasks_stop();
+
   ACTF("Writing output to '%s'...", output_file);
 
   unlink(out_file);
@@ -0,0 +1,835 @@
+/*
+   american fuzzy lop++ - status check tool
+   ----------------------------------------
+
+   Originally written by Michal Zalewski
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2015 Google Inc. All rights reserved.
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   This tool summarizes the status of the synchronized afl-fuzz instances
+   in a sync directory. The numbers of every instance are taken from its
+   mapped fuzzer_stats.bin (see include/afl-stats-page.h), or parsed from
+   the text fuzzer_stats if there is no usable page, in a single pass that
+   starts no other processes. With -j the result is printed as JSON, with
+   -w it is refreshed every few seconds.
+
+ */
+
+#define AFL_MAIN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stddef.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "types.h"
+#include "debug.h"
+#include "alloc-inl.h"
+#include "afl-stats-page.h"
+
+enum {
+
+  /* 00 */ WU_ALIVE,
+  /* 01 */ WU_STARTING,
+  /* 02 */ WU_DEAD
+
+};
+
+struct wu_instance {
+
+  u8                    *name;
+  struct stats_page_data d;             /* Times in ms as in the page       */
+  u8                     state;         /* WU_*                             */
+  u8                     from_page;     /* Read from fuzzer_stats.bin       */
+
+};
+
+struct wu_summary {
+
+  u32    alive, starting, dead;
+  u64    run_time, execs, crashes, hangs, pending, pending_favs, last_find;
+  u64    eps, eps_last_min;
+  double coverage;
+  u8     wcop[1024];                    /* Cycles without finds, '/'-joined */
+
+};
+
+static u8 include_dead, minimal, summary_only, json;
+static char *c_red = cLRD, *c_yel = cYEL, *c_rst = cRST;
+
+/* Fields of the text fuzzer_stats we use, as in load_stats_file(). */
+
+enum {
+
+  /* 00 */ WU_U64,
+  /* 01 */ WU_U32,
+  /* 02 */ WU_DBL,
+  /* 03 */ WU_SEC,                        /* Seconds, stored as ms          */
+  /* 04 */ WU_STR
+
+};
+
+static const struct {
+
+  const char *key;
+  u32         off;
+  u8          type;
+
+} wu_fields[] = {
+
+    {"start_time", offsetof(struct stats_page_data, start_time), WU_SEC},
+    {"last_update", offsetof(struct stats_page_data, last_update), WU_SEC},
+    {"run_time", offsetof(struct stats_page_data, run_time), WU_SEC},
+    {"fuzzer_pid", offsetof(struct stats_page_data, fuzzer_pid), WU_U32},
+    {"cycles_done", offsetof(struct stats_page_data, cycles_done), WU_U64},
+    {"cycles_wo_finds", offsetof(struct stats_page_data, cycles_wo_finds),
+     WU_U64},
+    {"execs_done", offsetof(struct stats_page_data, execs_done), WU_U64},
+    {"execs_per_sec", offsetof(struct stats_page_data, execs_per_sec), WU_DBL},
+    {"execs_ps_last_min", offsetof(struct stats_page_data, execs_ps_last_min),
+     WU_DBL},
+    {"corpus_count", offsetof(struct stats_page_data, corpus_count), WU_U32},
+    {"corpus_found", offsetof(struct stats_page_data, corpus_found), WU_U32},
+    {"cur_item", offsetof(struct stats_page_data, cur_item), WU_U32},
+    {"pending_favs", offsetof(struct stats_page_data, pending_favs), WU_U32},
+    {"pending_total", offsetof(struct stats_page_data, pending_total), WU_U32},
+    {"stability", offsetof(struct stats_page_data, stability), WU_DBL},
+    {"bitmap_cvg", offsetof(struct stats_page_data, bitmap_cvg), WU_DBL},
+    {"saved_crashes", offsetof(struct stats_page_data, saved_crashes), WU_U64},
+    {"saved_hangs", offsetof(struct stats_page_data, saved_hangs), WU_U64},
+    {"last_find", offsetof(struct stats_page_data, last_find), WU_SEC},
+    {"last_crash", offsetof(struct stats_page_data, last_crash), WU_SEC},
+    {"last_hang", offsetof(struct stats_page_data, last_hang), WU_SEC},
+    {"edges_found", offsetof(struct stats_page_data, edges_found), WU_U32},
+    {"total_edges", offsetof(struct stats_page_data, total_edges), WU_U32},
+    {"afl_banner", offsetof(struct stats_page_data, banner), WU_STR},
+    {NULL, 0, 0}
+
+};
+
+static void usage(u8 *argv0) {
+
+  SAYF(
+      "%s status check tool for afl-fuzz by Michal Zalewski\n\n"
+      "Usage: %s [-d] [-m] [-n] [-s] [-j] [-w secs] afl_output_directory\n\n"
+      "Options:\n"
+      "  -d      - include dead fuzzer stats\n"
+      "  -m      - just show minimal stats\n"
+      "  -n      - no color output\n"
+      "  -s      - skip details and output summary results only\n"
+      "  -j      - print the results as JSON\n"
+      "  -w secs - watch mode, print the results every secs seconds\n\n",
+      argv0, argv0);
+  exit(1);
+
+}
+
+static u64 get_cur_time(void) {
+
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec * 1000ULL) + (tv.tv_usec / 1000);
+
+}
+
+/* Parse the text fuzzer_stats fn into d. Returns 0 on success. */
+
+static s32 read_stats_text(u8 *fn, struct stats_page_data *d) {
+
+  u8    buf[MAX_LINE];
+  FILE *f = fopen(fn, "r");
+
+  if (!f) { return -1; }
+
+  while (fgets(buf, sizeof(buf), f)) {
+
+    u8 *sep = strstr(buf, " : "), *key = buf, *val, *end;
+    if (!sep) { continue; }
+
+    /* The key is padded with blanks up to the separator. */
+
+    end = sep;
+    while (end > key && end[-1] == ' ') {
+
+      --end;
+
+    }
+
+    *end = 0;
+    val = sep + 3;
+    val[strcspn(val, "\n")] = 0;
+
+    for (u32 i = 0; wu_fields[i].key; ++i) {
+
+      if (strcmp(key, wu_fields[i].key)) { continue; }
+
+      u8 *dst = (u8 *)d + wu_fields[i].off;
+
+      switch (wu_fields[i].type) {
+
+        case WU_U64:
+          *(u64 *)dst = strtoull(val, NULL, 10);
+          break;
+        case WU_U32:
+          *(u32 *)dst = strtoul(val, NULL, 10);
+          break;
+        case WU_DBL:
+          *(double *)dst = strtod(val, NULL);
+          break;
+        case WU_SEC:
+          *(u64 *)dst = strtoull(val, NULL, 10) * 1000;
+          break;
+        case WU_STR:
+          strncpy((char *)dst, val, sizeof(d->banner) - 1);
+          break;
+
+      }
+
+      break;
+
+    }
+
+  }
+
+  fclose(f);
+  return 0;
+
+}
+
+/* Read the page fn into d if it is at least as recent as mtime (seconds).
+   Returns 0 on success. */
+
+static s32 read_stats_page(u8 *fn, struct stats_page_data *d, u64 mtime) {
+
+  struct stats_page *p;
+  struct stat        st;
+  s32                fd, ret = -1;
+
+  fd = open(fn, O_RDONLY);
+  if (fd < 0) { return -1; }
+
+  if (fstat(fd, &st) || (u64)st.st_size < sizeof(struct stats_page)) {
+
+    close(fd);
+    return -1;
+
+  }
+
+  p = mmap(NULL, sizeof(struct stats_page), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) { return -1; }
+
+  if (stats_page_valid(p, st.st_size) && !stats_page_read(p, d) &&
+      d->last_update / 1000 >= mtime) {
+
+    ret = 0;
+
+  }
+
+  munmap(p, sizeof(struct stats_page));
+  return ret;
+
+}
+
+/* Load the instance in dir/name. Returns 0 if there is none. */
+
+static u8 load_instance(u8 *dir, u8 *name, struct wu_instance *in) {
+
+  u8          fn[PATH_MAX];
+  struct stat st;
+  u64         mtime = 0;
+  u8          have_text;
+
+  snprintf(fn, PATH_MAX, "%s/%s/fuzzer_setup", dir, name);
+  if (stat(fn, &st)) { return 0; }
+
+  memset(in, 0, sizeof(*in));
+  in->name = name;
+
+  snprintf(fn, PATH_MAX, "%s/%s/fuzzer_stats", dir, name);
+  have_text = !stat(fn, &st);
+  if (have_text) { mtime = st.st_mtime; }
+
+  snprintf(fn, PATH_MAX, "%s/%s/" STATS_PAGE_FILE, dir, name);
+  in->from_page = !read_stats_page(fn, &in->d, mtime);
+
+  if (!in->from_page) {
+
+    memset(&in->d, 0, sizeof(in->d));
+    snprintf(fn, PATH_MAX, "%s/%s/fuzzer_stats", dir, name);
+
+    if (!have_text || read_stats_text(fn, &in->d)) {
+
+      in->state = WU_STARTING;
+      return 1;
+
+    }
+
+  }
+
+  if (in->d.stopped ||
+      (kill(in->d.fuzzer_pid, 0) && errno != EPERM) || !in->d.fuzzer_pid) {
+
+    in->state = WU_DEAD;
+
+  } else if (!in->d.last_update) {
+
+    in->state = WU_STARTING;
+
+  } else {
+
+    in->state = WU_ALIVE;
+
+  }
+
+  return 1;
+
+}
+
+static s32 name_cmp(const void *a, const void *b) {
+
+  return strcmp(*(char **)a, *(char **)b);
+
+}
+
+/* Format a duration of secs seconds like the shell version did. */
+
+static u8 *fmt_duration(u64 secs, u8 *buf, u32 len) {
+
+  u64 days = secs / 86400, hours = (secs / 3600) % 24,
+      minutes = (secs / 60) % 60, seconds = secs % 60;
+
+  if (!secs) {
+
+    snprintf(buf, len, "0 seconds");
+
+  } else if (secs == 1) {
+
+    snprintf(buf, len, "1 second");
+
+  } else if (days) {
+
+    snprintf(buf, len, "%llu days, %llu hours", days, hours);
+
+  } else if (hours) {
+
+    snprintf(buf, len, "%llu hours, %llu minutes", hours, minutes);
+
+  } else if (minutes) {
+
+    snprintf(buf, len, "%llu minutes, %llu seconds", minutes, seconds);
+
+  } else {
+
+    snprintf(buf, len, "%llu seconds", seconds);
+
+  }
+
+  return buf;
+
+}
+
+static u8 *fmt_since(u64 now, u64 then_ms, u8 *buf, u32 len) {
+
+  if (!then_ms) { return (u8 *)"none seen yet"; }
+  return fmt_duration(now / 1000 - MIN(now, then_ms) / 1000, buf, len);
+
+}
+
+/* CPU and memory usage of pid in percent over its lifetime, like ps. */
+
+static u8 get_usage(u32 pid, double *cpu, double *mem) {
+
+#ifdef __linux__
+  u8    fn[64], buf[1024], *p;
+  FILE *f;
+  u64   utime, stime, start, rss;
+  double uptime;
+  long   hz = sysconf(_SC_CLK_TCK), pages = sysconf(_SC_PHYS_PAGES);
+
+  snprintf(fn, sizeof(fn), "/proc/%u/stat", pid);
+  if (!(f = fopen(fn, "r"))) { return 0; }
+  if (!fgets(buf, sizeof(buf), f)) {
+
+    fclose(f);
+    return 0;
+
+  }
+
+  fclose(f);
+
+  /* Skip the command name, it may contain blanks. */
+
+  if (!(p = strrchr(buf, ')'))) { return 0; }
+
+  if (sscanf(p + 2,
+             "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d "
+             "%*d %*d %*d %*d %llu %*u %llu",
+             &utime, &stime, &start, &rss) != 4) {
+
+    return 0;
+
+  }
+
+  if (!(f = fopen("/proc/uptime", "r"))) { return 0; }
+  if (fscanf(f, "%lf", &uptime) != 1) {
+
+    fclose(f);
+    return 0;
+
+  }
+
+  fclose(f);
+
+  uptime -= (double)start / hz;
+  *cpu = uptime > 0 ? (double)(utime + stime) / hz * 100 / uptime : 0;
+  *mem = pages > 0 ? (double)rss * 100 / pages : 0;
+  return 1;
+#else
+  (void)pid;
+  (void)cpu;
+  (void)mem;
+  return 0;
+#endif
+
+}
+
+static void json_str(const char *s) {
+
+  SAYF("\"");
+
+  for (; *s; ++s) {
+
+    if (*s == '"' || *s == '\\') {
+
+      SAYF("\\%c", *s);
+
+    } else if ((u8)*s < 0x20) {
+
+      SAYF("\\u%04x", (u8)*s);
+
+    } else {
+
+      SAYF("%c", *s);
+
+    }
+
+  }
+
+  SAYF("\"");
+
+}
+
+static const char *state_name[] = {"alive", "starting", "dead"};
+
+static void print_instance(struct wu_instance *in, u64 now, u8 first) {
+
+  struct stats_page_data *d = &in->d;
+  u64                     run = d->run_time / 1000;
+  u64                     eps = run ? d->execs_done / run : 0;
+  u8                      tmp[3][64];
+
+  if (json) {
+
+    SAYF("%s\n    {\"name\": ", first ? "" : ",");
+    json_str(in->name);
+    SAYF(", \"banner\": ");
+    json_str(d->banner);
+    SAYF(
+        ", \"state\": \"%s\", \"fuzzer_pid\": %u, \"run_time\": %llu, "
+        "\"execs_done\": %llu, \"execs_per_sec\": %llu, "
+        "\"execs_ps_last_min\": %0.02f, \"cycles_done\": %llu, "
+        "\"cycles_wo_finds\": %llu, \"cur_item\": %u, \"corpus_count\": %u, "
+        "\"corpus_found\": %u, \"pending_favs\": %u, \"pending_total\": %u, "
+        "\"bitmap_cvg\": %0.02f, \"edges_found\": %u, \"total_edges\": %u, "
+        "\"stability\": %0.02f, \"saved_crashes\": %llu, "
+        "\"saved_hangs\": %llu, \"last_find\": %llu, \"last_crash\": %llu, "
+        "\"last_hang\": %llu}",
+        state_name[in->state], d->fuzzer_pid, run, d->execs_done, eps,
+        d->execs_ps_last_min, d->cycles_done, d->cycles_wo_finds,
+        d->cur_item, d->corpus_count, d->corpus_found, d->pending_favs,
+        d->pending_total, d->bitmap_cvg, d->edges_found, d->total_edges,
+        d->stability, d->saved_crashes, d->saved_hangs, d->last_find / 1000,
+        d->last_crash / 1000, d->last_hang / 1000);
+    return;
+
+  }
+
+  if (summary_only) { return; }
+
+  SAYF(">>> %s instance: %s (%llu days, %llu hrs) fuzzer PID: %u <<<\n\n",
+       d->banner, in->name, run / 86400, (run / 3600) % 24, d->fuzzer_pid);
+
+  if (in->state == WU_STARTING) {
+
+    SAYF("  Instance is still starting up, skipping.\n\n");
+    return;
+
+  }
+
+  if (in->state == WU_DEAD) {
+
+    SAYF("  Instance is dead or running remotely, skipping.\n\n");
+    if (!include_dead) { return; }
+
+  }
+
+  if (!eps) {
+
+    SAYF("  %sno data yet, 0 execs/sec%s\n", c_yel, c_rst);
+
+  } else if (eps < 100) {
+
+    SAYF("  %sslow execution, %llu execs/sec%s\n", c_red, eps, c_rst);
+
+  }
+
+  SAYF("  last_find       : %s%s%s\n", d->last_find ? "" : c_red,
+       fmt_since(now, d->last_find, tmp[0], sizeof(tmp[0])),
+       d->last_find ? "" : c_rst);
+  SAYF("  last_crash      : %s\n",
+       fmt_since(now, d->last_crash, tmp[1], sizeof(tmp[1])));
+
+  if (!minimal) {
+
+    char *col = d->cycles_wo_finds > 50   ? c_red
+                : d->cycles_wo_finds > 10 ? c_yel
+                                          : "";
+    SAYF("  last_hang       : %s\n",
+         fmt_since(now, d->last_hang, tmp[2], sizeof(tmp[2])));
+    SAYF("  cycles_wo_finds : %s%llu%s\n", col, d->cycles_wo_finds,
+         *col ? c_rst : "");
+
+  }
+
+  SAYF("  coverage        : %0.02f%%\n", d->bitmap_cvg);
+
+  if (!minimal) {
+
+    double cpu, mem;
+    if (in->state == WU_ALIVE && get_usage(d->fuzzer_pid, &cpu, &mem)) {
+
+      SAYF("  cpu usage %0.1f%%, memory usage %0.1f%%\n", cpu, mem);
+
+    }
+
+  }
+
+  SAYF("  cycles %llu, lifetime speed %llu execs/sec, items %u/%u (%u%%)\n",
+       d->cycles_done + 1, eps, d->cur_item, d->corpus_count,
+       d->corpus_count ? d->cur_item * 100 / d->corpus_count : 0);
+
+  if (!d->saved_crashes) {
+
+    SAYF("  pending %u/%u, coverage %0.02f%%, no crashes yet\n\n",
+         d->pending_favs, d->pending_total, d->bitmap_cvg);
+
+  } else {
+
+    SAYF("  pending %u/%u, coverage %0.02f%%, crashes saved %llu (!)\n\n",
+         d->pending_favs, d->pending_total, d->bitmap_cvg, d->saved_crashes);
+
+  }
+
+}
+
+static void add_to_summary(struct wu_summary *s, struct wu_instance *in) {
+
+  struct stats_page_data *d = &in->d;
+  u64                     run = d->run_time / 1000;
+
+  /* Like the old script, coverage and cycles without finds are taken from
+     every instance that wrote its stats, even if it is not counted. */
+
+  if (d->fuzzer_pid) {
+
+    u32 len = strlen(s->wcop);
+
+    s->coverage = MAX(s->coverage, d->bitmap_cvg);
+    snprintf(s->wcop + len, sizeof(s->wcop) - len, "%s%llu", len ? "/" : "",
+             d->cycles_wo_finds);
+
+  }
+
+  switch (in->state) {
+
+    case WU_ALIVE:
+      ++s->alive;
+      break;
+    case WU_STARTING:
+      ++s->starting;
+      return;
+    case WU_DEAD:
+      ++s->dead;
+      if (!include_dead) { return; }
+      break;
+
+  }
+
+  s->run_time += run;
+  s->execs += d->execs_done;
+  s->eps += run ? d->execs_done / run : 0;
+  if (in->state == WU_ALIVE) { s->eps_last_min += (u64)d->execs_ps_last_min; }
+  s->crashes += d->saved_crashes;
+  s->hangs += d->saved_hangs;
+  s->pending += d->pending_total;
+  s->pending_favs += d->pending_favs;
+  if (in->state == WU_ALIVE) { s->last_find = MAX(s->last_find, d->last_find); }
+
+}
+
+static void print_summary(struct wu_summary *s, u64 now) {
+
+  u8 tmp[2][64];
+
+  if (json) {
+
+    SAYF(
+        "\n  ],\n  \"summary\": {\"alive\": %u, \"starting\": %u, "
+        "\"dead\": %u, \"dead_included\": %s, \"run_time\": %llu, "
+        "\"execs_done\": %llu, \"execs_per_sec\": %llu, "
+        "\"execs_ps_last_min\": %llu, \"pending_favs\": %llu, "
+        "\"pending_total\": %llu, \"bitmap_cvg\": %0.02f, "
+        "\"saved_crashes\": %llu, \"saved_hangs\": %llu, "
+        "\"last_find\": %llu}\n}\n",
+        s->alive, s->starting, s->dead, include_dead ? "true" : "false",
+        s->run_time, s->execs, s->eps, s->eps_last_min, s->pending_favs,
+        s->pending, s->coverage, s->crashes, s->hangs, s->last_find / 1000);
+    return;
+
+  }
+
+  const char *txt = include_dead ? "included in stats" : "excluded from stats";
+
+  SAYF("Summary stats\n=============\n");
+  if (!summary_only || !minimal) { SAYF("\n"); }
+
+  SAYF("        Fuzzers alive : %u\n", s->alive);
+  if (s->starting) {
+
+    SAYF("          Starting up : %u (%s)\n", s->starting, txt);
+
+  }
+
+  if (s->dead) { SAYF("       Dead or remote : %u (%s)\n", s->dead, txt); }
+
+  SAYF("       Total run time : %s\n",
+       fmt_duration(s->run_time, tmp[0], sizeof(tmp[0])));
+
+  if (!minimal) {
+
+    if (s->execs >= 10000000) {
+
+      SAYF("          Total execs : %llu millions\n", s->execs / 1000000);
+
+    } else if (s->execs >= 1000000) {
+
+      SAYF("          Total execs : %llu millions, %llu thousands\n",
+           s->execs / 1000000, s->execs / 1000 % 1000);
+
+    } else {
+
+      SAYF("          Total execs : %llu thousands\n", s->execs / 1000);
+
+    }
+
+    SAYF("     Cumulative speed : %llu execs/sec\n", s->eps);
+    if (s->alive) {
+
+      SAYF("  Total average speed : %llu execs/sec\n", s->eps / s->alive);
+
+    }
+
+  }
+
+  if (s->alive) {
+
+    SAYF("Current average speed : %llu execs/sec\n", s->eps_last_min);
+
+  }
+
+  if (!minimal) {
+
+    SAYF("        Pending items : %llu faves, %llu total\n", s->pending_favs,
+         s->pending);
+
+  }
+
+  if ((s->alive > 1 || minimal) && s->alive) {
+
+    SAYF("   Pending per fuzzer : %llu faves, %llu total (on average)\n",
+         s->pending_favs / s->alive, s->pending / s->alive);
+
+  }
+
+  SAYF("     Coverage reached : %0.02f%%\n", s->coverage);
+  SAYF("        Crashes saved : %llu\n", s->crashes);
+
+  if (!minimal) {
+
+    SAYF("          Hangs saved : %llu\n", s->hangs);
+    SAYF(" Cycles without finds : %s\n",
+         s->wcop[0] ? s->wcop : (u8 *)"not available");
+
+  }
+
+  SAYF("   Time without finds : %s\n\n",
+       s->last_find ? fmt_since(now, s->last_find, tmp[1], sizeof(tmp[1]))
+                    : (u8 *)"0");
+
+}
+
+/* Scan the sync directory once and print everything. */
+
+static void whatsup(u8 *argv0, u8 *dir) {
+
+  struct dirent      *de;
+  DIR                *d;
+  u8                **names = NULL;
+  u32                 cnt = 0, i, shown = 0;
+  struct wu_instance  in;
+  struct wu_summary   s;
+  u64                 now = get_cur_time();
+
+  memset(&s, 0, sizeof(s));
+
+  if (!(d = opendir(dir))) { PFATAL("Unable to open '%s'", dir); }
+
+  while ((de = readdir(d))) {
+
+    if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) { continue; }
+    names = ck_realloc(names, (cnt + 1) * sizeof(u8 *));
+    names[cnt++] = ck_strdup(de->d_name);
+
+  }
+
+  closedir(d);
+  qsort(names, cnt, sizeof(u8 *), name_cmp);
+
+  if (json) {
+
+    SAYF("{\n  \"time\": %llu,\n  \"instances\": [", now / 1000);
+
+  } else {
+
+    if (!minimal) {
+
+      SAYF("%s status check tool for afl-fuzz by Michal Zalewski\n\n", argv0);
+
+    }
+
+    if (!summary_only) { SAYF("Individual fuzzers\n==================\n\n"); }
+
+  }
+
+  for (i = 0; i < cnt; ++i) {
+
+    if (load_instance(dir, names[i], &in)) {
+
+      print_instance(&in, now, !shown++);
+      add_to_summary(&s, &in);
+
+    }
+
+    ck_free(names[i]);
+
+  }
+
+  ck_free(names);
+
+  print_summary(&s, now);
+  fflush(stdout);
+
+}
+
+int main(int argc, char **argv) {
+
+  s32 opt;
+  u32 watch = 0;
+  u8  fn[PATH_MAX];
+
+  while ((opt = getopt(argc, argv, "dmnsjw:h")) > 0) {
+
+    switch (opt) {
+
+      case 'd':
+        include_dead = 1;
+        break;
+
+      case 'm':
+        minimal = 1;
+        break;
+
+      case 'n':
+        c_red = c_yel = c_rst = "";
+        break;
+
+      case 's':
+        summary_only = 1;
+        break;
+
+      case 'j':
+        json = 1;
+        c_red = c_yel = c_rst = "";
+        break;
+
+      case 'w':
+        watch = atoi(optarg);
+        if (!watch) { FATAL("Bad value specified for -w"); }
+        break;
+
+      default:
+        usage(argv[0]);
+
+    }
+
+  }
+
+  if (optind + 1 != argc) { usage(argv[0]); }
+
+  snprintf(fn, PATH_MAX, "%s/queue", argv[optind]);
+  if (!access(fn, F_OK)) {
+
+    FATAL("parameter is an individual output directory, not a sync dir.");
+
+  }
+
+  while (1) {
+
+    /* Watch mode redraws the screen, except for JSON that may be piped. */
+
+    if (watch && !json && isatty(1)) { SAYF("\x1b[H\x1b[2J"); }
+
+    whatsup(argv[0], argv[optind]);
+
+    if (!watch) { break; }
+    sleep(watch);
+
+  }
+
+  return 0;
+
+}
+
@@ -1,149 +1,137 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdbool.h>
-#include "types.h"
-#define TABLE_SIZE 10007  // Use a prime number for better distribution
-
-typedef struct HashNode {
+/*
+   american fuzzy lop++ - redqueen value set
+   -----------------------------------------
 
-  uint64_t         key;
-  struct HashNode *next;
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
 
-} HashNode;
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
 
-typedef struct HashMap {
+     https://www.apache.org/licenses/LICENSE-2.0
 
-  HashNode **table;
+   Set of 64 bit values that redqueen uses to skip operands it has already
+   tried on the current input. It is an open addressing table with linear
+   probing. Every slot remembers the generation it was written in, so
+   hashmap_reset() only has to bump the generation, and the table grows
+   when it gets too full.
 
-} HashMap;
+ */
 
-static HashMap *_hashmap;
-
-void hashmap_reset() {
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "types.h"
+#include "debug.h"
 
-  if (unlikely(!_hashmap)) {
+#define HASHMAP_INITIAL_BITS 14                      /* 16384 slots at start */
 
-    _hashmap = (HashMap *)malloc(sizeof(HashMap));
-    _hashmap->table = (HashNode **)malloc(sizeof(HashNode *) * TABLE_SIZE);
-    memset((char *)_hashmap->table, 0, sizeof(HashNode *) * TABLE_SIZE);
+typedef struct HashSlot {
 
-  } else {
+  u64 key;
+  u32 gen;                              /* Slot is used if gen == _gen      */
 
-    for (int i = 0; i < TABLE_SIZE; i++) {
+} HashSlot;
 
-      HashNode *node = _hashmap->table[i];
-      while (node) {
+static HashSlot *_slots;
+static u32       _bits, _count, _gen;
 
-        HashNode *temp = node;
-        node = node->next;
-        free(temp);
+static inline u32 hash(u64 key, u32 bits) {
 
-      }
+  return (key * 0x9e3779b97f4a7c15ULL) >> (64 - bits);
 
-    }
+}
 
-    memset((char *)_hashmap->table, 0, sizeof(HashNode *) * TABLE_SIZE);
+static void hashmap_alloc(u32 bits) {
 
-  }
+  _slots = (HashSlot *)calloc((size_t)1 << bits, sizeof(HashSlot));
+  if (!_slots) { FATAL("Unable to allocate the redqueen hashmap"); }
+  _bits = bits;
 
 }
 
-static inline unsigned int hash(uint64_t key) {
-
-  return key % TABLE_SIZE;
+void hashmap_reset() {
 
-}
+  if (unlikely(!_slots)) { hashmap_alloc(HASHMAP_INITIAL_BITS); }
 
-// type must be below 8
-bool hashmap_search_and_add(uint8_t type, uint64_t key) {
+  /* Generation 0 marks slots that were never used, so on wrap around the
+     table really has to be cleared. */
 
-  if (unlikely(type >= 8)) return false;
-  uint64_t     val = (key & 0xf8ffffffffffffff) + ((uint64_t)type << 56);
-  unsigned int index = hash(val);
-  HashNode    *node = _hashmap->table[index];
-  while (node) {
+  if (unlikely(!++_gen)) {
 
-    if (node->key == val) return true;
-    node = node->next;
+    memset(_slots, 0, sizeof(HashSlot) << _bits);
+    _gen = 1;
 
   }
 
-  // not found so add it
-  node = (HashNode *)malloc(sizeof(HashNode));
-  node->key = val;
-  node->next = _hashmap->table[index];
-  _hashmap->table[index] = node;
-
-  return false;
+  _count = 0;
 
 }
 
-// type must be below 8
-bool hashmap_search_and_add_ptr(uint8_t type, u8 *key) {
+/* Double the table and move over the keys of the current generation. */
 
-  if (unlikely(type >= 8)) return false;
-  uint64_t key_t = 0;
-  memcpy(((char *)key_t) + (7 - type), key, type + 1);
-  return hashmap_search_and_add(type, key_t);
+static void hashmap_grow() {
 
-}
+  HashSlot *old = _slots;
+  u32       old_size = 1U << _bits, i;
 
-/* below is not used */
+  hashmap_alloc(_bits + 1);
 
-void hashmap_insert(uint64_t key) {
+  for (i = 0; i < old_size; ++i) {
 
-  unsigned int index = hash(key);
-  HashNode    *node = (HashNode *)malloc(sizeof(HashNode));
-  node->key = key;
-  node->next = _hashmap->table[index];
-  _hashmap->table[index] = node;
+    if (old[i].gen != _gen) { continue; }
 
-}
+    u32 mask = (1U << _bits) - 1, pos = hash(old[i].key, _bits);
+    while (_slots[pos].gen == _gen) {
 
-bool hashmap_search(uint64_t key) {
+      pos = (pos + 1) & mask;
 
-  unsigned int index = hash(key);
-  HashNode    *node = _hashmap->table[index];
-  while (node) {
+    }
 
-    if (node->key == key) return true;
-    node = node->next;
+    _slots[pos] = old[i];
 
   }
 
-  return false;
+  free(old);
 
 }
 
-void delete(uint64_t key) {
+// type must be below 8
+bool hashmap_search_and_add(uint8_t type, uint64_t key) {
+
+  if (unlikely(type >= 8)) return false;
+  uint64_t val = (key & 0xf8ffffffffffffff) + ((uint64_t)type << 56);
+  u32      mask = (1U << _bits) - 1, pos = hash(val, _bits);
 
-  unsigned int index = hash(key);
-  HashNode    *prev = NULL, *node = _hashmap->table[index];
-  while (node) {
+  while (_slots[pos].gen == _gen) {
 
-    if (node->key == key) {
+    if (_slots[pos].key == val) return true;
+    pos = (pos + 1) & mask;
 
-      if (prev)
-        prev->next = node->next;
-      else
-        _hashmap->table[index] = node->next;
-      free(node);
-      return;
+  }
 
-    }
+  // not found so add it
+  _slots[pos].key = val;
+  _slots[pos].gen = _gen;
 
-    prev = node;
-    node = node->next;
+  /* keep the load below 3/4 so probe sequences stay short */
+  if (unlikely(++_count > (mask >> 2) * 3)) { hashmap_grow(); }
 
-  }
+  return false;
 
 }
 
-void freeHashMap(HashMap *map) {
+// type must be below 8
+bool hashmap_search_and_add_ptr(uint8_t type, u8 *key) {
 
-  free(_hashmap->table);
-  free(map);
+  if (unlikely(type >= 8)) return false;
+  uint64_t key_t = 0;
+  memcpy(&key_t, key, type + 1);
+  return hashmap_search_and_add(type, key_t);
 
 }
 
@@ -118,7 +118,65 @@ $ECHO "$BLUE[*] Testing: ${AFL_COMPILER}, afl-showmap, afl-fuzz, afl-cmin and af
        $ECHO "$RED[!] afl-tmin did incorrectly minimize the testcase to $SIZE"
        CODE=1
     }
-    rm -rf in out errors in2
+    for TMIN_OPT in "-T 2" "-T 2 -F"; do
+      ../afl-tmin -m ${MEM_LIMIT} $TMIN_OPT -i in/in2 -o in2/in2.t -- ./test-instr.plain > /dev/null 2>&1
+      cmp -s in2/in2 in2/in2.t && $ECHO "$GREEN[+] afl-tmin $TMIN_OPT gives the same testcase as the serial run"
+      cmp -s in2/in2 in2/in2.t || {
+         $ECHO "$RED[!] afl-tmin $TMIN_OPT does not give the same testcase as the serial run"
+         CODE=1
+      }
+      rm -f in2/in2.t
+    done
+    mkdir -p in3 in4
+    ../afl-showmap -m ${MEM_LIMIT} -M -i in -o in3 -- ./test-instr.plain > /dev/null 2>&1
+    ../afl-showmap -m ${MEM_LIMIT} -M -T 2 -i in -o in4 -- ./test-instr.plain > /dev/null 2>&1
+    CNT=`ls in3/* 2>/dev/null | wc -l`
+    case "$CNT" in
+      *2) diff -r in3 in4 > /dev/null 2>&1 && $ECHO "$GREEN[+] afl-showmap -M correctly minimized the number of testcases, also with -T 2"
+          diff -r in3 in4 > /dev/null 2>&1 || {
+            $ECHO "$RED[!] afl-showmap -M -T 2 does not give the same testcases as the serial run"
+            CODE=1
+          }
+          ;;
+      *)  $ECHO "$RED[!] afl-showmap -M did not correctly minimize the number of testcases ($CNT)"
+          CODE=1
+          ;;
+    esac
+    test -z "$SKIP" && {
+      $ECHO "$GREY[*] running afl-fuzz with AFL_CAL_ADAPTIVE and AFL_METRICS, this will take approx 5 seconds"
+      AFL_CAL_ADAPTIVE=1 AFL_METRICS=1 AFL_METRICS_PORT=0 ../afl-fuzz -V05 -m ${MEM_LIMIT} -i in -o out2 -- ./test-instr.plain > errors2 2>&1 &
+      PID=$!
+      URL=
+      for i in 1 2 3 4 5 6 7 8 9 10; do
+        URL=`grep -a "Serving OpenMetrics" errors2 2>/dev/null | sed 's/.*\(http:[^ ]*metrics\).*/\1/'`
+        test -n "$URL" && break
+        sleep 0.5
+      done
+      if command -v curl >/dev/null ; then {
+        test -n "$URL" && curl -s "$URL" 2>/dev/null | grep -q '^afl_execs_total' && {
+          $ECHO "$GREEN[+] afl-fuzz serves the metrics on $URL"
+        } || {
+          $ECHO "$RED[!] afl-fuzz does not serve the metrics with AFL_METRICS"
+          CODE=1
+        }
+      } else {
+        $ECHO "$GREY[*] no curl available, cannot test AFL_METRICS"
+      }
+      fi
+      wait $PID
+      CAL=`grep '^calibration_execs' out2/default/fuzzer_stats 2>/dev/null | awk '{print$3}'`
+      CNT=`grep '^corpus_count' out2/default/fuzzer_stats 2>/dev/null | awk '{print$3}'`
+      test -n "$CAL" -a -n "$CNT" && test "$CAL" -gt 0 -a "$CAL" -lt $((CNT * 4)) && {
+        $ECHO "$GREEN[+] AFL_CAL_ADAPTIVE calibrated $CNT entries with $CAL executions"
+      } || {
+        echo CUT------------------------------------------------------------------CUT
+        cat errors2
+        echo CUT------------------------------------------------------------------CUT
+        $ECHO "$RED[!] AFL_CAL_ADAPTIVE did not shorten the calibration ($CAL executions for $CNT entries)"
+        CODE=1
+      }
+    }
+    rm -rf in out errors in2 in3 in4 out2 errors2
     unset AFL_QUIET
    }
    rm -f test-instr.plain
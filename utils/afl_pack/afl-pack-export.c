@@ -0,0 +1,137 @@
+/*
+   american fuzzy lop++ - export a packed corpus to a directory
+   ------------------------------------------------------------
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Writes every record of a pack (see include/afl-pack.h) to a file in the
+   given directory, using the classic file name stored in the record. With
+   -l the records are only listed.
+
+*/
+
+#include "config.h"
+#include "types.h"
+#include "debug.h"
+#include "alloc-inl.h"
+#include "afl-pack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+static void usage(char *argv0) {
+
+  SAYF(
+      "%s [ -l ] file.pack [ out_dir ]\n\n"
+      "  -l  - only list the records (id, parent, length, time, name)\n\n"
+      "Without -l every record is written to out_dir with its original file "
+      "name.\n",
+      argv0);
+  exit(1);
+
+}
+
+int main(int argc, char **argv) {
+
+  struct afl_pack_record rec;
+  s32                    fd, idx_fd, opt;
+  u32                    i, cnt, done = 0;
+  u8                     list = 0, fn[PATH_MAX];
+
+  while ((opt = getopt(argc, argv, "lh")) > 0) {
+
+    switch (opt) {
+
+      case 'l':
+        list = 1;
+        break;
+
+      default:
+        usage(argv[0]);
+
+    }
+
+  }
+
+  if (optind >= argc || (!list && optind + 2 != argc)) { usage(argv[0]); }
+
+  if (afl_pack_open_ro(argv[optind], &fd, &idx_fd)) {
+
+    PFATAL("Unable to open '%s'", argv[optind]);
+
+  }
+
+  if (!list && mkdir(argv[optind + 1], 0700) && errno != EEXIST) {
+
+    PFATAL("Unable to create '%s'", argv[optind + 1]);
+
+  }
+
+  cnt = afl_pack_count(idx_fd);
+
+  for (i = 0; i < cnt; ++i) {
+
+    u8 *buf = afl_pack_read(fd, idx_fd, i, &rec);
+
+    if (!buf) {
+
+      WARNF("Unable to read record %u", i);
+      continue;
+
+    }
+
+    if (list) {
+
+      if (rec.parent == AFL_PACK_NO_PARENT) {
+
+        SAYF("%u\t-\t%u\t%llu\t%s\n", rec.id, rec.len, rec.time_ms,
+             buf + rec.len);
+
+      } else {
+
+        SAYF("%u\t%u\t%u\t%llu\t%s\n", rec.id, rec.parent, rec.len,
+             rec.time_ms, buf + rec.len);
+
+      }
+
+    } else {
+
+      if (rec.desc_len) {
+
+        snprintf(fn, PATH_MAX, "%s/%s", argv[optind + 1], buf + rec.len);
+
+      } else {
+
+        snprintf(fn, PATH_MAX, "%s/id:%06u", argv[optind + 1], rec.id);
+
+      }
+
+      s32 out_fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_PERMISSION);
+      if (out_fd < 0) { PFATAL("Unable to create '%s'", fn); }
+      ck_write(out_fd, buf, rec.len, fn);
+      close(out_fd);
+
+    }
+
+    ck_free(buf);
+    ++done;
+
+  }
+
+  if (!list) { OKF("Exported %u of %u records.", done, cnt); }
+
+  close(fd);
+  close(idx_fd);
+  return 0;
+
+}
+
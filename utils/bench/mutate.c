@@ -0,0 +1,66 @@
+/* Measures the havoc throughput of afl_mutate() in mutations per second for
+   a few input sizes, like the aflpp custom mutator uses it. */
+
+#include "afl-fuzz.h"
+#include "afl-mutations.h"
+
+#include <time.h>
+
+#define BENCH_ROUNDS 2000000
+#define BENCH_MAX_LEN 65536
+
+int main(int argc, char **argv) {
+
+  static const u32 sizes[] = {16, 256, 4096};
+  struct timespec  start, end;
+  afl_state_t     *afl = calloc(1, sizeof(afl_state_t));
+  u8              *orig = malloc(BENCH_MAX_LEN), *buf = malloc(BENCH_MAX_LEN),
+     *splice = malloc(BENCH_MAX_LEN);
+  u32 rounds = argc > 1 ? atoi(argv[1]) : BENCH_ROUNDS, i, s;
+
+  if (!afl || !orig || !buf || !splice || !rounds) { return 1; }
+
+  /* fake AFL++ state, fixed seed so runs are comparable */
+  afl->queue_cycle = 1;
+  afl->fixed_seed = 1;
+  afl->fsrv.dev_urandom_fd = -1;
+  rand_set_seed(afl, 1);
+
+  for (i = 0; i < BENCH_MAX_LEN; ++i) {
+
+    orig[i] = i * 7;
+    splice[i] = i * 13;
+
+  }
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+
+    u64 muts = 0, duration, len_sum = 0;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+
+    for (i = 0; i < rounds; ++i) {
+
+      u32 steps = 1 << (1 + rand_below(afl, 5));
+
+      memcpy(buf, orig, sizes[s]);
+      len_sum += afl_mutate(afl, buf, sizes[s], steps, false, true, splice,
+                            sizes[s], BENCH_MAX_LEN);
+      muts += steps;
+
+    }
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+    duration = (end.tv_sec - start.tv_sec) * 1000000000LL +
+               (end.tv_nsec - start.tv_nsec);
+
+    printf("len %5u: %10.0f mutations/s, %9.0f inputs/s (avg out len %llu)\n",
+           sizes[s], (double)muts * 1e9 / duration,
+           (double)rounds * 1e9 / duration, len_sum / rounds);
+
+  }
+
+  return 0;
+
+}
+
@@ -0,0 +1,68 @@
+/* Compares rand_below() with the modulo based rejection sampling it used
+   before, in draws per second for a few typical limits. */
+
+#include "afl-fuzz.h"
+
+#include <time.h>
+
+#define BENCH_ROUNDS 100000000
+
+static u32 rand_below_modulo(afl_state_t *afl, u32 limit) {
+
+  if (unlikely(limit <= 1)) return 0;
+
+  u64 unbiased_rnd;
+  do {
+
+    unbiased_rnd = rand_next(afl);
+
+  } while (unlikely(unbiased_rnd >= (UINT64_MAX - (UINT64_MAX % limit))));
+
+  return unbiased_rnd % limit;
+
+}
+
+int main(int argc, char **argv) {
+
+  static const u32 limits[] = {3, 256, 4096, 1000003, 0x80000001};
+  struct timespec  start, end;
+  afl_state_t     *afl = calloc(1, sizeof(afl_state_t));
+  u32              rounds = argc > 1 ? atoi(argv[1]) : BENCH_ROUNDS, i, l;
+
+  if (!afl || !rounds) { return 1; }
+
+  afl->fixed_seed = 1;
+  afl->fsrv.dev_urandom_fd = -1;
+
+  for (l = 0; l < sizeof(limits) / sizeof(limits[0]); ++l) {
+
+    u64 sum = 0, duration[2];
+
+    for (u32 method = 0; method < 2; ++method) {
+
+      rand_set_seed(afl, 1);
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+
+      for (i = 0; i < rounds; ++i) {
+
+        sum += method ? rand_below(afl, limits[l])
+                      : rand_below_modulo(afl, limits[l]);
+
+      }
+
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+      duration[method] = (end.tv_sec - start.tv_sec) * 1000000000LL +
+                         (end.tv_nsec - start.tv_nsec);
+
+    }
+
+    printf("limit %10u: modulo %6.1f M/s, rand_below %6.1f M/s (%llu)\n",
+           limits[l], (double)rounds * 1e3 / duration[0],
+           (double)rounds * 1e3 / duration[1], sum & 0xff);
+
+  }
+
+  return 0;
+
+}
+
@@ -0,0 +1,1327 @@
+/*
+   american fuzzy lop++ - multi node corpus sync daemon
+   ----------------------------------------------------
+
+   Now maintained by Marc Heuse <mh@mh-sec.de>,
+                        Heiko Eissfeldt <heiko.eissfeldt@hexco.de> and
+                        Andrea Fioraldi <andreafioraldi@gmail.com>
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+     https://www.apache.org/licenses/LICENSE-2.0
+
+   One afl-sync-node runs on every host, next to afl-fuzz instances that
+   share a sync directory and run with AFL_SYNC_BUS=1. It reads the new
+   queue entries and their traces from sync_dir/.sync_bus and offers them
+   to all connected nodes as (digest, trace). A node that receives an offer
+   drops it if it already knows the digest or if the trace has no bits its
+   own instances have not seen yet. Otherwise it fetches the input and
+   stores it in sync_dir/<node>_remote/queue/, where the local main
+   instance picks it up like from any other peer.
+
+   All nodes must run on the same architecture, the protocol is not
+   authenticated - only use it in trusted networks.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <dirent.h>
+#include <limits.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#include "config.h"
+#include "types.h"
+#include "debug.h"
+#include "alloc-inl.h"
+#include "hash.h"
+#include "afl-sync-bus.h"
+
+#define NODE_MAGIC 0x434e5953U                                    /* "SYNC" */
+#define NODE_VERSION 1
+#define NODE_NAME_LEN 64
+#define NODE_MSG_MAX (MAX_FILE + 64)
+#define NODE_WBUF_FILL (1024 * 1024)
+#define NODE_RETRY_MS 5000
+#define NODE_OFFERS_MAX (SYNC_BUS_RECORDS_MAX * 4)
+#define NODE_FETCH_MAX 1024
+#define NODE_QUEUE_MAX (1U << 24)
+
+enum {
+
+  /* 00 */ MSG_HELLO,                   /* magic, version, node name        */
+  /* 01 */ MSG_OFFER,                   /* seq, digest, input hash, trace   */
+  /* 02 */ MSG_FETCH,                   /* seq                              */
+  /* 03 */ MSG_DATA                     /* seq, input hash, input           */
+
+};
+
+struct msg_hdr {
+
+  u32 type;
+  u32 len;                              /* Payload bytes after the header   */
+
+};
+
+struct msg_hello {
+
+  u32 magic;
+  u32 version;
+  u8  name[NODE_NAME_LEN];
+
+};
+
+struct msg_offer {
+
+  u64 seq;                              /* Index in the sender's offers     */
+  u64 digest;                           /* Hash of the trace                */
+  u64 target;                           /* Identity of the target           */
+  u64 input_hash;                       /* hash64() of the input            */
+  u32 map_size;
+  u32 pair_cnt;                         /* Followed by idx[] and val[]      */
+
+};
+
+struct msg_data {
+
+  u64 seq;
+  u64 input_hash;                       /* Followed by the input            */
+
+};
+
+/* A queue entry of a local instance that we hand out. */
+
+struct offer {
+
+  u64  digest, input_hash;
+  u32  peer, id, pair_cnt;
+  u32 *idx;
+  u8  *val;
+
+};
+
+/* An offer we asked for. Its trace only counts as known once the input is
+   stored, so a fetch that fails can still be made from another node. */
+
+struct fetch {
+
+  u64  seq, digest;
+  u32  pair_cnt;
+  u32 *idx;
+  u8  *val;
+
+};
+
+struct conn {
+
+  s32 fd;                               /* Socket or -1                     */
+  u8 *addr;                             /* host:port if we connect          */
+  u8  connecting;                       /* Non-blocking connect() pending   */
+  u8  name[NODE_NAME_LEN];              /* Remote node, empty before HELLO  */
+  u8 *rbuf, *wbuf;
+  u32 rlen, rcap, wlen, wcap, woff;
+  u64 cursor;                           /* Next offer to send               */
+  u64 retry;                            /* When to connect again            */
+
+  struct fetch *fetch;                  /* Ring of NODE_FETCH_MAX, in order */
+  u32           fetch_head, fetch_cnt;
+
+};
+
+struct remote_dir {
+
+  u8  name[NODE_NAME_LEN];
+  u32 next_id;
+
+};
+
+struct peer_dir {
+
+  u32 hash;
+  u8  name[NAME_MAX + 1];
+  u8 **queue;                           /* File names by id, NULL if none   */
+  u32  queue_cnt;
+
+};
+
+static u8 *sync_dir, node_name[NODE_NAME_LEN];
+static volatile u8 stop_soon;
+
+static struct sync_bus *bus;
+static u64              bus_tail;
+static u32              bus_records;
+
+static struct offer *offers;            /* Ring of NODE_OFFERS_MAX entries */
+static u64           offer_cnt;         /* Offers ever made, seq of next    */
+
+static u64 *known;                      /* Open addressing set of digests   */
+static u64  known_cnt, known_size;
+
+static u8 *covered;                     /* Union of all traces we know of   */
+static u64 node_target;
+static u32 node_map_size;
+
+static struct conn *conns;
+static u32          conn_cnt;
+
+static struct remote_dir *remotes;
+static u32                remote_cnt;
+
+static struct peer_dir *peers;
+static u32              peer_cnt;
+
+static u64 stat_offered, stat_fetched, stat_dropped, stat_skipped;
+
+static u64 get_cur_time(void) {
+
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec * 1000ULL) + (tv.tv_usec / 1000);
+
+}
+
+static void handle_stop_sig(int sig) {
+
+  (void)sig;
+  stop_soon = 1;
+
+}
+
+/* Returns 1 if digest is in the set of known digests. */
+
+static u8 known_has(u64 digest) {
+
+  if (!known_size) { return 0; }
+  if (!digest) { digest = 1; }
+
+  u64 pos = digest % known_size;
+
+  while (known[pos]) {
+
+    if (known[pos] == digest) { return 1; }
+    pos = (pos + 1) % known_size;
+
+  }
+
+  return 0;
+
+}
+
+/* Add digest to the set of known digests, returns 1 if it was known. */
+
+static u8 known_add(u64 digest) {
+
+  if (!digest) { digest = 1; }
+
+  if ((known_cnt + 1) * 2 > known_size) {
+
+    u64  old_size = known_size;
+    u64 *old = known;
+
+    known_size = old_size ? old_size * 2 : 65536;
+    known = ck_alloc(known_size * sizeof(u64));
+    known_cnt = 0;
+
+    for (u64 i = 0; i < old_size; ++i) {
+
+      if (old[i]) { known_add(old[i]); }
+
+    }
+
+    ck_free(old);
+
+  }
+
+  u64 pos = digest % known_size;
+
+  while (known[pos]) {
+
+    if (known[pos] == digest) { return 1; }
+    pos = (pos + 1) % known_size;
+
+  }
+
+  known[pos] = digest;
+  ++known_cnt;
+  return 0;
+
+}
+
+static u64 trace_digest(u32 *idx, u8 *val, u32 cnt) {
+
+  return hash64((u8 *)idx, cnt * sizeof(u32), HASH_CONST) ^
+         (hash64(val, cnt, HASH_CONST) << 1);
+
+}
+
+/* Returns 1 if the trace has bits that are not covered yet. */
+
+static u8 trace_new(u32 *idx, u8 *val, u32 cnt) {
+
+  for (u32 i = 0; i < cnt; ++i) {
+
+    if (idx[i] < node_map_size && (val[i] & ~covered[idx[i]])) { return 1; }
+
+  }
+
+  return 0;
+
+}
+
+static void trace_merge(u32 *idx, u8 *val, u32 cnt) {
+
+  for (u32 i = 0; i < cnt; ++i) {
+
+    if (idx[i] < node_map_size) { covered[idx[i]] |= val[i]; }
+
+  }
+
+}
+
+/* The first trace we see decides which target this node syncs. */
+
+static u8 target_ok(u64 target, u32 map_size) {
+
+  static u8 warned;
+
+  if (!covered) {
+
+    node_target = target;
+    node_map_size = map_size;
+    covered = ck_alloc(map_size);
+    return 1;
+
+  }
+
+  if (target == node_target && map_size == node_map_size) { return 1; }
+
+  if (!warned) {
+
+    WARNF("Ignoring traces of a different target binary or map size");
+    warned = 1;
+
+  }
+
+  return 0;
+
+}
+
+/* Map the sync bus of the local afl-fuzz instances once it exists. */
+
+static void bus_open(void) {
+
+  u8              fn[PATH_MAX];
+  struct stat     st;
+  struct sync_bus hdr;
+  s32             fd;
+
+  snprintf(fn, PATH_MAX, "%s/.sync_bus", sync_dir);
+  fd = open(fn, O_RDONLY);
+  if (fd < 0) { return; }
+
+  /* The ring size is set by the afl-fuzz instance that created the bus. */
+
+  if (fstat(fd, &st) || pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+      !hdr.records || hdr.records > SYNC_BUS_RECORDS_MAX ||
+      (u64)st.st_size != SYNC_BUS_BYTES(hdr.records)) {
+
+    close(fd);
+    return;
+
+  }
+
+  bus_records = hdr.records;
+  bus = mmap(NULL, SYNC_BUS_BYTES(bus_records), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (bus == MAP_FAILED) { PFATAL("Unable to mmap '%s'", fn); }
+
+  if (bus->magic != SYNC_BUS_MAGIC || bus->records != bus_records ||
+      bus->max_pairs != SYNC_BUS_MAX_PAIRS ||
+      bus->record_size != sizeof(struct sync_bus_record)) {
+
+    FATAL("'%s' was created by a different afl-fuzz build", fn);
+
+  }
+
+  u64 head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+  bus_tail = head > bus_records ? head - bus_records : 0;
+
+  OKF("Reading the sync bus '%s'.", fn);
+
+}
+
+/* Turn new records on the sync bus into offers. */
+
+static void bus_scan(void) {
+
+  u32 idx[SYNC_BUS_MAX_PAIRS];
+  u8  val[SYNC_BUS_MAX_PAIRS];
+
+  if (!bus) {
+
+    bus_open();
+    if (!bus) { return; }
+
+  }
+
+  u64 head = __atomic_load_n(&bus->head, __ATOMIC_ACQUIRE);
+
+  if (head - bus_tail > bus_records) {
+
+    WARNF("Missed %llu records on the sync bus", head - bus_tail - bus_records);
+    bus_tail = head - bus_records;
+
+  }
+
+  for (; bus_tail < head; ++bus_tail) {
+
+    struct sync_bus_record *rec = &bus->rec[bus_tail % bus_records];
+    u64 seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+    u64 target, input_hash;
+    u32 peer, id, map_size, cnt;
+
+    if (seq != bus_tail + 1) { continue; }
+
+    target = rec->target;
+    input_hash = rec->input_hash;
+    peer = rec->peer;
+    id = rec->id;
+    map_size = rec->map_size;
+    cnt = rec->pair_cnt;
+
+    if (cnt > SYNC_BUS_MAX_PAIRS) { continue; }
+    memcpy(idx, rec->idx, cnt * sizeof(u32));
+    memcpy(val, rec->val, cnt);
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != seq) { continue; }
+
+    if (!target_ok(target, map_size)) { continue; }
+
+    u64 digest = trace_digest(idx, val, cnt);
+
+    /* Already known, e.g. an entry we fetched from another node. */
+
+    if (known_add(digest)) { continue; }
+    trace_merge(idx, val, cnt);
+
+    /* Only the last NODE_OFFERS_MAX offers can be fetched. */
+
+    if (!offers) { offers = ck_alloc(NODE_OFFERS_MAX * sizeof(struct offer)); }
+
+    struct offer *o = &offers[offer_cnt++ % NODE_OFFERS_MAX];
+
+    ck_free(o->idx);
+    ck_free(o->val);
+
+    o->digest = digest;
+    o->input_hash = input_hash;
+    o->peer = peer;
+    o->id = id;
+    o->pair_cnt = cnt;
+    o->idx = ck_alloc(cnt * sizeof(u32) + 1);
+    o->val = ck_alloc(cnt + 1);
+    memcpy(o->idx, idx, cnt * sizeof(u32));
+    memcpy(o->val, val, cnt);
+
+  }
+
+}
+
+/* Append a message to the write buffer of a connection. */
+
+static void conn_send(struct conn *c, u32 type, void *a, u32 a_len, void *b,
+                      u32 b_len, void *d, u32 d_len) {
+
+  struct msg_hdr hdr = {type, a_len + b_len + d_len};
+  u32            need = c->wlen + sizeof(hdr) + hdr.len;
+
+  if (need > c->wcap) {
+
+    c->wcap = need * 2;
+    c->wbuf = ck_realloc(c->wbuf, c->wcap);
+
+  }
+
+  memcpy(c->wbuf + c->wlen, &hdr, sizeof(hdr));
+  c->wlen += sizeof(hdr);
+  if (a_len) { memcpy(c->wbuf + c->wlen, a, a_len); }
+  c->wlen += a_len;
+  if (b_len) { memcpy(c->wbuf + c->wlen, b, b_len); }
+  c->wlen += b_len;
+  if (d_len) { memcpy(c->wbuf + c->wlen, d, d_len); }
+  c->wlen += d_len;
+
+}
+
+static void conn_hello(struct conn *c) {
+
+  struct msg_hello h;
+
+  memset(&h, 0, sizeof(h));
+  h.magic = NODE_MAGIC;
+  h.version = NODE_VERSION;
+  memcpy(h.name, node_name, NODE_NAME_LEN);
+
+  conn_send(c, MSG_HELLO, &h, sizeof(h), NULL, 0, NULL, 0);
+
+}
+
+static void fetch_pop(struct conn *c) {
+
+  struct fetch *f = &c->fetch[c->fetch_head];
+
+  ck_free(f->idx);
+  ck_free(f->val);
+  f->idx = NULL;
+  f->val = NULL;
+
+  c->fetch_head = (c->fetch_head + 1) % NODE_FETCH_MAX;
+  --c->fetch_cnt;
+
+}
+
+static void conn_close(struct conn *c) {
+
+  if (c->fd >= 0) { close(c->fd); }
+  if (c->name[0]) { ACTF("Node '%s' disconnected.", c->name); }
+
+  /* Unanswered fetches are offered again after reconnecting. */
+
+  while (c->fetch_cnt) {
+
+    fetch_pop(c);
+
+  }
+
+  c->fd = -1;
+  c->connecting = 0;
+  c->name[0] = 0;
+  c->rlen = c->wlen = c->woff = 0;
+  c->cursor = 0;
+  c->retry = get_cur_time() + NODE_RETRY_MS;
+
+}
+
+static struct conn *conn_new(s32 fd, u8 *addr) {
+
+  conns = ck_realloc(conns, (conn_cnt + 1) * sizeof(struct conn));
+  struct conn *c = &conns[conn_cnt++];
+
+  memset(c, 0, sizeof(struct conn));
+  c->fd = fd;
+  c->addr = addr;
+  return c;
+
+}
+
+/* Start a non-blocking connect() to a host:port. */
+
+static void conn_connect(struct conn *c) {
+
+  struct addrinfo hints, *res;
+  u8              host[256], *port;
+
+  snprintf(host, sizeof(host), "%s", c->addr);
+  port = strrchr(host, ':');
+  if (!port) { FATAL("'%s' is not host:port", c->addr); }
+  *port++ = 0;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  c->retry = get_cur_time() + NODE_RETRY_MS;
+  if (getaddrinfo(host, port, &hints, &res)) { return; }
+
+  c->fd = socket(res->ai_family, SOCK_STREAM, 0);
+  if (c->fd < 0) { PFATAL("socket() failed"); }
+  fcntl(c->fd, F_SETFL, O_NONBLOCK);
+
+  if (connect(c->fd, res->ai_addr, res->ai_addrlen) && errno != EINPROGRESS) {
+
+    close(c->fd);
+    c->fd = -1;
+
+  } else {
+
+    c->connecting = 1;
+
+  }
+
+  freeaddrinfo(res);
+
+}
+
+/* Return the directory of the local instance with this sync id hash. */
+
+static struct peer_dir *peer_dir_find(u32 hash) {
+
+  DIR           *d;
+  struct dirent *de;
+  u32            i;
+
+  for (i = 0; i < peer_cnt; ++i) {
+
+    if (peers[i].hash == hash) { return &peers[i]; }
+
+  }
+
+  d = opendir(sync_dir);
+  if (!d) { return NULL; }
+
+  /* Add the instances that are new since the last scan. */
+
+  while ((de = readdir(d))) {
+
+    u32 h = hash32(de->d_name, strlen(de->d_name), HASH_CONST);
+
+    if (de->d_name[0] == '.') { continue; }
+
+    for (i = 0; i < peer_cnt && peers[i].hash != h; ++i) {}
+    if (i < peer_cnt) { continue; }
+
+    peers = ck_realloc(peers, (peer_cnt + 1) * sizeof(struct peer_dir));
+    memset(&peers[peer_cnt], 0, sizeof(struct peer_dir));
+    peers[peer_cnt].hash = h;
+    snprintf(peers[peer_cnt].name, NAME_MAX + 1, "%s", de->d_name);
+    ++peer_cnt;
+
+  }
+
+  closedir(d);
+
+  for (i = 0; i < peer_cnt; ++i) {
+
+    if (peers[i].hash == hash) { return &peers[i]; }
+
+  }
+
+  return NULL;
+
+}
+
+/* Return the queue file name of entry id of a local instance. The queue
+   directory is only read again for ids newer than the last scan: entries
+   are published on the sync bus after their file is written, so one scan
+   covers all offers made up to then. */
+
+static u8 *peer_queue_find(struct peer_dir *p, u32 id) {
+
+  u8             path[PATH_MAX];
+  DIR           *d;
+  struct dirent *de;
+
+  if (id < p->queue_cnt) { return p->queue[id]; }
+
+  snprintf(path, PATH_MAX, "%s/%s/queue", sync_dir, p->name);
+
+  d = opendir(path);
+  if (!d) { return NULL; }
+
+  while ((de = readdir(d))) {
+
+    u32 n;
+
+    if (sscanf(de->d_name, "id:%u", &n) != 1 || n >= NODE_QUEUE_MAX) {
+
+      continue;
+
+    }
+
+    if (n >= p->queue_cnt) {
+
+      p->queue = ck_realloc(p->queue, (n + 1) * sizeof(u8 *));
+      memset(p->queue + p->queue_cnt, 0,
+             (n + 1 - p->queue_cnt) * sizeof(u8 *));
+      p->queue_cnt = n + 1;
+
+    }
+
+    if (!p->queue[n]) { p->queue[n] = ck_strdup(de->d_name); }
+
+  }
+
+  closedir(d);
+
+  return id < p->queue_cnt ? p->queue[id] : NULL;
+
+}
+
+/* Read the input of an offer, NULL if it is gone or changed. */
+
+static u8 *offer_read(struct offer *o, u32 *len) {
+
+  u8              path[PATH_MAX], *fn;
+  u8             *buf = NULL;
+  struct peer_dir *peer = peer_dir_find(o->peer);
+  struct stat      st;
+  s32              fd;
+
+  if (!peer || !(fn = peer_queue_find(peer, o->id))) { return NULL; }
+
+  snprintf(path, PATH_MAX, "%s/%s/queue/%s", sync_dir, peer->name, fn);
+  fd = open(path, O_RDONLY);
+  if (fd < 0) { return NULL; }
+
+  if (!fstat(fd, &st) && st.st_size && st.st_size <= MAX_FILE) {
+
+    u32 size = st.st_size;
+
+    buf = ck_alloc_nozero(size);
+
+    if (read(fd, buf, size) != (ssize_t)size ||
+        hash64(buf, size, HASH_CONST) != o->input_hash) {
+
+      ck_free(buf);
+      buf = NULL;
+
+    } else {
+
+      *len = size;
+
+    }
+
+  }
+
+  close(fd);
+  return buf;
+
+}
+
+/* Store an input fetched from another node where afl-fuzz syncs it. */
+
+static void remote_store(u8 *node, u8 *data, u32 len) {
+
+  struct remote_dir *r = NULL;
+  u8                 dir[PATH_MAX], tmp[PATH_MAX], fn[PATH_MAX];
+  s32                fd;
+
+  for (u32 i = 0; i < remote_cnt; ++i) {
+
+    if (!strcmp(remotes[i].name, node)) { r = &remotes[i]; }
+
+  }
+
+  snprintf(dir, PATH_MAX, "%s/%s_remote", sync_dir, node);
+
+  if (!r) {
+
+    DIR           *d;
+    struct dirent *de;
+
+    remotes = ck_realloc(remotes, (remote_cnt + 1) * sizeof(struct remote_dir));
+    r = &remotes[remote_cnt++];
+    memset(r, 0, sizeof(struct remote_dir));
+    memcpy(r->name, node, NODE_NAME_LEN);
+
+    if (mkdir(dir, 0700) && errno != EEXIST) {
+
+      PFATAL("Unable to create '%s'", dir);
+
+    }
+
+    snprintf(fn, PATH_MAX, "%s/queue", dir);
+    if (mkdir(fn, 0700) && errno != EEXIST) {
+
+      PFATAL("Unable to create '%s'", fn);
+
+    }
+
+    /* Continue after what a previous run stored. */
+
+    if ((d = opendir(fn))) {
+
+      while ((de = readdir(d))) {
+
+        u32 id;
+        if (sscanf(de->d_name, "id:%06u", &id) == 1 && id >= r->next_id) {
+
+          r->next_id = id + 1;
+
+        }
+
+      }
+
+      closedir(d);
+
+    }
+
+  }
+
+  /* rename() makes the file appear complete, also for AFL_SYNC_INOTIFY. */
+
+  snprintf(tmp, PATH_MAX, "%s/queue/.tmp", dir);
+  snprintf(fn, PATH_MAX, "%s/queue/id:%06u,node:%s", dir, r->next_id, node);
+
+  fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_PERMISSION);
+  if (fd < 0) { PFATAL("Unable to create '%s'", tmp); }
+  ck_write(fd, data, len, tmp);
+  close(fd);
+
+  if (rename(tmp, fn)) { PFATAL("Unable to rename '%s'", tmp); }
+
+  ++r->next_id;
+  ++stat_fetched;
+
+}
+
+/* Handle one complete message, returns 0 if the connection must go. */
+
+static u8 conn_handle(struct conn *c, u32 type, u8 *p, u32 len) {
+
+  if (type != MSG_HELLO && !c->name[0]) { return 0; }
+
+  switch (type) {
+
+    case MSG_HELLO: {
+
+      struct msg_hello *h = (struct msg_hello *)p;
+
+      if (len != sizeof(*h) || h->magic != NODE_MAGIC ||
+          h->version != NODE_VERSION) {
+
+        WARNF("Protocol mismatch with a node, check its afl-sync-node version");
+        return 0;
+
+      }
+
+      h->name[NODE_NAME_LEN - 1] = 0;
+      if (!h->name[0] || strchr(h->name, '/') || h->name[0] == '.' ||
+          !strcmp(h->name, node_name)) {
+
+        WARNF("Node name '%s' is not valid here", h->name);
+        return 0;
+
+      }
+
+      memcpy(c->name, h->name, NODE_NAME_LEN);
+      OKF("Node '%s' connected.", c->name);
+      return 1;
+
+    }
+
+    case MSG_OFFER: {
+
+      struct msg_offer *o = (struct msg_offer *)p;
+
+      if (len < sizeof(*o) || o->pair_cnt > SYNC_BUS_MAX_PAIRS ||
+          len != sizeof(*o) + o->pair_cnt * (sizeof(u32) + 1)) {
+
+        return 0;
+
+      }
+
+      u32 *idx = (u32 *)(p + sizeof(*o));
+      u8  *val = p + sizeof(*o) + o->pair_cnt * sizeof(u32);
+
+      if (!target_ok(o->target, o->map_size) ||
+          trace_digest(idx, val, o->pair_cnt) != o->digest ||
+          known_has(o->digest)) {
+
+        return 1;
+
+      }
+
+      if (!trace_new(idx, val, o->pair_cnt)) {
+
+        ++stat_dropped;
+        return 1;
+
+      }
+
+      /* The answers come back in order, so the fetches are kept in a ring.
+         When it is full the offer is skipped. */
+
+      if (c->fetch_cnt == NODE_FETCH_MAX) {
+
+        ++stat_skipped;
+        return 1;
+
+      }
+
+      if (!c->fetch) {
+
+        c->fetch = ck_alloc(NODE_FETCH_MAX * sizeof(struct fetch));
+
+      }
+
+      struct fetch *f =
+          &c->fetch[(c->fetch_head + c->fetch_cnt++) % NODE_FETCH_MAX];
+
+      f->seq = o->seq;
+      f->digest = o->digest;
+      f->pair_cnt = o->pair_cnt;
+      f->idx = ck_alloc(o->pair_cnt * sizeof(u32) + 1);
+      f->val = ck_alloc(o->pair_cnt + 1);
+      memcpy(f->idx, idx, o->pair_cnt * sizeof(u32));
+      memcpy(f->val, val, o->pair_cnt);
+
+      conn_send(c, MSG_FETCH, &o->seq, sizeof(u64), NULL, 0, NULL, 0);
+      return 1;
+
+    }
+
+    case MSG_FETCH: {
+
+      struct msg_data d;
+      u8             *buf = NULL;
+      u32             buf_len = 0;
+
+      if (len != sizeof(u64)) { return 0; }
+
+      d.seq = *(u64 *)p;
+      if (d.seq >= offer_cnt) { return 0; }
+
+      /* Offers that fell out of the ring are answered as gone. */
+
+      if (offer_cnt - d.seq <= NODE_OFFERS_MAX) {
+
+        struct offer *o = &offers[d.seq % NODE_OFFERS_MAX];
+
+        d.input_hash = o->input_hash;
+        buf = offer_read(o, &buf_len);
+
+      } else {
+
+        d.input_hash = 0;
+
+      }
+
+      conn_send(c, MSG_DATA, &d, sizeof(d), buf, buf_len, NULL, 0);
+      ck_free(buf);
+      return 1;
+
+    }
+
+    case MSG_DATA: {
+
+      struct msg_data *d = (struct msg_data *)p;
+      struct fetch    *f;
+
+      if (len < sizeof(*d) || !c->fetch_cnt) { return 0; }
+
+      f = &c->fetch[c->fetch_head];
+      if (f->seq != d->seq) { return 0; }
+
+      len -= sizeof(*d);
+
+      /* An empty answer means the entry is gone at the other node. The same
+         trace may have been stored from another node in the meantime. */
+
+      if (len && hash64(p + sizeof(*d), len, HASH_CONST) == d->input_hash &&
+          !known_has(f->digest)) {
+
+        if (trace_new(f->idx, f->val, f->pair_cnt)) {
+
+          remote_store(c->name, p + sizeof(*d), len);
+
+        } else {
+
+          ++stat_dropped;
+
+        }
+
+        known_add(f->digest);
+        trace_merge(f->idx, f->val, f->pair_cnt);
+
+      }
+
+      fetch_pop(c);
+      return 1;
+
+    }
+
+    default:
+      return 0;
+
+  }
+
+}
+
+static void conn_read(struct conn *c) {
+
+  ssize_t r;
+
+  if (c->rcap - c->rlen < 65536) {
+
+    c->rcap = c->rcap ? c->rcap * 2 : 131072;
+    c->rbuf = ck_realloc(c->rbuf, c->rcap);
+
+  }
+
+  r = read(c->fd, c->rbuf + c->rlen, c->rcap - c->rlen);
+
+  if (r <= 0) {
+
+    if (r < 0 && (errno == EAGAIN || errno == EINTR)) { return; }
+    conn_close(c);
+    return;
+
+  }
+
+  c->rlen += r;
+
+  u32 off = 0;
+
+  while (c->rlen - off >= sizeof(struct msg_hdr)) {
+
+    struct msg_hdr *h = (struct msg_hdr *)(c->rbuf + off);
+
+    if (h->len > NODE_MSG_MAX) {
+
+      conn_close(c);
+      return;
+
+    }
+
+    if (c->rlen - off - sizeof(struct msg_hdr) < h->len) { break; }
+
+    if (!conn_handle(c, h->type, c->rbuf + off + sizeof(struct msg_hdr),
+                     h->len)) {
+
+      conn_close(c);
+      return;
+
+    }
+
+    off += sizeof(struct msg_hdr) + h->len;
+
+  }
+
+  memmove(c->rbuf, c->rbuf + off, c->rlen - off);
+  c->rlen -= off;
+
+}
+
+static void conn_write(struct conn *c) {
+
+  ssize_t w = write(c->fd, c->wbuf + c->woff, c->wlen - c->woff);
+
+  if (w < 0) {
+
+    if (errno != EAGAIN && errno != EINTR) { conn_close(c); }
+    return;
+
+  }
+
+  c->woff += w;
+
+  if (c->woff == c->wlen) { c->woff = c->wlen = 0; }
+
+}
+
+/* Queue the offers the other node has not seen yet. */
+
+static void conn_fill(struct conn *c) {
+
+  /* A node that fell behind continues with the oldest offer still kept. */
+
+  if (offer_cnt - c->cursor > NODE_OFFERS_MAX) {
+
+    c->cursor = offer_cnt - NODE_OFFERS_MAX;
+
+  }
+
+  while (c->cursor < offer_cnt && c->wlen < NODE_WBUF_FILL) {
+
+    struct offer    *o = &offers[c->cursor % NODE_OFFERS_MAX];
+    struct msg_offer m;
+
+    m.seq = c->cursor++;
+    m.digest = o->digest;
+    m.target = node_target;
+    m.input_hash = o->input_hash;
+    m.map_size = node_map_size;
+    m.pair_cnt = o->pair_cnt;
+
+    conn_send(c, MSG_OFFER, &m, sizeof(m), o->idx, o->pair_cnt * sizeof(u32),
+              o->val, o->pair_cnt);
+    ++stat_offered;
+
+  }
+
+}
+
+static s32 listen_on(u8 *spec) {
+
+  struct addrinfo hints, *res;
+  u8              host[256], *port;
+  s32             fd, one = 1;
+
+  snprintf(host, sizeof(host), "%s", spec);
+  port = strrchr(host, ':');
+
+  if (port) {
+
+    *port++ = 0;
+
+  } else {
+
+    port = host;
+
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+
+  if (getaddrinfo(port == host ? NULL : (char *)host, port, &hints, &res)) {
+
+    FATAL("Unable to resolve '%s'", spec);
+
+  }
+
+  fd = socket(res->ai_family, SOCK_STREAM, 0);
+  if (fd < 0) { PFATAL("socket() failed"); }
+
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  if (bind(fd, res->ai_addr, res->ai_addrlen)) {
+
+    PFATAL("Unable to bind to '%s'", spec);
+
+  }
+
+  if (listen(fd, 16)) { PFATAL("listen() failed"); }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+
+  freeaddrinfo(res);
+  return fd;
+
+}
+
+static void usage(u8 *argv0) {
+
+  SAYF(
+      "\n%s [ options ]\n\n"
+
+      "Required parameters:\n"
+      "  -d dir        - sync directory of the afl-fuzz instances on this "
+      "host\n\n"
+
+      "Optional parameters:\n"
+      "  -n name       - name of this node (default: host name)\n"
+      "  -l [addr:]port - accept connections from other nodes\n"
+      "  -c host:port  - connect to another node (can be given several "
+      "times)\n"
+      "  -i msec       - interval to look for new queue entries (default: "
+      "1000)\n\n"
+
+      "The afl-fuzz instances must run with AFL_SYNC_BUS=1.\n\n",
+      argv0);
+
+  exit(1);
+
+}
+
+int main(int argc, char **argv) {
+
+  s32 opt, listen_fd = -1;
+  u8 *listen_spec = NULL;
+  u32 interval = 1000, stat_time = 0;
+  u64 next_scan = 0;
+
+  SAYF(cCYA "afl-sync-node " VERSION cRST "\n");
+
+  while ((opt = getopt(argc, argv, "+d:n:l:c:i:h")) > 0) {
+
+    switch (opt) {
+
+      case 'd':
+        sync_dir = optarg;
+        break;
+
+      case 'n':
+        snprintf(node_name, NODE_NAME_LEN, "%s", optarg);
+        break;
+
+      case 'l':
+        listen_spec = optarg;
+        break;
+
+      case 'c':
+        conn_new(-1, optarg);
+        break;
+
+      case 'i':
+        interval = atoi(optarg);
+        if (!interval) { FATAL("Bad value for -i"); }
+        break;
+
+      default:
+        usage(argv[0]);
+
+    }
+
+  }
+
+  if (!sync_dir || optind != argc) { usage(argv[0]); }
+
+  if (!node_name[0] && gethostname(node_name, NODE_NAME_LEN - 1)) {
+
+    PFATAL("gethostname() failed");
+
+  }
+
+  if (strchr(node_name, '/') || node_name[0] == '.') {
+
+    FATAL("Invalid node name '%s'", node_name);
+
+  }
+
+  signal(SIGINT, handle_stop_sig);
+  signal(SIGTERM, handle_stop_sig);
+  signal(SIGPIPE, SIG_IGN);
+
+  if (listen_spec) { listen_fd = listen_on(listen_spec); }
+
+  OKF("Node '%s' syncing '%s'.", node_name, sync_dir);
+
+  while (!stop_soon) {
+
+    struct pollfd *pfd = ck_alloc((conn_cnt + 1) * sizeof(struct pollfd));
+    u32            n = 0, i;
+    u64            cur_time = get_cur_time();
+
+    if (cur_time >= next_scan) {
+
+      bus_scan();
+      next_scan = cur_time + interval;
+
+    }
+
+    if (cur_time / 60000 != stat_time) {
+
+      stat_time = cur_time / 60000;
+      ACTF("%llu entries offered, %llu fetched, %llu without new coverage, "
+           "%llu skipped.",
+           stat_offered, stat_fetched, stat_dropped, stat_skipped);
+
+    }
+
+    pfd[n].fd = listen_fd;
+    pfd[n++].events = POLLIN;
+
+    for (i = 0; i < conn_cnt; ++i) {
+
+      struct conn *c = &conns[i];
+
+      if (c->fd < 0 && c->addr && cur_time >= c->retry) { conn_connect(c); }
+
+      if (c->fd >= 0 && !c->connecting && c->name[0]) { conn_fill(c); }
+
+      pfd[n].fd = c->fd;
+      pfd[n].events = c->fd < 0 ? 0
+                                : (c->connecting ? POLLOUT
+                                                 : POLLIN | (c->wlen > c->woff
+                                                                 ? POLLOUT
+                                                                 : 0));
+      ++n;
+
+    }
+
+    if (poll(pfd, n, MIN(interval, 1000)) < 0 && errno != EINTR) {
+
+      PFATAL("poll() failed");
+
+    }
+
+    if (listen_fd >= 0 && (pfd[0].revents & POLLIN)) {
+
+      s32 fd = accept(listen_fd, NULL, NULL);
+
+      if (fd >= 0) {
+
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        conn_hello(conn_new(fd, NULL));
+
+      }
+
+    }
+
+    /* conns may have grown by accept(), only look at the polled ones. */
+
+    for (i = 0; i + 1 < n; ++i) {
+
+      struct conn *c = &conns[i];
+      short        ev = pfd[i + 1].revents;
+
+      if (c->fd < 0 || !ev) { continue; }
+
+      if (c->connecting) {
+
+        s32       err = 0;
+        socklen_t err_len = sizeof(err);
+
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+
+        if (err) {
+
+          conn_close(c);
+
+        } else {
+
+          c->connecting = 0;
+          conn_hello(c);
+
+        }
+
+        continue;
+
+      }
+
+      if (ev & (POLLIN | POLLHUP | POLLERR)) { conn_read(c); }
+      if (c->fd >= 0 && (ev & POLLOUT)) { conn_write(c); }
+
+    }
+
+    /* Forget accepted connections that are gone. */
+
+    for (i = 0; i < conn_cnt;) {
+
+      if (conns[i].fd < 0 && !conns[i].addr) {
+
+        ck_free(conns[i].rbuf);
+        ck_free(conns[i].wbuf);
+        ck_free(conns[i].fetch);
+        conns[i] = conns[--conn_cnt];
+
+      } else {
+
+        ++i;
+
+      }
+
+    }
+
+    ck_free(pfd);
+
+  }
+
+  OKF("%llu entries offered, %llu fetched, %llu without new coverage, %llu "
+      "skipped.",
+      stat_offered, stat_fetched, stat_dropped, stat_skipped);
+
+  return 0;
+
+}
+
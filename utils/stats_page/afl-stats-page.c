@@ -0,0 +1,347 @@
+/*
+   american fuzzy lop++ - read the binary stats pages of instances
+   ---------------------------------------------------------------
+
+   Copyright 2019-2024 AFLplusplus Project. All rights reserved.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at:
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+   Maps the fuzzer_stats.bin of one or more instances (see
+   include/afl-stats-page.h), either given directly or found in a sync
+   directory, and prints one line per instance and the totals. With -t or
+   -p the page of a single instance is exported as fuzzer_stats or
+   plot_data text.
+
+*/
+
+#include "config.h"
+#include "types.h"
+#include "debug.h"
+#include "alloc-inl.h"
+#include "afl-stats-page.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+struct instance {
+
+  u8                    *name;
+  struct stats_page     *page;
+  struct stats_page_data d;
+  u8                     alive;
+
+};
+
+static struct instance *instances;
+static u32              instance_cnt;
+
+static void usage(char *argv0) {
+
+  SAYF(
+      "%s [ -s | -t | -p ] dir...\n\n"
+      "  -s  - only print the totals\n"
+      "  -t  - print the stats of one instance like fuzzer_stats\n"
+      "  -p  - print the samples of one instance like plot_data\n\n"
+      "dir is the output directory of an instance or a sync directory with "
+      "several\ninstances.\n",
+      argv0);
+  exit(1);
+
+}
+
+static u64 get_cur_time(void) {
+
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec * 1000ULL) + (tv.tv_usec / 1000);
+
+}
+
+/* Map the page of the instance in dir. Returns 0 if there is none. */
+
+static u8 add_instance(u8 *dir, u8 *name) {
+
+  u8                 fn[PATH_MAX];
+  struct stat        st;
+  struct stats_page *p;
+  s32                fd;
+
+  snprintf(fn, PATH_MAX, "%s/" STATS_PAGE_FILE, dir);
+  fd = open(fn, O_RDONLY);
+  if (fd < 0) { return 0; }
+
+  if (fstat(fd, &st) || (u64)st.st_size < sizeof(struct stats_page)) {
+
+    close(fd);
+    return 0;
+
+  }
+
+  p = mmap(NULL, sizeof(struct stats_page), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) { return 0; }
+
+  if (!stats_page_valid(p, st.st_size)) {
+
+    WARNF("'%s' has an unknown format, skipping it", fn);
+    munmap(p, sizeof(struct stats_page));
+    return 0;
+
+  }
+
+  instances =
+      ck_realloc(instances, (instance_cnt + 1) * sizeof(struct instance));
+  instances[instance_cnt].name = ck_strdup(name);
+  instances[instance_cnt].page = p;
+  ++instance_cnt;
+  return 1;
+
+}
+
+/* Add dir itself, or else all instances in it. */
+
+static void add_dir(u8 *dir) {
+
+  struct dirent *de;
+  DIR           *d;
+  u8             fn[PATH_MAX];
+
+  if (add_instance(dir, dir)) { return; }
+
+  d = opendir(dir);
+  if (!d) { PFATAL("Unable to open '%s'", dir); }
+
+  while ((de = readdir(d))) {
+
+    if (de->d_name[0] == '.') { continue; }
+    snprintf(fn, PATH_MAX, "%s/%s", dir, de->d_name);
+    add_instance(fn, de->d_name);
+
+  }
+
+  closedir(d);
+
+}
+
+static void print_text(struct stats_page_data *d) {
+
+  SAYF(
+      "start_time        : %llu\n"
+      "last_update       : %llu\n"
+      "run_time          : %llu\n"
+      "fuzzer_pid        : %u\n"
+      "cycles_done       : %llu\n"
+      "cycles_wo_finds   : %llu\n"
+      "fuzz_time         : %llu\n"
+      "calibration_time  : %llu\n"
+      "cmplog_time       : %llu\n"
+      "sync_time         : %llu\n"
+      "trim_time         : %llu\n"
+      "execs_done        : %llu\n"
+      "execs_per_sec     : %0.02f\n"
+      "execs_ps_last_min : %0.02f\n"
+      "corpus_count      : %u\n"
+      "corpus_favored    : %u\n"
+      "corpus_found      : %u\n"
+      "corpus_imported   : %u\n"
+      "corpus_variable   : %u\n"
+      "max_depth         : %u\n"
+      "cur_item          : %u\n"
+      "pending_favs      : %u\n"
+      "pending_total     : %u\n"
+      "stability         : %0.02f%%\n"
+      "bitmap_cvg        : %0.02f%%\n"
+      "saved_crashes     : %llu\n"
+      "saved_hangs       : %llu\n"
+      "last_find         : %llu\n"
+      "last_crash        : %llu\n"
+      "last_hang         : %llu\n"
+      "execs_since_crash : %llu\n"
+      "exec_timeout      : %u\n"
+      "slowest_exec_ms   : %u\n"
+      "edges_found       : %u\n"
+      "total_edges       : %u\n"
+      "var_byte_count    : %u\n"
+      "calibration_execs : %llu\n"
+      "afl_banner        : %s\n",
+      d->start_time / 1000, d->last_update / 1000, d->run_time / 1000,
+      d->fuzzer_pid, d->cycles_done, d->cycles_wo_finds, d->fuzz_time / 1000,
+      d->calibration_time / 1000, d->cmplog_time / 1000, d->sync_time / 1000,
+      d->trim_time / 1000, d->execs_done, d->execs_per_sec,
+      d->execs_ps_last_min, d->corpus_count, d->corpus_favored,
+      d->corpus_found, d->corpus_imported, d->corpus_variable, d->max_depth,
+      d->cur_item, d->pending_favs, d->pending_total, d->stability,
+      d->bitmap_cvg, d->saved_crashes, d->saved_hangs, d->last_find / 1000,
+      d->last_crash / 1000, d->last_hang / 1000, d->execs_since_crash,
+      d->exec_timeout, d->slowest_exec_ms, d->edges_found, d->total_edges,
+      d->var_byte_count, d->calibration_execs, d->banner);
+
+}
+
+static void print_plot(struct stats_page *p) {
+
+  struct stats_page_sample *s =
+      ck_alloc(STATS_PAGE_SAMPLES * sizeof(struct stats_page_sample));
+  s32 cnt = stats_page_read_samples(p, s);
+
+  if (cnt < 0) { FATAL("The page is written too often to be read"); }
+
+  SAYF(
+      "# relative_time, cycles_done, cur_item, corpus_count, "
+      "pending_total, pending_favs, map_size, saved_crashes, "
+      "saved_hangs, max_depth, execs_per_sec, total_execs, edges_found\n");
+
+  for (s32 i = 0; i < cnt; ++i) {
+
+    SAYF("%llu, %llu, %u, %u, %u, %u, %0.02f%%, %llu, %llu, %u, %0.02f, %llu, "
+         "%u\n",
+         s[i].relative_time, s[i].cycles_done, s[i].cur_item,
+         s[i].corpus_count, s[i].pending_total, s[i].pending_favs,
+         s[i].bitmap_cvg, s[i].saved_crashes, s[i].saved_hangs,
+         s[i].max_depth, s[i].execs_per_sec, s[i].execs_done,
+         s[i].edges_found);
+
+  }
+
+  ck_free(s);
+
+}
+
+int main(int argc, char **argv) {
+
+  s32 opt, i;
+  u8  totals_only = 0, text = 0, plot = 0;
+  u32 alive = 0, max_edges = 0, total_edges = 0;
+  u64 execs = 0, crashes = 0, hangs = 0, pending = 0, pending_favs = 0,
+      last_find = 0, now = get_cur_time();
+  double eps = 0;
+
+  while ((opt = getopt(argc, argv, "stph")) > 0) {
+
+    switch (opt) {
+
+      case 's':
+        totals_only = 1;
+        break;
+
+      case 't':
+        text = 1;
+        break;
+
+      case 'p':
+        plot = 1;
+        break;
+
+      default:
+        usage(argv[0]);
+
+    }
+
+  }
+
+  if (optind >= argc || totals_only + text + plot > 1) { usage(argv[0]); }
+
+  for (i = optind; i < argc; ++i) {
+
+    add_dir(argv[i]);
+
+  }
+
+  if (!instance_cnt) { FATAL("No " STATS_PAGE_FILE " found"); }
+
+  if (text || plot) {
+
+    if (instance_cnt != 1) { FATAL("-t and -p need a single instance"); }
+
+    if (plot) {
+
+      print_plot(instances[0].page);
+      return 0;
+
+    }
+
+  }
+
+  for (u32 n = 0; n < instance_cnt; ++n) {
+
+    struct instance        *in = &instances[n];
+    struct stats_page_data *d = &in->d;
+
+    if (stats_page_read(in->page, d)) {
+
+      WARNF("Could not read the page of '%s'", in->name);
+      continue;
+
+    }
+
+    in->alive = !d->stopped &&
+                (!kill(d->fuzzer_pid, 0) || errno == EPERM);
+
+    if (text) {
+
+      print_text(d);
+      return 0;
+
+    }
+
+    if (!totals_only) {
+
+      SAYF("%-24s %s pid %-8u run %6llu min, %10.02f exec/s, %12llu execs, "
+           "%6u edges, %4llu crashes, %4llu hangs, %6u pending\n",
+           in->name, in->alive ? "alive" : "dead ", d->fuzzer_pid,
+           d->run_time / 60000, in->alive ? d->execs_ps_now : 0,
+           d->execs_done, d->edges_found, d->saved_crashes, d->saved_hangs,
+           d->pending_total);
+
+    }
+
+    execs += d->execs_done;
+    crashes += d->saved_crashes;
+    hangs += d->saved_hangs;
+    pending += d->pending_total;
+    pending_favs += d->pending_favs;
+    last_find = MAX(last_find, d->last_find);
+    if (d->edges_found > max_edges) {
+
+      max_edges = d->edges_found;
+      total_edges = d->total_edges;
+
+    }
+
+    if (in->alive) {
+
+      ++alive;
+      eps += d->execs_ps_now;
+
+    }
+
+  }
+
+  SAYF("\ninstances    : %u (%u alive)\n"
+       "execs        : %llu\n"
+       "exec speed   : %0.02f/s\n"
+       "edges        : %u of %u (best instance)\n"
+       "crashes      : %llu\n"
+       "hangs        : %llu\n"
+       "pending      : %llu (%llu favored)\n"
+       "last find    : %llu s ago\n",
+       instance_cnt, alive, execs, eps, max_edges, total_edges, crashes,
+       hangs, pending, pending_favs,
+       last_find ? (now - MIN(now, last_find)) / 1000 : 0);
+
+  return 0;
+
+}